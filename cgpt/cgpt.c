@@ -38,6 +38,7 @@ struct {
   {"prioritize", cmd_prioritize,
    "Reorder the priority of all kernel partitions"},
   {"legacy", cmd_legacy, "Switch between GPT and Legacy GPT"},
+  {"batch", cmd_batch, "Apply a script of commands with a single write"},
 };
 
 static void Usage(void) {
@@ -53,25 +54,18 @@ static void Usage(void) {
   printf("\nFor more detailed usage, use %s COMMAND -h\n\n", progname);
 }
 
-int main(int argc, char *argv[]) {
+int RunCommand(int argc, char *argv[]) {
   int i;
   int match_count = 0;
   int match_index = 0;
   char* command;
 
-  progname = strrchr(argv[0], '/');
-  if (progname)
-    progname++;
+  // increment optind now, so that getopt skips argv[0] in command function.
+  // An optind of 0 names argv[0] and is kept, so getopt fully reinitializes.
+  if (optind == 0)
+    command = argv[0];
   else
-    progname = argv[0];
-
-  if (argc < 2) {
-    Usage();
-    return CGPT_FAILED;
-  }
-
-  // increment optind now, so that getopt skips argv[0] in command function
-  command = argv[optind++];
+    command = argv[optind++];
 
   // Find the command to invoke.
   for (i = 0; command && i < sizeof(cmds)/sizeof(cmds[0]); ++i) {
@@ -96,3 +90,18 @@ int main(int argc, char *argv[]) {
 
   return CGPT_FAILED;
 }
+
+int main(int argc, char *argv[]) {
+  progname = strrchr(argv[0], '/');
+  if (progname)
+    progname++;
+  else
+    progname = argv[0];
+
+  if (argc < 2) {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  return RunCommand(argc, argv);
+}
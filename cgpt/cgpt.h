@@ -61,7 +61,27 @@ struct drive {
 // Returns CGPT_OK if success and information are stored in 'drive'. */
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size);
+
+// Opens a block device or file like DriveOpen(), for reading the partition
+// entries only. If the primary GPT is valid, nothing else is read; otherwise
+// both copies are loaded and checked by GptValidityCheck().
+//
+// Returns CGPT_FAILED if any error happens or there is no valid GPT.
+// Returns CGPT_OK if success; only GetEntry(..., ANY_VALID, ...) and the
+// valid header may be used. Close with DriveClose(drive, 0).
+int DriveOpenReadOnly(const char *drive_path, struct drive *drive,
+                      uint64_t drive_size);
 int DriveClose(struct drive *drive, int update_as_needed);
+
+// Starts a session on 'drive_path': until DriveSessionEnd(), DriveOpen() on
+// the same path returns the GPT loaded by this call, and DriveClose() only
+// keeps the changes in memory. 'drive_size' is used for all operations.
+//
+// Returns CGPT_FAILED if the drive can't be opened for writing.
+int DriveSessionBegin(const char *drive_path, uint64_t drive_size);
+
+// Ends the session, writing all changes at once if 'update_as_needed'.
+int DriveSessionEnd(int update_as_needed);
 int CheckValid(const struct drive *drive);
 
 /* Loads sectors from 'drive'.
@@ -161,6 +181,11 @@ uint8_t RepairEntries(GptData *gpt, const uint32_t valid_entries);
 void UpdateCrc(GptData *gpt);
 int IsSynonymous(const GptHeader* a, const GptHeader* b);
 
+// Returns the first non-empty entry of a validated GPT at or after *index,
+// which is set to its index, or NULL if there are no more. For example:
+//   for (i = 0; (entry = GetNextNonEmptyEntry(drive, &i)); i++)
+GptEntry *GetNextNonEmptyEntry(struct drive *drive, uint32_t *index);
+
 int IsUnused(struct drive *drive, int secondary, uint32_t index);
 int IsKernel(struct drive *drive, int secondary, uint32_t index);
 
@@ -190,6 +215,11 @@ int cmd_find(int argc, char *argv[]);
 int cmd_edit(int argc, char *argv[]);
 int cmd_prioritize(int argc, char *argv[]);
 int cmd_legacy(int argc, char *argv[]);
+int cmd_batch(int argc, char *argv[]);
+
+// Runs the command named by argv[optind], like the cgpt executable. With an
+// optind of 0, argv[0] names the command and getopt state is reset.
+int RunCommand(int argc, char *argv[]);
 
 #define ARRAY_COUNT(array) (sizeof(array)/sizeof((array)[0]))
 const char *GptError(int errnum);
@@ -134,6 +134,55 @@ int WritePMBR(struct drive *drive) {
   return CGPT_OK;
 }
 
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(SEEK_DATA)
+static int IsZero(const uint8_t *buf, uint64_t size) {
+  return size == 0 || (buf[0] == 0 && !memcmp(buf, buf + 1, size - 1));
+}
+
+/* Returns true if the file has no data in the given range. */
+static int IsHole(int fd, uint64_t offset, uint64_t size) {
+  off_t data = lseek(fd, offset, SEEK_DATA);
+  if (data == -1)
+    return errno == ENXIO;
+  return data >= offset + size;
+}
+
+/*
+ * Writes to a regular file, leaving or punching holes instead of writing file
+ * system blocks that are all zeros, so sparse disk images stay sparse.
+ */
+static int SaveSparse(int fd, const uint8_t *buf, uint64_t offset,
+                      uint64_t count, uint64_t block_size) {
+  uint64_t pending = 0;  /* bytes from buf to write at offset */
+
+  while (count) {
+    uint64_t pos = offset + pending;
+    uint64_t size = block_size - pos % block_size;
+    if (size > count)
+      size = count;
+    count -= size;
+
+    if (size < block_size || !IsZero(buf + pending, size) ||
+        (!IsHole(fd, pos, size) &&
+         fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                   pos, size) != 0)) {
+      pending += size;
+      continue;
+    }
+
+    if (pending && pwrite(fd, buf, pending, offset) != pending)
+      return CGPT_FAILED;
+    buf += pending + size;
+    offset += pending + size;
+    pending = 0;
+  }
+
+  if (pending && pwrite(fd, buf, pending, offset) != pending)
+    return CGPT_FAILED;
+  return CGPT_OK;
+}
+#endif
+
 int Save(struct drive *drive, const uint8_t *buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
@@ -144,6 +193,14 @@ int Save(struct drive *drive, const uint8_t *buf,
   require(buf);
   count = sector_bytes * sector_count;
 
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(SEEK_DATA)
+  struct stat statbuf;
+  if (fstat(drive->fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode) &&
+      statbuf.st_blksize > 0)
+    return SaveSparse(drive->fd, buf, sector * sector_bytes, count,
+                      statbuf.st_blksize);
+#endif
+
   if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET))
     return CGPT_FAILED;
 
@@ -154,7 +211,7 @@ int Save(struct drive *drive, const uint8_t *buf,
   return CGPT_OK;
 }
 
-static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
+static int GptSetSectorBytes(struct drive *drive, uint32_t sector_bytes) {
   drive->gpt.sector_bytes = sector_bytes;
   if (drive->size % drive->gpt.sector_bytes) {
     Error("Media size (%llu) is not a multiple of sector size(%d)\n",
@@ -163,6 +220,17 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
   }
   drive->gpt.streaming_drive_sectors = drive->size / drive->gpt.sector_bytes;
 
+  /* TODO(namnguyen): Remove this and totally trust gpt_drive_sectors. */
+  if (!(drive->gpt.flags & GPT_FLAG_EXTERNAL)) {
+    drive->gpt.gpt_drive_sectors = drive->gpt.streaming_drive_sectors;
+  } /* Else, we trust gpt.gpt_drive_sectors. */
+  return 0;
+}
+
+static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
+  if (GptSetSectorBytes(drive, sector_bytes))
+    return -1;
+
   drive->gpt.primary_header = malloc(drive->gpt.sector_bytes);
   drive->gpt.secondary_header = malloc(drive->gpt.sector_bytes);
   drive->gpt.primary_entries = malloc(GPT_ENTRIES_ALLOC_SIZE);
@@ -171,11 +239,6 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
       !drive->gpt.primary_entries || !drive->gpt.secondary_entries)
     return -1;
 
-  /* TODO(namnguyen): Remove this and totally trust gpt_drive_sectors. */
-  if (!(drive->gpt.flags & GPT_FLAG_EXTERNAL)) {
-    drive->gpt.gpt_drive_sectors = drive->gpt.streaming_drive_sectors;
-  } /* Else, we trust gpt.gpt_drive_sectors. */
-
   // Read the data.
   if (CGPT_OK != Load(drive, drive->gpt.primary_header,
                       GPT_PMBR_SECTORS,
@@ -228,6 +291,43 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
   return 0;
 }
 
+// Loads only the primary header and entries (allocated to their actual size),
+// and marks them valid if they are. Returns 0 if the primary GPT is valid.
+static int GptLoadPrimary(struct drive *drive) {
+  GptData *gpt = &drive->gpt;
+  GptHeader *header;
+  size_t entries_sectors;
+
+  if (GPT_SUCCESS != CheckParameters(gpt))
+    return -1;
+
+  gpt->primary_header = malloc(gpt->sector_bytes);
+  if (!gpt->primary_header)
+    return -1;
+  if (CGPT_OK != Load(drive, gpt->primary_header, GPT_PMBR_SECTORS,
+                      gpt->sector_bytes, GPT_HEADER_SECTORS))
+    return -1;
+
+  header = (GptHeader *)gpt->primary_header;
+  if (CheckHeader(header, 0, gpt->streaming_drive_sectors,
+                  gpt->gpt_drive_sectors, gpt->flags, gpt->sector_bytes))
+    return -1;
+
+  entries_sectors = CalculateEntriesSectors(header, gpt->sector_bytes);
+  gpt->primary_entries = malloc(entries_sectors * gpt->sector_bytes);
+  if (!gpt->primary_entries)
+    return -1;
+  if (CGPT_OK != Load(drive, gpt->primary_entries, header->entries_lba,
+                      gpt->sector_bytes, entries_sectors))
+    return -1;
+  if (CheckEntries((GptEntry *)gpt->primary_entries, header))
+    return -1;
+
+  gpt->valid_headers = MASK_PRIMARY;
+  gpt->valid_entries = MASK_PRIMARY;
+  return 0;
+}
+
 static int GptSave(struct drive *drive) {
   int errors = 0;
 
@@ -314,16 +414,18 @@ static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
   return 0;
 }
 
-int DriveOpen(const char *drive_path, struct drive *drive, int mode,
-              uint64_t drive_size) {
-  uint32_t sector_bytes;
-
-  require(drive_path);
-  require(drive);
+// The drive shared by all operations of a session (see DriveSessionBegin).
+static struct drive session_drive;
+static const char *session_path;
 
-  // Clear struct for proper error handling.
-  memset(drive, 0, sizeof(struct drive));
+static int IsSessionDrive(const struct drive *drive) {
+  return session_path && drive != &session_drive &&
+      drive->fd == session_drive.fd;
+}
 
+// Opens the file of a drive, and gets its size.
+static int DriveOpenFile(const char *drive_path, struct drive *drive, int mode,
+                         uint64_t drive_size, uint32_t *sector_bytes) {
   drive->fd = open(drive_path, mode |
 #if !defined(HAVE_MACOS) && !defined(__FreeBSD__) && !defined(__OpenBSD__)
 		               O_LARGEFILE |
@@ -335,13 +437,14 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
   }
 
   uint64_t gpt_drive_size;
-  if (ObtainDriveSize(drive->fd, &gpt_drive_size, &sector_bytes) != 0) {
+  if (ObtainDriveSize(drive->fd, &gpt_drive_size, sector_bytes) != 0) {
     Error("Can't get drive size and bytes per sector for %s: %s\n",
           drive_path, strerror(errno));
-    goto error_close;
+    close(drive->fd);
+    return CGPT_FAILED;
   }
 
-  drive->gpt.gpt_drive_sectors = gpt_drive_size / sector_bytes;
+  drive->gpt.gpt_drive_sectors = gpt_drive_size / *sector_bytes;
   if (drive_size == 0) {
     drive->size = gpt_drive_size;
     drive->gpt.flags = 0;
@@ -349,7 +452,30 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
     drive->size = drive_size;
     drive->gpt.flags = GPT_FLAG_EXTERNAL;
   }
+  return CGPT_OK;
+}
+
+int DriveOpen(const char *drive_path, struct drive *drive, int mode,
+              uint64_t drive_size) {
+  uint32_t sector_bytes;
+
+  require(drive_path);
+  require(drive);
+
+  // Clear struct for proper error handling.
+  memset(drive, 0, sizeof(struct drive));
+
+  // In a session, use the GPT already in memory. Only changes made by this
+  // operation are reported in drive->gpt.modified.
+  if (session_path && strcmp(drive_path, session_path) == 0) {
+    *drive = session_drive;
+    drive->gpt.modified = 0;
+    return CGPT_OK;
+  }
 
+  if (CGPT_OK != DriveOpenFile(drive_path, drive, mode, drive_size,
+                               &sector_bytes))
+    return CGPT_FAILED;
 
   if (GptLoad(drive, sector_bytes)) {
     goto error_close;
@@ -363,10 +489,62 @@ error_close:
   return CGPT_FAILED;
 }
 
+int DriveOpenReadOnly(const char *drive_path, struct drive *drive,
+                      uint64_t drive_size) {
+  uint32_t sector_bytes;
+
+  require(drive_path);
+  require(drive);
+
+  if (session_path && strcmp(drive_path, session_path) == 0) {
+    if (CGPT_OK != DriveOpen(drive_path, drive, O_RDONLY, drive_size))
+      return CGPT_FAILED;
+    if (GPT_SUCCESS != GptValidityCheck(&drive->gpt))
+      goto error_close;
+    return CGPT_OK;
+  }
+
+  // Clear struct for proper error handling.
+  memset(drive, 0, sizeof(struct drive));
+
+  if (CGPT_OK != DriveOpenFile(drive_path, drive, O_RDONLY, drive_size,
+                               &sector_bytes))
+    return CGPT_FAILED;
+
+  if (GptSetSectorBytes(drive, sector_bytes))
+    goto error_close;
+
+  if (0 == GptLoadPrimary(drive))
+    return CGPT_OK;
+
+  // The primary GPT is not valid, so check both like GptValidityCheck.
+  free(drive->gpt.primary_header);
+  drive->gpt.primary_header = NULL;
+  free(drive->gpt.primary_entries);
+  drive->gpt.primary_entries = NULL;
+  if (GptLoad(drive, sector_bytes) ||
+      GPT_SUCCESS != GptValidityCheck(&drive->gpt))
+    goto error_close;
+
+  return CGPT_OK;
+
+error_close:
+  (void) DriveClose(drive, 0);
+  return CGPT_FAILED;
+}
+
 
 int DriveClose(struct drive *drive, int update_as_needed) {
   int errors = 0;
 
+  // Keep the session drive open, and its changes for DriveSessionEnd.
+  if (IsSessionDrive(drive)) {
+    uint8_t modified = session_drive.gpt.modified | drive->gpt.modified;
+    session_drive = *drive;
+    session_drive.gpt.modified = modified;
+    return CGPT_OK;
+  }
+
   if (update_as_needed) {
     if (GptSave(drive)) {
         errors++;
@@ -392,6 +570,22 @@ int DriveClose(struct drive *drive, int update_as_needed) {
   return errors ? CGPT_FAILED : CGPT_OK;
 }
 
+int DriveSessionBegin(const char *drive_path, uint64_t drive_size) {
+  require(!session_path);
+
+  if (CGPT_OK != DriveOpen(drive_path, &session_drive, O_RDWR, drive_size))
+    return CGPT_FAILED;
+  session_path = drive_path;
+  return CGPT_OK;
+}
+
+int DriveSessionEnd(int update_as_needed) {
+  require(session_path);
+
+  session_path = NULL;
+  return DriveClose(&session_drive, update_as_needed);
+}
+
 
 /* GUID conversion functions. Accepted format:
  *
@@ -744,6 +938,17 @@ uint32_t GetNumberOfEntries(const struct drive *drive) {
 }
 
 
+GptEntry *GetNextNonEmptyEntry(struct drive *drive, uint32_t *index) {
+  uint32_t num_entries = GetNumberOfEntries(drive);
+
+  for (; *index < num_entries; ++*index) {
+    GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, *index);
+    if (!GuidIsZero(&entry->type))
+      return entry;
+  }
+  return NULL;
+}
+
 GptEntry *GetEntry(GptData *gpt, int secondary, uint32_t entry_index) {
   GptHeader *header = GetGptHeader(gpt);
   uint8_t *entries;
@@ -1036,39 +1241,23 @@ uint8_t RepairHeader(GptData *gpt, const uint32_t valid_headers) {
 
 int CgptGetNumNonEmptyPartitions(CgptShowParams *params) {
   struct drive drive;
-  int gpt_retval;
-  int retval;
+  uint32_t i;
 
   if (params == NULL)
     return CGPT_FAILED;
 
-  if (CGPT_OK != DriveOpen(params->drive_name, &drive, O_RDONLY,
-                           params->drive_size))
+  if (CGPT_OK != DriveOpenReadOnly(params->drive_name, &drive,
+                                   params->drive_size)) {
+    Error("No valid GPT on %s\n", params->drive_name);
     return CGPT_FAILED;
-
-  if (GPT_SUCCESS != (gpt_retval = GptValidityCheck(&drive.gpt))) {
-    Error("GptValidityCheck() returned %d: %s\n",
-          gpt_retval, GptError(gpt_retval));
-    retval = CGPT_FAILED;
-    goto done;
   }
 
   params->num_partitions = 0;
-  int numEntries = GetNumberOfEntries(&drive);
-  int i;
-  for(i = 0; i < numEntries; i++) {
-      GptEntry *entry = GetEntry(&drive.gpt, ANY_VALID, i);
-      if (GuidIsZero(&entry->type))
-        continue;
-
-      params->num_partitions++;
-  }
+  for (i = 0; GetNextNonEmptyEntry(&drive, &i); i++)
+    params->num_partitions++;
 
-  retval = CGPT_OK;
-
-done:
   DriveClose(&drive, 0);
-  return retval;
+  return CGPT_OK;
 }
 
 int GuidEqual(const Guid *guid1, const Guid *guid2) {
@@ -4,6 +4,7 @@
  */
 
 #include <ctype.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -16,52 +17,56 @@
 
 #define BUFSIZE 1024
 
-// fill comparebuf with the data to be examined, returning true on success.
-static int FillBuffer(CgptFindParams *params, int fd, uint64_t pos,
-                       uint64_t count) {
-  uint8_t *bufptr = params->comparebuf;
-
-  if (-1 == lseek(fd, pos, SEEK_SET))
-    return 0;
-
+// fill buf with the data to be examined, returning true on success.
+static int FillBuffer(uint8_t *buf, int fd, uint64_t pos, uint64_t count) {
   // keep reading until done or error
   while (count) {
-    ssize_t bytes_read = read(fd, bufptr, count);
+    ssize_t bytes_read = pread(fd, buf, count, pos);
     // negative means error, 0 means (unexpected) EOF
     if (bytes_read <= 0)
       return 0;
     count -= bytes_read;
-    bufptr += bytes_read;
+    buf += bytes_read;
+    pos += bytes_read;
   }
 
   return 1;
 }
 
+// Returns the region of partition data to match content against, or 0 if it
+// is not inside the partition.
+static int content_region(CgptFindParams *params, struct drive *drive,
+                          GptEntry *entry, uint64_t *pos) {
+  uint64_t part_size = drive->gpt.sector_bytes *
+    (entry->ending_lba - entry->starting_lba + 1);
+
+  if (params->matchoffset + params->matchlen > part_size)
+    return 0;
+
+  *pos = (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset;
+  return 1;
+}
+
 // check partition data content. return true for match, 0 for no match or error
 static int match_content(CgptFindParams *params, struct drive *drive,
-                             GptEntry *entry) {
-  uint64_t part_size;
+                         GptEntry *entry, uint8_t *comparebuf) {
+  uint64_t pos;
 
   if (!params->matchlen)
     return 1;
 
   // Ensure that the region we want to match against is inside the partition.
-  part_size = drive->gpt.sector_bytes *
-    (entry->ending_lba - entry->starting_lba + 1);
-  if (params->matchoffset + params->matchlen > part_size) {
+  if (!content_region(params, drive, entry, &pos))
     return 0;
-  }
 
   // Read the partition data.
-  if (!FillBuffer(params, drive->fd,
-    (drive->gpt.sector_bytes * entry->starting_lba) + params->matchoffset,
-                  params->matchlen)) {
+  if (!FillBuffer(comparebuf, drive->fd, pos, params->matchlen)) {
     Error("unable to read partition data\n");
     return 0;
   }
 
   // Compare it
-  if (0 == memcmp(params->matchbuf, params->comparebuf, params->matchlen)) {
+  if (0 == memcmp(params->matchbuf, comparebuf, params->matchlen)) {
     return 1;
   }
 
@@ -96,27 +101,36 @@ static void showmatch(CgptFindParams *params, const char *filename,
     EntryDetails(entry, partnum - 1, params->numeric);
 }
 
-// This returns true if a GPT partition matches the search criteria. If a match
-// isn't found (or if the file doesn't contain a GPT), it returns false. The
-// filename and partition number that matched is left in a global, since we
-// could have multiple hits.
-static int gpt_search(CgptFindParams *params, struct drive *drive,
-                      const char *filename) {
-  int i;
+// A GPT partition matching the search criteria, copied from its drive so it
+// can be shown after the drive is closed.
+struct gpt_found {
+  uint32_t index;
+  GptEntry entry;
+};
+
+// This finds the GPT partitions matching the search criteria on a drive opened
+// by DriveOpenReadOnly, storing copies of them in a new array *matches (to be
+// freed by caller). Only the drive and comparebuf are changed, so this can run
+// for different drives at the same time.
+// Returns the number of matches.
+static int gpt_match(CgptFindParams *params, struct drive *drive,
+                     uint8_t *comparebuf, struct gpt_found **matches_ptr) {
+  uint32_t i;
   GptEntry *entry;
-  int retval = 0;
+  int count = 0, kept = 0;
   char partlabel[GPT_PARTNAME_LEN];
+  struct gpt_found *matches;
+  uint64_t pos;
 
-  if (GPT_SUCCESS != GptValidityCheck(&drive->gpt)) {
+  *matches_ptr = NULL;
+  matches = malloc(sizeof(*matches) * GetNumberOfEntries(drive));
+  if (!matches) {
+    Error("Unable to allocate memory for matches\n");
     return 0;
   }
+  *matches_ptr = matches;
 
-  for (i = 0; i < GetNumberOfEntries(drive); ++i) {
-    entry = GetEntry(&drive->gpt, ANY_VALID, i);
-
-    if (GuidIsZero(&entry->type))
-      continue;
-
+  for (i = 0; (entry = GetNextNonEmptyEntry(drive, &i)); ++i) {
     int found = 0;
     if ((params->set_unique && GuidEqual(&params->unique_guid, &entry->unique))
         || (params->set_type && GuidEqual(&params->type_guid, &entry->type))) {
@@ -126,37 +140,161 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
                                  sizeof(entry->name) / sizeof(entry->name[0]),
                                  (uint8_t *)partlabel, sizeof(partlabel))) {
         Error("The label cannot be converted from UTF16, so abort.\n");
-        return 0;
+        break;
       }
       if (!strncmp(params->label, partlabel, sizeof(partlabel)))
         found = 1;
     }
-    if (found && match_content(params, drive, entry)) {
-      params->hits++;
-      retval++;
-      showmatch(params, filename, i+1, entry);
-      if (!params->match_partnum)
-        params->match_partnum = i+1;
+    if (!found)
+      continue;
+
+    // Let the reads of all candidates' content start before comparing any.
+    if (params->matchlen && content_region(params, drive, entry, &pos))
+      posix_fadvise(drive->fd, pos, params->matchlen, POSIX_FADV_WILLNEED);
+    matches[count++].index = i;
+  }
+
+  for (i = 0; i < count; ++i) {
+    entry = GetEntry(&drive->gpt, ANY_VALID, matches[i].index);
+    if (match_content(params, drive, entry, comparebuf)) {
+      matches[kept].index = matches[i].index;
+      matches[kept++].entry = *entry;
     }
   }
 
-  return retval;
+  return kept;
 }
 
+// This shows the matches found by gpt_match on a drive. The filename and
+// partition number that matched is left in params, since we could have
+// multiple hits.
+static void gpt_show(CgptFindParams *params, const char *filename,
+                     struct gpt_found *matches, int count) {
+  int i;
+
+  for (i = 0; i < count; ++i) {
+    params->hits++;
+    showmatch(params, filename, matches[i].index + 1, &matches[i].entry);
+    if (!params->match_partnum)
+      params->match_partnum = matches[i].index + 1;
+  }
+}
+
+// This returns true if a GPT partition in the file matches the search
+// criteria. If a match isn't found (or if the file doesn't contain a GPT), it
+// returns false.
 static int do_search(CgptFindParams *params, const char *fileName) {
   int retval;
   struct drive drive;
+  struct gpt_found *matches;
 
-  if (CGPT_OK != DriveOpen(fileName, &drive, O_RDONLY, params->drive_size))
+  if (CGPT_OK != DriveOpenReadOnly(fileName, &drive, params->drive_size))
     return 0;
 
-  retval = gpt_search(params, &drive, fileName);
-
+  retval = gpt_match(params, &drive, params->comparebuf, &matches);
   (void) DriveClose(&drive, 0);
 
+  gpt_show(params, fileName, matches, retval);
+  free(matches);
+
   return retval;
 }
 
+// Most devices opened and searched at the same time by scan_real_devs.
+#define MAX_SCAN_THREADS 8
+
+// A whole device found by scan_real_devs, and what matched on it.
+struct scan_dev {
+  char *pathname;
+  struct gpt_found *matches;
+  int count;
+};
+
+struct scan_pool {
+  CgptFindParams *params;
+  struct scan_dev *devs;
+  int num_devs;
+  int next;  // Next device to search.
+  pthread_mutex_t lock;
+};
+
+// Opens and searches a device, keeping only the matches for showing them.
+static void scan_dev(CgptFindParams *params, struct scan_dev *dev) {
+  struct drive drive;
+  uint8_t *comparebuf = NULL;
+
+  if (params->matchlen) {
+    comparebuf = malloc(params->matchlen);
+    if (!comparebuf) {
+      Error("Unable to allocate memory to search %s\n", dev->pathname);
+      return;
+    }
+  }
+
+  if (CGPT_OK == DriveOpenReadOnly(dev->pathname, &drive,
+                                   params->drive_size)) {
+    dev->count = gpt_match(params, &drive, comparebuf, &dev->matches);
+    (void) DriveClose(&drive, 0);
+  }
+  free(comparebuf);
+}
+
+static void *scan_worker(void *arg) {
+  struct scan_pool *pool = arg;
+
+  while (1) {
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (i >= pool->num_devs)
+      break;
+    scan_dev(pool->params, &pool->devs[i]);
+  }
+  return NULL;
+}
+
+// Searches the devices using a pool of threads, since opening a device and
+// reading its GPT mostly waits for the device. The matches are shown
+// afterwards, in the order of the devices. Returns the number of devices with
+// matches.
+static int scan_devs(CgptFindParams *params, struct scan_dev *devs,
+                     int num_devs) {
+  pthread_t threads[MAX_SCAN_THREADS - 1];
+  int num_threads = 0;
+  struct scan_pool pool = {
+    .params = params,
+    .devs = devs,
+    .num_devs = num_devs,
+  };
+  int found = 0;
+  int i;
+
+  pthread_mutex_init(&pool.lock, NULL);
+  // This thread works too, so the search is done even if none can start.
+  while (num_threads < MAX_SCAN_THREADS - 1 && num_threads + 1 < num_devs) {
+    if (pthread_create(&threads[num_threads], NULL, scan_worker, &pool))
+      break;
+    num_threads++;
+  }
+  scan_worker(&pool);
+  for (i = 0; i < num_threads; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&pool.lock);
+
+  for (i = 0; i < num_devs; i++) {
+    struct scan_dev *dev = &devs[i];
+
+    gpt_show(params, dev->pathname, dev->matches, dev->count);
+    if (dev->count)
+      found++;
+    free(dev->matches);
+  }
+  return found;
+}
+
 
 #define PROC_MTD "/proc/mtd"
 #define PROC_PARTITIONS "/proc/partitions"
@@ -294,6 +432,8 @@ static int scan_real_devs(CgptFindParams *params) {
 
   size_t line_length = 0;
   char *line = NULL;
+  struct scan_dev *devs = NULL;
+  int num_devs = 0;
   partname_prev[0] = '\0';
   while (getline(&line, &line_length, fp) != -1) {
     int ma, mi;
@@ -308,9 +448,17 @@ static int scan_real_devs(CgptFindParams *params) {
     if (!strncmp(partname_prev, partname, strlen(partname_prev)) &&
         strlen(partname_prev)) {
       if ((pathname = is_wholedev(partname_prev))) {
-        if (do_search(params, pathname)) {
-          found++;
+        struct scan_dev *new_devs = realloc(devs,
+                                            sizeof(*devs) * (num_devs + 1));
+        if (!new_devs) {
+          Error("Unable to allocate memory for %s\n", pathname);
+          break;
         }
+        devs = new_devs;
+        memset(&devs[num_devs], 0, sizeof(*devs));
+        devs[num_devs].pathname = strdup(pathname);
+        if (devs[num_devs].pathname)
+          num_devs++;
       }
     }
 
@@ -320,6 +468,11 @@ static int scan_real_devs(CgptFindParams *params) {
   fclose(fp);
   free(line);
 
+  found += scan_devs(params, devs, num_devs);
+  while (num_devs--)
+    free(devs[num_devs].pathname);
+  free(devs);
+
   found += scan_spi_gpt(params);
 
   return found;
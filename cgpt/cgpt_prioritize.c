@@ -140,19 +140,14 @@ int CgptPrioritize(CgptPrioritizeParams *params) {
   }
 
   // How many kernel partitions do I have?
-  num_kernels = 0;
-  for (i = 0; i < max_part; i++) {
-    if (IsKernel(&drive, PRIMARY, i))
-      num_kernels++;
-  }
+  GptBuildKernelIndex(&drive.gpt);
+  num_kernels = drive.gpt.num_kernel_entries;
 
   if (num_kernels) {
     // Determine the current priority groups
     groups = NewGroupList(num_kernels);
-    for (i = 0; i < max_part; i++) {
-      if (!IsKernel(&drive, PRIMARY, i))
-        continue;
-
+    for (j = 0; j < num_kernels; j++) {
+      i = drive.gpt.kernel_index[j];
       priority = GetPriority(&drive, PRIMARY, i);
 
       // Is this partition special?
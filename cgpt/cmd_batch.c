@@ -0,0 +1,185 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
+
+#include "cgpt.h"
+#include "vboot_host.h"
+
+extern const char* progname;
+
+// Most arguments in a line of the script, not counting the command and DRIVE.
+#define MAX_BATCH_ARGS 32
+
+static void Usage(void)
+{
+  printf("\nUsage: %s batch [OPTIONS] DRIVE\n\n"
+         "Run a script of commands on DRIVE. The GPT is loaded once, and\n"
+         "written once if all commands succeed; otherwise DRIVE is not\n"
+         "changed (except by commands writing the PMBR).\n\n"
+         "Each line of the script is a command with its options but without\n"
+         "DRIVE, for example:\n\n"
+         "  add -i 2 -t kernel -b 100 -s 30 -l \"KERN-A\"\n"
+         "  prioritize -i 2\n\n"
+         "Empty lines and lines starting with # are ignored.\n\n"
+         "Options:\n"
+         "  -f FILE      Script to run; default is standard input\n"
+         "  -D NUM       Size (in bytes) of the disk where partitions reside;\n"
+         "                 default 0, meaning partitions and GPT structs are\n"
+         "                 both on DRIVE. Applies to all commands.\n"
+         "\n", progname);
+}
+
+// Splits a line of the script in place into words, separated by white space.
+// Single or double quotes may be used for words containing spaces.
+// Returns the number of words, or -1 if there are too many or a quote is not
+// closed.
+static int SplitLine(char *line, char *words[], int max_words) {
+  int count = 0;
+  char *p = line;
+
+  while (1) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+      p++;
+    if (!*p || *p == '#')
+      break;
+    if (count == max_words) {
+      Error("too many arguments\n");
+      return -1;
+    }
+
+    if (*p == '"' || *p == '\'') {
+      char *end = strchr(p + 1, *p);
+      if (!end) {
+        Error("missing closing quote\n");
+        return -1;
+      }
+      words[count++] = p + 1;
+      *end = '\0';
+      p = end + 1;
+    } else {
+      words[count++] = p;
+      p += strcspn(p, " \t\r\n");
+      if (*p)
+        *p++ = '\0';
+    }
+  }
+  return count;
+}
+
+static int RunScript(FILE *script, const char *script_name, char *drive_name) {
+  char *line = NULL;
+  size_t line_size = 0;
+  int line_number = 0;
+  int retval = CGPT_OK;
+
+  while (getline(&line, &line_size, script) != -1) {
+    char *op_argv[MAX_BATCH_ARGS + 2];
+    int op_argc;
+
+    line_number++;
+    op_argc = SplitLine(line, op_argv, MAX_BATCH_ARGS + 1);
+    if (op_argc == 0)
+      continue;
+    if (op_argc < 0) {
+      retval = CGPT_FAILED;
+    } else if (strncmp(op_argv[0], "batch", strlen(op_argv[0])) == 0) {
+      Error("batch can't be used in a script\n");
+      retval = CGPT_FAILED;
+    } else {
+      op_argv[op_argc] = drive_name;
+      op_argv[op_argc + 1] = NULL;
+      // 0 also resets getopt state left by a half-parsed option group.
+      optind = 0;
+      retval = RunCommand(op_argc + 1, op_argv);
+    }
+    if (retval != CGPT_OK) {
+      Error("%s:%d: command failed\n", script_name, line_number);
+      break;
+    }
+  }
+
+  free(line);
+  return retval;
+}
+
+int cmd_batch(int argc, char *argv[]) {
+  const char *script_name = NULL;
+  uint64_t drive_size = 0;
+  FILE *script = stdin;
+  char *drive_name;
+  int retval;
+
+  int c;
+  int errorcnt = 0;
+  char *e = 0;
+
+  opterr = 0;                     // quiet, you
+  while ((c=getopt(argc, argv, ":hf:D:")) != -1)
+  {
+    switch (c)
+    {
+    case 'D':
+      drive_size = strtoull(optarg, &e, 0);
+      errorcnt += check_int_parse(c, e);
+      break;
+    case 'f':
+      script_name = optarg;
+      break;
+
+    case 'h':
+      Usage();
+      return CGPT_OK;
+    case '?':
+      Error("unrecognized option: -%c\n", optopt);
+      errorcnt++;
+      break;
+    case ':':
+      Error("missing argument to -%c\n", optopt);
+      errorcnt++;
+      break;
+    default:
+      errorcnt++;
+      break;
+    }
+  }
+  if (errorcnt)
+  {
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  if (optind >= argc) {
+    Error("missing drive argument\n");
+    Usage();
+    return CGPT_FAILED;
+  }
+
+  drive_name = argv[optind];
+
+  if (script_name) {
+    script = fopen(script_name, "r");
+    if (!script) {
+      Error("Can't open %s: %s\n", script_name, strerror(errno));
+      return CGPT_FAILED;
+    }
+  } else {
+    script_name = "<stdin>";
+  }
+
+  if (CGPT_OK != DriveSessionBegin(drive_name, drive_size)) {
+    retval = CGPT_FAILED;
+  } else {
+    retval = RunScript(script, script_name, drive_name);
+    if (CGPT_OK != DriveSessionEnd(retval == CGPT_OK))
+      retval = CGPT_FAILED;
+  }
+
+  if (script != stdin)
+    fclose(script);
+  return retval;
+}
@@ -16,7 +16,7 @@
 #include "2sysincludes.h"
 #include "2tpm_bootmode.h"
 
-vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
+static vb2_error_t fw_phase1(struct vb2_context *ctx)
 {
 	vb2_error_t rv;
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -102,7 +102,13 @@ vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
+vb2_error_t vb2api_fw_phase1(struct vb2_context *ctx)
+{
+	vb2_timing_start(ctx, VB2_TIMING_FW_PHASE1);
+	return vb2_timing_end(ctx, VB2_TIMING_FW_PHASE1, fw_phase1(ctx));
+}
+
+static vb2_error_t fw_phase2(struct vb2_context *ctx)
 {
 	/*
 	 * Use the slot from the last boot if this is a resume.  Do not set
@@ -135,6 +141,12 @@ vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_fw_phase2(struct vb2_context *ctx)
+{
+	vb2_timing_start(ctx, VB2_TIMING_FW_PHASE2);
+	return vb2_timing_end(ctx, VB2_TIMING_FW_PHASE2, fw_phase2(ctx));
+}
+
 vb2_error_t vb2api_extend_hash(struct vb2_context *ctx,
 		       const void *buf,
 		       uint32_t size)
@@ -192,17 +204,29 @@ vb2_error_t vb2api_get_pcr_digest(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
-vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx)
+static vb2_error_t fw_phase3(struct vb2_context *ctx)
 {
 	/* Verify firmware keyblock */
-	VB2_TRY(vb2_load_fw_keyblock(ctx), ctx, VB2_RECOVERY_RO_INVALID_RW);
+	vb2_timing_start(ctx, VB2_TIMING_FW_KEYBLOCK);
+	VB2_TRY(vb2_timing_end(ctx, VB2_TIMING_FW_KEYBLOCK,
+			       vb2_load_fw_keyblock(ctx)),
+		ctx, VB2_RECOVERY_RO_INVALID_RW);
 
 	/* Verify firmware preamble */
-	VB2_TRY(vb2_load_fw_preamble(ctx), ctx, VB2_RECOVERY_RO_INVALID_RW);
+	vb2_timing_start(ctx, VB2_TIMING_FW_PREAMBLE);
+	VB2_TRY(vb2_timing_end(ctx, VB2_TIMING_FW_PREAMBLE,
+			       vb2_load_fw_preamble(ctx)),
+		ctx, VB2_RECOVERY_RO_INVALID_RW);
 
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_fw_phase3(struct vb2_context *ctx)
+{
+	vb2_timing_start(ctx, VB2_TIMING_FW_PHASE3);
+	return vb2_timing_end(ctx, VB2_TIMING_FW_PHASE3, fw_phase3(ctx));
+}
+
 vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -226,6 +250,8 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 	if (tag != VB2_HASH_TAG_FW_BODY)
 		return VB2_ERROR_API_INIT_HASH_TAG;
 
+	vb2_timing_start(ctx, VB2_TIMING_FW_BODY_HASH);
+
 	/* Allocate workbuf space for the hash */
 	if (sd->hash_size) {
 		dc = (struct vb2_digest_context *)
@@ -290,7 +316,7 @@ vb2_error_t vb2api_init_hash(struct vb2_context *ctx, uint32_t tag)
 	return vb2_digest_init(dc, key.hash_alg);
 }
 
-vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
+static vb2_error_t check_hash_get_digest(struct vb2_context *ctx,
 					 void *digest_out,
 					 uint32_t digest_out_size)
 {
@@ -366,6 +392,15 @@ vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2api_check_hash_get_digest(struct vb2_context *ctx,
+					 void *digest_out,
+					 uint32_t digest_out_size)
+{
+	return vb2_timing_end(ctx, VB2_TIMING_FW_BODY_HASH,
+			      check_hash_get_digest(ctx, digest_out,
+						    digest_out_size));
+}
+
 int vb2api_check_hash(struct vb2_context *ctx)
 {
 	return vb2api_check_hash_get_digest(ctx, NULL, 0);
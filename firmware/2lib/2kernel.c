@@ -120,7 +120,7 @@ int vb2api_is_developer_signed(struct vb2_context *ctx)
 	return 0;
 }
 
-vb2_error_t vb2api_kernel_phase1(struct vb2_context *ctx)
+static vb2_error_t kernel_phase1(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
 	struct vb2_workbuf wb;
@@ -197,3 +197,10 @@ vb2_error_t vb2api_kernel_phase1(struct vb2_context *ctx)
 
 	return VB2_SUCCESS;
 }
+
+vb2_error_t vb2api_kernel_phase1(struct vb2_context *ctx)
+{
+	vb2_timing_start(ctx, VB2_TIMING_KERNEL_PHASE1);
+	return vb2_timing_end(ctx, VB2_TIMING_KERNEL_PHASE1,
+			      kernel_phase1(ctx));
+}
@@ -193,6 +193,13 @@ vb2_error_t vb2_fw_init_gbb(struct vb2_context *ctx)
 	return VB2_SUCCESS;
 }
 
+static vb2_error_t tpm_clear_owner(struct vb2_context *ctx)
+{
+	vb2_timing_start(ctx, VB2_TIMING_TPM_CLEAR_OWNER);
+	return vb2_timing_end(ctx, VB2_TIMING_TPM_CLEAR_OWNER,
+			      vb2ex_tpm_clear_owner(ctx));
+}
+
 vb2_error_t vb2_check_dev_switch(struct vb2_context *ctx)
 {
 	struct vb2_shared_data *sd = vb2_get_sd(ctx);
@@ -272,7 +279,7 @@ vb2_error_t vb2_check_dev_switch(struct vb2_context *ctx)
 		 * boot* is different than the last one (perhaps due to GBB or
 		 * hardware override).
 		 */
-		rv = vb2ex_tpm_clear_owner(ctx);
+		rv = tpm_clear_owner(ctx);
 		/* Check for failure to clear owner */
 		if (valid_secdata && rv) {
 			/*
@@ -305,7 +312,7 @@ vb2_error_t vb2_check_tpm_clear(struct vb2_context *ctx)
 	vb2_nv_set(ctx, VB2_NV_CLEAR_TPM_OWNER_REQUEST, 0);
 
 	/* Try clearing */
-	rv = vb2ex_tpm_clear_owner(ctx);
+	rv = tpm_clear_owner(ctx);
 	if (rv) {
 		/*
 		 * Note that this truncates rv to 8 bit.  Which is not as
@@ -503,6 +510,45 @@ void vb2api_export_vbsd(struct vb2_context *ctx, void *dest)
 _Static_assert(VB2_VBSD_SIZE == sizeof(VbSharedDataHeader),
 	       "VB2_VBSD_SIZE incorrect");
 
+void vb2_timing_record(struct vb2_context *ctx, uint16_t tag, uint16_t flags)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_timing_event *event =
+		&sd->timing_events[sd->timing_count % VB2_TIMING_MAX_EVENTS];
+
+	event->time_ms = vb2ex_mtime();
+	event->tag = tag;
+	event->flags = flags;
+	sd->timing_count++;
+}
+
+void vb2api_export_timing(struct vb2_context *ctx, void *dest)
+{
+	struct vb2_shared_data *sd = vb2_get_sd(ctx);
+	struct vb2_timing_export *timing = dest;
+	uint32_t first = 0;
+	uint32_t i;
+
+	memset(timing, 0, VB2_TIMING_EXPORT_SIZE);
+	timing->magic = VB2_TIMING_EXPORT_MAGIC;
+	timing->struct_version_major = VB2_TIMING_EXPORT_VERSION_MAJOR;
+	timing->struct_version_minor = VB2_TIMING_EXPORT_VERSION_MINOR;
+
+	timing->event_count = sd->timing_count;
+	if (sd->timing_count > VB2_TIMING_MAX_EVENTS) {
+		first = sd->timing_count - VB2_TIMING_MAX_EVENTS;
+		timing->event_count = VB2_TIMING_MAX_EVENTS;
+		timing->dropped_count = first;
+	}
+
+	/* Unroll the ring so the oldest event comes first */
+	for (i = 0; i < timing->event_count; i++)
+		timing->events[i] = sd->timing_events[(first + i) %
+						       VB2_TIMING_MAX_EVENTS];
+}
+_Static_assert(VB2_TIMING_EXPORT_SIZE == sizeof(struct vb2_timing_export),
+	       "VB2_TIMING_EXPORT_SIZE incorrect");
+
 int vb2api_phone_recovery_enabled(struct vb2_context *ctx)
 {
 	return !(vb2_secdata_kernel_get(ctx, VB2_SECDATA_KERNEL_FLAGS) &
@@ -46,6 +46,170 @@ int vb2_mont_ge(const struct vb2_public_key *key, uint32_t *a)
 	return 1;  /* equal */
 }
 
+#if defined(RSA_64BIT_LIMBS) && defined(__SIZEOF_INT128__)
+/*
+ * Montgomery arithmetic on 64-bit limbs with a 128-bit accumulator. This needs
+ * a quarter of the multiply instructions of the 32-bit version on 64-bit
+ * CPUs. The arrays keep their uint32_t layout (so the work buffer and key
+ * formats are unchanged); limb i is words 2i and 2i+1. RSA key sizes are all
+ * multiples of 64 bits, so arrsize is always even.
+ */
+#define VB2_RSA_LIMB64
+
+typedef unsigned __int128 vb2_uint128_t;
+
+static inline uint64_t get64(const uint32_t *a, uint32_t i)
+{
+	return a[2 * i] | (uint64_t)a[2 * i + 1] << 32;
+}
+
+static inline void put64(uint32_t *a, uint32_t i, uint64_t v)
+{
+	a[2 * i] = (uint32_t)v;
+	a[2 * i + 1] = (uint32_t)(v >> 32);
+}
+
+/**
+ * Return -1 / n[0] mod 2^64, extended from the key's 32-bit n0inv.
+ */
+static uint64_t n0inv64(const struct vb2_public_key *key)
+{
+	uint64_t inv = (uint32_t)-key->n0inv;  /* 1 / n[0] mod 2^32 */
+
+	/* One Newton step doubles the number of correct bits. */
+	inv *= 2 - get64(key->n, 0) * inv;
+	return -inv;
+}
+
+/**
+ * Montgomery c[] += a * b[] / R % mod
+ */
+static void montMulAdd64(const struct vb2_public_key *key, uint64_t n0inv,
+			 uint32_t *c, const uint64_t a, const uint32_t *b)
+{
+	const uint32_t limbs = key->arrsize / 2;
+	vb2_uint128_t A = (vb2_uint128_t)a * get64(b, 0) + get64(c, 0);
+	uint64_t d0 = (uint64_t)A * n0inv;
+	vb2_uint128_t B = (vb2_uint128_t)d0 * get64(key->n, 0) + (uint64_t)A;
+	uint32_t i;
+
+	for (i = 1; i < limbs; ++i) {
+		A = (A >> 64) + (vb2_uint128_t)a * get64(b, i) + get64(c, i);
+		B = (B >> 64) + (vb2_uint128_t)d0 * get64(key->n, i) +
+			(uint64_t)A;
+		put64(c, i - 1, (uint64_t)B);
+	}
+
+	A = (A >> 64) + (B >> 64);
+
+	put64(c, i - 1, (uint64_t)A);
+
+	if (A >> 64)
+		subM(key, c);
+}
+
+/**
+ * Montgomery c[] = a[] * b[] / R % mod
+ */
+static void montMul64(const struct vb2_public_key *key, uint64_t n0inv,
+		      uint32_t *c, const uint32_t *a, const uint32_t *b)
+{
+	uint32_t i;
+
+	for (i = 0; i < key->arrsize; ++i)
+		c[i] = 0;
+	for (i = 0; i < key->arrsize / 2; ++i)
+		montMulAdd64(key, n0inv, c, get64(a, i), b);
+}
+
+/**
+ * Montgomery reduction c[] = t[] / R % mod
+ *
+ * @param t		Double-length input; destroyed
+ * @param c		Result; may overlap the low half of t[]
+ */
+static void montRedc64(const struct vb2_public_key *key, uint64_t n0inv,
+		       uint32_t *c, uint32_t *t)
+{
+	const uint32_t limbs = key->arrsize / 2;
+	uint64_t top = 0;
+	vb2_uint128_t A;
+	uint64_t m;
+	uint32_t i, j;
+
+	for (i = 0; i < limbs; ++i) {
+		m = get64(t, i) * n0inv;
+		A = 0;
+		for (j = 0; j < limbs; ++j) {
+			A = (A >> 64) + (vb2_uint128_t)m * get64(key->n, j) +
+				get64(t, i + j);
+			put64(t, i + j, (uint64_t)A);
+		}
+		A = (A >> 64) + get64(t, i + limbs) + top;
+		put64(t, i + limbs, (uint64_t)A);
+		top = (uint64_t)(A >> 64);
+	}
+
+	for (i = 0; i < key->arrsize; ++i)
+		c[i] = t[key->arrsize + i];
+
+	if (top)
+		subM(key, c);
+}
+
+/**
+ * Montgomery c[] = a[] * a[] / R % mod
+ *
+ * Each cross product a[i] * a[j] is computed once and doubled, which saves
+ * nearly half the multiplies of montMul64().
+ *
+ * @param c		Result; may be the same as a[]
+ * @param t		Scratch of 2 * key->arrsize words, not overlapping a[]
+ *			or c[]
+ */
+static void montSqr64(const struct vb2_public_key *key, uint64_t n0inv,
+		      uint32_t *c, const uint32_t *a, uint32_t *t)
+{
+	const uint32_t limbs = key->arrsize / 2;
+	vb2_uint128_t A;
+	uint64_t ai, hi, lo;
+	uint32_t i, j;
+
+	for (i = 0; i < 2 * key->arrsize; ++i)
+		t[i] = 0;
+
+	/* Cross products */
+	for (i = 0; i < limbs; ++i) {
+		ai = get64(a, i);
+		A = 0;
+		for (j = i + 1; j < limbs; ++j) {
+			A = (A >> 64) + (vb2_uint128_t)ai * get64(a, j) +
+				get64(t, i + j);
+			put64(t, i + j, (uint64_t)A);
+		}
+		put64(t, i + limbs, (uint64_t)(A >> 64));
+	}
+
+	/* Double them, and add the squares on the diagonal */
+	hi = 0;
+	A = 0;
+	for (i = 0; i < limbs; ++i) {
+		ai = get64(a, i);
+		lo = get64(t, 2 * i);
+		A = (A >> 64) + (vb2_uint128_t)ai * ai + (lo << 1 | hi);
+		put64(t, 2 * i, (uint64_t)A);
+		hi = lo >> 63;
+		lo = get64(t, 2 * i + 1);
+		A = (A >> 64) + (lo << 1 | hi);
+		put64(t, 2 * i + 1, (uint64_t)A);
+		hi = lo >> 63;
+	}
+
+	montRedc64(key, n0inv, c, t);
+}
+
+#else  /* !RSA_64BIT_LIMBS */
+
 /**
  * Montgomery c[] += a * b[] / R % mod
  */
@@ -125,6 +289,27 @@ static void montMul1(const struct vb2_public_key *key,
 		montMulAdd0(key, c, a);
 }
 
+#endif  /* RSA_64BIT_LIMBS */
+
+/**
+ * Convert from big endian byte array to little endian word array.
+ */
+static void be_to_words(const struct vb2_public_key *key, uint32_t *a,
+			const uint8_t *in)
+{
+	int i;
+
+	for (i = 0; i < (int)key->arrsize; ++i) {
+		uint32_t tmp =
+			((uint32_t)in[((key->arrsize - 1 - i) * 4) + 0]
+				<< 24) |
+			(in[((key->arrsize - 1 - i) * 4) + 1] << 16) |
+			(in[((key->arrsize - 1 - i) * 4) + 2] << 8) |
+			(in[((key->arrsize - 1 - i) * 4) + 3] << 0);
+		a[i] = tmp;
+	}
+}
+
 /**
  * In-place public exponentiation.
  *
@@ -141,19 +326,26 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 	uint32_t *aR = a + key->arrsize;
 	uint32_t *aaR = aR + key->arrsize;
 	uint32_t *aaa = aaR;  /* Re-use location. */
+#ifdef VB2_RSA_LIMB64
+	uint64_t n0inv = n0inv64(key);
+#endif
 	int i;
 
-	/* Convert from big endian byte array to little endian word array. */
-	for (i = 0; i < (int)key->arrsize; ++i) {
-		uint32_t tmp =
-			((uint32_t)inout[((key->arrsize - 1 - i) * 4) + 0]
-				<< 24) |
-			(inout[((key->arrsize - 1 - i) * 4) + 1] << 16) |
-			(inout[((key->arrsize - 1 - i) * 4) + 2] << 8) |
-			(inout[((key->arrsize - 1 - i) * 4) + 3] << 0);
-		a[i] = tmp;
-	}
+	be_to_words(key, a, inout);
 
+#ifdef VB2_RSA_LIMB64
+	/*
+	 * a^3 or a^65537: square in place at aaR 1 or 16 times, using a..aR
+	 * as the double-length scratch, then reload a from |inout|, which is
+	 * not written until the end.
+	 */
+	montMul64(key, n0inv, aaR, a, key->rr);  /* aaR = a * RR / R */
+	for (i = 0; i < (exp == 3 ? 1 : 16); i++)
+		montSqr64(key, n0inv, aaR, aaR, a);  /* aaR = aaR * aaR / R */
+	be_to_words(key, a, inout);
+	aaa = aR;
+	montMul64(key, n0inv, aaa, aaR, a);  /* aaa = aaR * a / R */
+#else
 	montMul(key, aR, a, key->rr);  /* aR = a * RR / R mod M   */
 	if (exp == 3) {
 		montMul(key, aaR, aR, aR); /* aaR = aR * aR / R mod M */
@@ -167,6 +359,7 @@ static void modpow(const struct vb2_public_key *key, uint8_t *inout,
 		}
 		montMul(key, aaa, aR, a);  /* aaa = aR * a / R mod M */
 	}
+#endif
 
 	/* Make sure aaa < mod; aaa is at most 1x mod too large. */
 	if (vb2_mont_ge(key, aaa)) {
@@ -0,0 +1,148 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Runtime selection of SHA256 CPU extensions for host utilities.
+ *
+ * Firmware targets pick their SHA implementation at build time (see
+ * X86_SHA_EXT and vb2ex_hwcrypto_*). Host tools run on whatever machine they
+ * are copied to, so probe the CPU once and use the SHA extensions (x86 SHA-NI
+ * or ARMv8 Crypto) when present, falling back to the portable C transform.
+ */
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+enum sha_hw_state {
+	SHA_HW_UNKNOWN = 0,
+	SHA_HW_ABSENT,
+	SHA_HW_PRESENT,
+};
+
+static enum sha_hw_state sha_hw;
+static int sha_hw_allowed = 1;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+static int sha_hw_probe(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* The transform uses SSSE3 pshufb for byte swapping */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSSE3))
+		return 0;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return !!(ebx & bit_SHA);
+}
+
+static void sha_hw_transform(uint32_t *h, const uint8_t *message,
+			     unsigned int block_nb)
+{
+	uint32_t ni[8];
+
+	/* SHA-NI keeps the state as F, E, B, A and H, G, D, C */
+	ni[0] = h[5]; ni[1] = h[4]; ni[2] = h[1]; ni[3] = h[0];
+	ni[4] = h[7]; ni[5] = h[6]; ni[6] = h[3]; ni[7] = h[2];
+
+	vb2_sha256_transform_x86ext(ni, message, block_nb);
+
+	h[0] = ni[3]; h[1] = ni[2]; h[2] = ni[7]; h[3] = ni[6];
+	h[4] = ni[1]; h[5] = ni[0]; h[6] = ni[5]; h[7] = ni[4];
+}
+
+#elif defined(__aarch64__)
+
+static int sha_hw_probe(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+}
+
+__attribute__((target("+crypto")))
+static void sha_hw_transform(uint32_t *h, const uint8_t *message,
+			     unsigned int block_nb)
+{
+	uint32x4_t abcd = vld1q_u32(&h[0]);
+	uint32x4_t efgh = vld1q_u32(&h[4]);
+
+	while (block_nb--) {
+		uint32x4_t abcd_save = abcd;
+		uint32x4_t efgh_save = efgh;
+		uint32x4_t w[4];
+		int i;
+
+		for (i = 0; i < 4; i++)
+			w[i] = vreinterpretq_u32_u8(
+				vrev32q_u8(vld1q_u8(message + 16 * i)));
+
+		/* 16 groups of 4 rounds; schedule the next words as we go */
+		for (i = 0; i < 16; i++) {
+			const uint32x4_t k = vld1q_u32(&vb2_sha256_k[4 * i]);
+			uint32x4_t wk = vaddq_u32(w[i % 4], k);
+			uint32x4_t tmp = abcd;
+
+			if (i < 12)
+				w[i % 4] = vsha256su1q_u32(
+					vsha256su0q_u32(w[i % 4],
+							w[(i + 1) % 4]),
+					w[(i + 2) % 4], w[(i + 3) % 4]);
+
+			abcd = vsha256hq_u32(abcd, efgh, wk);
+			efgh = vsha256h2q_u32(efgh, tmp, wk);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+		message += VB2_SHA256_BLOCK_SIZE;
+	}
+
+	vst1q_u32(&h[0], abcd);
+	vst1q_u32(&h[4], efgh);
+}
+
+#else
+
+static int sha_hw_probe(void)
+{
+	return 0;
+}
+
+static void sha_hw_transform(uint32_t *h, const uint8_t *message,
+			     unsigned int block_nb)
+{
+}
+
+#endif
+
+int vb2_sha256_transform_hw(uint32_t *h, const uint8_t *message,
+			    unsigned int block_nb)
+{
+	if (!sha_hw_allowed)
+		return 0;
+
+	/*
+	 * Racing threads may both probe, but they store the same answer, so
+	 * there is no need for locking here.
+	 */
+	if (sha_hw == SHA_HW_UNKNOWN)
+		sha_hw = sha_hw_probe() ? SHA_HW_PRESENT : SHA_HW_ABSENT;
+	if (sha_hw != SHA_HW_PRESENT)
+		return 0;
+
+	sha_hw_transform(h, message, block_nb);
+	return 1;
+}
+
+void vb2_sha_hw_allow(int allow)
+{
+	sha_hw_allowed = allow;
+}
@@ -615,6 +615,18 @@ vb2_error_t vb2api_relocate(void *new_workbuf, const void *cur_workbuf,
  */
 void vb2api_export_vbsd(struct vb2_context *ctx, void *dest);
 
+/**
+ * Export boot timing events.
+ *
+ * Copy the timing events recorded so far to a vb2_timing_export struct, so
+ * the caller can hand them to the OS.  Expects the memory available to be of
+ * size VB2_TIMING_EXPORT_SIZE.
+ *
+ * @param ctx		Context pointer
+ * @param dest		Target memory to store vb2_timing_export
+ */
+void vb2api_export_timing(struct vb2_context *ctx, void *dest);
+
 /**
  * Check the validity of firmware secure storage context.
  *
@@ -86,4 +86,7 @@ typedef uint32_t vb2_gbb_flags_t;
    the struct definition as part of a vb2_api.h include. */
 #define VB2_VBSD_SIZE 1096
 
+/* Size of struct vb2_timing_export, for the same reason. */
+#define VB2_TIMING_EXPORT_SIZE 272
+
 #endif  /* VBOOT_REFERENCE_2CONSTANTS_H_ */
@@ -206,4 +206,46 @@ void vb2_fill_dev_boot_flags(struct vb2_context *ctx);
  */
 void vb2_set_boot_mode(struct vb2_context *ctx);
 
+/**
+ * Record a boot timing event in the shared data.
+ *
+ * The most recent VB2_TIMING_MAX_EVENTS events are kept; older ones are
+ * overwritten.  Callers normally use vb2_timing_start() and vb2_timing_end().
+ *
+ * @param ctx		Vboot context
+ * @param tag		Step (enum vb2_timing_step), optionally with
+ *			VB2_TIMING_END
+ * @param flags		Event flags; see VB2_TIMING_FLAG_*
+ */
+void vb2_timing_record(struct vb2_context *ctx, uint16_t tag, uint16_t flags);
+
+/**
+ * Record the start of a timed boot step.
+ *
+ * @param ctx		Vboot context
+ * @param step		Step which is starting
+ */
+static inline void vb2_timing_start(struct vb2_context *ctx,
+				    enum vb2_timing_step step)
+{
+	vb2_timing_record(ctx, step, 0);
+}
+
+/**
+ * Record the end of a timed boot step.
+ *
+ * @param ctx		Vboot context
+ * @param step		Step which has ended
+ * @param rv		Result of the step
+ * @return rv, so this can wrap the call being timed.
+ */
+static inline vb2_error_t vb2_timing_end(struct vb2_context *ctx,
+					 enum vb2_timing_step step,
+					 vb2_error_t rv)
+{
+	vb2_timing_record(ctx, step | VB2_TIMING_END,
+			  rv ? VB2_TIMING_FLAG_FAILED : 0);
+	return rv;
+}
+
 #endif  /* VBOOT_REFERENCE_2MISC_H_ */
@@ -19,6 +19,43 @@
 
 extern const uint32_t vb2_sha256_h0[8];
 extern const uint32_t vb2_sha256_k[64];
+extern const uint64_t vb2_sha512_k[80];
+
+/**
+ * SHA256 block transform using the x86 SHA extension.
+ *
+ * @param state		Hash state in SHA-NI order (F, E, B, A, H, G, D, C)
+ * @param message	Data to process
+ * @param block_nb	Number of VB2_SHA256_BLOCK_SIZE blocks at |message|
+ */
+void vb2_sha256_transform_x86ext(uint32_t *state, const uint8_t *message,
+				 unsigned int block_nb);
+
+#ifdef SHA_RUNTIME_DISPATCH
+/**
+ * Run SHA256 block transform with CPU crypto extensions, if available.
+ *
+ * The extensions are probed on first use.
+ *
+ * @param h		Hash state, in the order of vb2_sha256_context.h
+ * @param message	Data to process
+ * @param block_nb	Number of VB2_SHA256_BLOCK_SIZE blocks at |message|
+ * @return 1 if the blocks were processed, 0 if the caller must fall back to
+ * the portable C transform.
+ */
+int vb2_sha256_transform_hw(uint32_t *h, const uint8_t *message,
+			    unsigned int block_nb);
+
+/**
+ * Allow or forbid use of CPU crypto extensions for SHA.
+ *
+ * They are allowed by default. Meant for tests and benchmarks that need to
+ * compare against the portable C transform.
+ *
+ * @param allow		Non-zero to allow
+ */
+void vb2_sha_hw_allow(int allow);
+#endif
 
 #define UNPACK32(x, str)				\
 	{						\
@@ -35,4 +72,28 @@ extern const uint32_t vb2_sha256_k[64];
 			| ((uint32_t) *((str) + 1) << 16)       \
 			| ((uint32_t) *((str) + 0) << 24);      \
 	}
+
+#define UNPACK64(x, str)					\
+	{							\
+		*((str) + 7) = (uint8_t) x;			\
+		*((str) + 6) = (uint8_t) ((uint64_t)x >> 8);	\
+		*((str) + 5) = (uint8_t) ((uint64_t)x >> 16);	\
+		*((str) + 4) = (uint8_t) ((uint64_t)x >> 24);	\
+		*((str) + 3) = (uint8_t) ((uint64_t)x >> 32);	\
+		*((str) + 2) = (uint8_t) ((uint64_t)x >> 40);	\
+		*((str) + 1) = (uint8_t) ((uint64_t)x >> 48);	\
+		*((str) + 0) = (uint8_t) ((uint64_t)x >> 56);	\
+	}
+
+#define PACK64(str, x)						\
+	{							\
+		*(x) =   ((uint64_t) *((str) + 7)      )	\
+			| ((uint64_t) *((str) + 6) <<  8)       \
+			| ((uint64_t) *((str) + 5) << 16)       \
+			| ((uint64_t) *((str) + 4) << 24)       \
+			| ((uint64_t) *((str) + 3) << 32)       \
+			| ((uint64_t) *((str) + 2) << 40)       \
+			| ((uint64_t) *((str) + 1) << 48)       \
+			| ((uint64_t) *((str) + 0) << 56);      \
+	}
 #endif  /* VBOOT_REFERENCE_2SHA_PRIVATE_H_ */
@@ -100,11 +100,49 @@ enum vb2_shared_data_status {
 
 /* Current version of vb2_shared_data struct */
 #define VB2_SHARED_DATA_VERSION_MAJOR 3
-#define VB2_SHARED_DATA_VERSION_MINOR 1
+#define VB2_SHARED_DATA_VERSION_MINOR 2
 
 /* MAX_SIZE should not be changed without bumping up DATA_VERSION_MAJOR. */
 #define VB2_CONTEXT_MAX_SIZE 384
 
+/* Boot steps which are timed; see vb2_timing_record() */
+enum vb2_timing_step {
+	VB2_TIMING_FW_PHASE1 = 1,
+	VB2_TIMING_FW_PHASE2 = 2,
+	VB2_TIMING_FW_PHASE3 = 3,
+	VB2_TIMING_FW_KEYBLOCK = 4,
+	VB2_TIMING_FW_PREAMBLE = 5,
+	VB2_TIMING_FW_BODY_HASH = 6,
+	VB2_TIMING_KERNEL_PHASE1 = 7,
+	VB2_TIMING_GPT_READ = 8,
+	VB2_TIMING_KERNEL_KEYBLOCK = 9,
+	VB2_TIMING_KERNEL_PREAMBLE = 10,
+	VB2_TIMING_KERNEL_BODY = 11,
+	VB2_TIMING_COMMIT_DATA = 12,
+	VB2_TIMING_TPM_CLEAR_OWNER = 13,
+};
+
+/* Flag in vb2_timing_event.tag for the end of a step */
+#define VB2_TIMING_END 0x8000
+
+/* Flag in vb2_timing_event.flags for a step which returned an error */
+#define VB2_TIMING_FLAG_FAILED 0x0001
+
+/* Number of boot timing events kept in vb2_shared_data */
+#define VB2_TIMING_MAX_EVENTS 32
+
+/* Boot timing event */
+struct vb2_timing_event {
+	/* Time from vb2ex_mtime() */
+	uint32_t time_ms;
+
+	/* Step (enum vb2_timing_step), plus VB2_TIMING_END at its end */
+	uint16_t tag;
+
+	/* Flags; see VB2_TIMING_FLAG_* */
+	uint16_t flags;
+} __attribute__((packed));
+
 /*
  * Data shared between vboot API calls.  Stored at the start of the work
  * buffer.
@@ -257,6 +295,46 @@ struct vb2_shared_data {
 	 */
 	uint32_t kernel_key_offset;
 	uint32_t kernel_key_size;
+
+	/**********************************************************************
+	 * Boot timing events; see vb2_timing_record().  Only the most recent
+	 * VB2_TIMING_MAX_EVENTS are kept, with event number N stored at
+	 * timing_events[N % VB2_TIMING_MAX_EVENTS].
+	 */
+
+	/* Number of events recorded so far, including overwritten ones */
+	uint32_t timing_count;
+
+	struct vb2_timing_event timing_events[VB2_TIMING_MAX_EVENTS];
+} __attribute__((packed));
+
+/* "VTIM" = vb2_timing_export.magic */
+#define VB2_TIMING_EXPORT_MAGIC 0x4d495456
+
+/* Current version of vb2_timing_export struct */
+#define VB2_TIMING_EXPORT_VERSION_MAJOR 1
+#define VB2_TIMING_EXPORT_VERSION_MINOR 0
+
+/*
+ * Boot timing events exported for the OS by vb2api_export_timing().  Stored
+ * by the caller wherever the OS can find it, and shown by "futility show".
+ */
+struct vb2_timing_export {
+	/* Magic number for struct (VB2_TIMING_EXPORT_MAGIC) */
+	uint32_t magic;
+
+	/* Version of this structure */
+	uint16_t struct_version_major;
+	uint16_t struct_version_minor;
+
+	/* Number of valid entries in events[] */
+	uint32_t event_count;
+
+	/* Number of older events which were overwritten and are lost */
+	uint32_t dropped_count;
+
+	/* Events, oldest first */
+	struct vb2_timing_event events[VB2_TIMING_MAX_EVENTS];
 } __attribute__((packed));
 
 /****************************************************************************/
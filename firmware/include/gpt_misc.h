@@ -69,6 +69,9 @@ enum {
 /* If this bit is 1, the GPT is stored in another from the streaming data */
 #define GPT_FLAG_EXTERNAL	0x1
 
+/* Size of the kernel entry index in GptData; same as the most GPT entries. */
+#define GPT_KERNEL_INDEX_SIZE	128
+
 /*
  * A note about stored_on_device and gpt_drive_sectors:
  *
@@ -114,6 +117,13 @@ typedef struct {
 	/* Internal variables */
 	uint8_t valid_headers, valid_entries, ignored;
 	int current_priority;
+	/*
+	 * Indexes of the kernel entries, by decreasing priority (then by
+	 * increasing index), built by GptInit().
+	 */
+	uint8_t kernel_index[GPT_KERNEL_INDEX_SIZE];
+	uint8_t num_kernel_entries;
+	uint8_t kernel_index_valid;
 } GptData;
 
 /**
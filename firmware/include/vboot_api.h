@@ -50,6 +50,13 @@ typedef struct VbSelectAndLoadKernelParams {
 	void *kernel_buffer;
 	/* Size of kernel buffer in bytes */
 	uint32_t kernel_buffer_size;
+	/*
+	 * If non-zero, read the kernel body this many bytes at a time and
+	 * hash each chunk as soon as it is read.  Should be a multiple of the
+	 * disk sector size.  If zero, the whole body is read before it is
+	 * hashed.
+	 */
+	uint32_t body_read_chunk_size;
 
 	/*
 	 * Outputs from VbSelectAndLoadKernel(); valid only if it returns
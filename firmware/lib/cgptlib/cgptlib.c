@@ -26,89 +26,60 @@ int GptInit(GptData *gpt)
 	}
 
 	GptRepair(gpt);
+	GptBuildKernelIndex(gpt);
 	return GPT_SUCCESS;
 }
 
 int GptNextKernelEntry(GptData *gpt, uint64_t *start_sector, uint64_t *size)
 {
-	GptHeader *header = (GptHeader *)gpt->primary_header;
 	GptEntry *entries = (GptEntry *)gpt->primary_entries;
 	GptEntry *e;
-	int new_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
-	int new_prio = 0;
-	uint32_t i;
+	int n;
 
-	/*
-	 * If we already found a kernel, continue the scan at the current
-	 * kernel's priority, in case there is another kernel with the same
-	 * priority.
-	 */
-	if (gpt->current_kernel != CGPT_KERNEL_ENTRY_NOT_FOUND) {
-		for (i = gpt->current_kernel + 1;
-		     i < header->number_of_entries; i++) {
-			e = entries + i;
-			if (!IsKernelEntry(e))
-				continue;
-			VB2_DEBUG("GptNextKernelEntry looking at same prio "
-				  "partition %d\n", i+1);
-			VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-				  GetEntrySuccessful(e), GetEntryTries(e),
-				  GetEntryPriority(e));
-			if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
-				continue;
-			if (GetEntryPriority(e) == gpt->current_priority) {
-				gpt->current_kernel = i;
-				*start_sector = e->starting_lba;
-				*size = e->ending_lba - e->starting_lba + 1;
-				VB2_DEBUG("GptNextKernelEntry likes it\n");
-				return GPT_SUCCESS;
-			}
-		}
-	}
+	if (!gpt->kernel_index_valid)
+		GptBuildKernelIndex(gpt);
 
 	/*
-	 * We're still here, so scan for the remaining kernel with the highest
-	 * priority less than the previous attempt.
+	 * The kernels are indexed in the order they should be tried, so the
+	 * next one is the first usable kernel after the current one: either
+	 * with the same priority and a higher index, or with a lower priority.
 	 */
-	for (i = 0, e = entries; i < header->number_of_entries; i++, e++) {
-		int current_prio = GetEntryPriority(e);
+	for (n = 0; n < gpt->num_kernel_entries; n++) {
+		int i = gpt->kernel_index[n];
+		int prio;
+
+		e = entries + i;
 		if (!IsKernelEntry(e))
 			continue;
-		VB2_DEBUG("GptNextKernelEntry looking at new prio "
-			  "partition %d\n", i+1);
+		prio = GetEntryPriority(e);
+		VB2_DEBUG("GptNextKernelEntry looking at partition %d\n", i+1);
 		VB2_DEBUG("GptNextKernelEntry s%d t%d p%d\n",
-			  GetEntrySuccessful(e), GetEntryTries(e),
-			  GetEntryPriority(e));
-		if (!(GetEntrySuccessful(e) || GetEntryTries(e)))
+			  GetEntrySuccessful(e), GetEntryTries(e), prio);
+		if (!(GetEntrySuccessful(e) || GetEntryTries(e)) || !prio)
+			continue;
+		if (prio > gpt->current_priority)
 			continue;
-		if (current_prio >= gpt->current_priority) {
+		if (prio == gpt->current_priority &&
+		    (gpt->current_kernel == CGPT_KERNEL_ENTRY_NOT_FOUND ||
+		     i <= gpt->current_kernel)) {
 			/* Already returned this kernel in a previous call */
 			continue;
 		}
-		if (current_prio > new_prio) {
-			new_kernel = i;
-			new_prio = current_prio;
-		}
-	}
-
-	/*
-	 * Save what we found.  Note that if we didn't find a new kernel,
-	 * new_prio will still be -1, so future calls to this function will
-	 * also fail.
-	 */
-	gpt->current_kernel = new_kernel;
-	gpt->current_priority = new_prio;
 
-	if (CGPT_KERNEL_ENTRY_NOT_FOUND == new_kernel) {
-		VB2_DEBUG("GptNextKernelEntry no more kernels\n");
-		return GPT_ERROR_NO_VALID_KERNEL;
+		VB2_DEBUG("GptNextKernelEntry likes partition %d\n", i+1);
+		gpt->current_kernel = i;
+		gpt->current_priority = prio;
+		*start_sector = e->starting_lba;
+		*size = e->ending_lba - e->starting_lba + 1;
+		return GPT_SUCCESS;
 	}
 
-	VB2_DEBUG("GptNextKernelEntry likes partition %d\n", new_kernel + 1);
-	e = entries + new_kernel;
-	*start_sector = e->starting_lba;
-	*size = e->ending_lba - e->starting_lba + 1;
-	return GPT_SUCCESS;
+	/* Future calls to this function will also fail. */
+	gpt->current_kernel = CGPT_KERNEL_ENTRY_NOT_FOUND;
+	gpt->current_priority = 0;
+
+	VB2_DEBUG("GptNextKernelEntry no more kernels\n");
+	return GPT_ERROR_NO_VALID_KERNEL;
 }
 
 /*
@@ -185,6 +156,9 @@ int GptUpdateKernelWithEntry(GptData *gpt, GptEntry *e, uint32_t update_type)
 
 	if (modified) {
 		GptModified(gpt);
+		/* Keep the kernels in order of their new priorities. */
+		if (gpt->kernel_index_valid)
+			GptBuildKernelIndex(gpt);
 	}
 
 	return GPT_SUCCESS;
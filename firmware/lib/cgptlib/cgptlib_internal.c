@@ -159,6 +159,36 @@ int IsKernelEntry(const GptEntry *e)
 	return !memcmp(&e->type, &chromeos_kernel, sizeof(Guid));
 }
 
+void GptBuildKernelIndex(GptData *gpt)
+{
+	GptHeader *header = (GptHeader *)gpt->primary_header;
+	GptEntry *entries = (GptEntry *)gpt->primary_entries;
+	uint32_t i;
+	int j, count = 0;
+
+	for (i = 0; i < header->number_of_entries &&
+		     count < GPT_KERNEL_INDEX_SIZE; i++) {
+		int priority;
+
+		if (!IsKernelEntry(entries + i))
+			continue;
+
+		/* Insert by priority, after the kernels with the same. */
+		priority = GetEntryPriority(entries + i);
+		for (j = count; j > 0; j--) {
+			GptEntry *e = entries + gpt->kernel_index[j - 1];
+			if (GetEntryPriority(e) >= priority)
+				break;
+			gpt->kernel_index[j] = gpt->kernel_index[j - 1];
+		}
+		gpt->kernel_index[j] = i;
+		count++;
+	}
+
+	gpt->num_kernel_entries = count;
+	gpt->kernel_index_valid = 1;
+}
+
 int CheckEntries(GptEntry *entries, GptHeader *h)
 {
 	if (!entries)
@@ -99,7 +99,7 @@ static uint32_t crc32_tab[] = {
 };
 
 
-uint32_t Crc32(const void *buffer, uint32_t len)
+uint32_t Crc32Reference(const void *buffer, uint32_t len)
 {
 	uint8_t *byte = (uint8_t *)buffer;
 	uint32_t i;
@@ -109,3 +109,12 @@ uint32_t Crc32(const void *buffer, uint32_t len)
 		value = crc32_tab[(value ^ byte[i]) & 0xff] ^ (value >> 8);
 	return value ^ ~0U;
 }
+
+uint32_t Crc32(const void *buffer, uint32_t len)
+{
+#ifdef CRC32_RUNTIME_DISPATCH
+	return Crc32Fast(buffer, len);
+#else
+	return Crc32Reference(buffer, len);
+#endif
+}
@@ -153,6 +153,13 @@ void GptModified(GptData *gpt);
  */
 int IsKernelEntry(const GptEntry *e);
 
+/**
+ * Build the index of kernel entries (gpt->kernel_index) from the primary
+ * entries.  Must be called again if the entries are changed other than by
+ * GptUpdateKernelWithEntry().
+ */
+void GptBuildKernelIndex(GptData *gpt);
+
 /**
  * Copy the current kernel partition's UniquePartitionGuid to the dest.
  */
@@ -8,6 +8,31 @@
 
 #include "2sysincludes.h"
 
+/**
+ * Calculate the CRC32 used by GPT headers and entry arrays.
+ *
+ * Host builds use Crc32Fast(); firmware uses Crc32Reference().
+ */
 uint32_t Crc32(const void *buffer, uint32_t len);
 
+/**
+ * Byte-at-a-time CRC32. Small, and the reference for the faster versions.
+ */
+uint32_t Crc32Reference(const void *buffer, uint32_t len);
+
+#ifdef CRC32_RUNTIME_DISPATCH
+/**
+ * Slice-by-8 CRC32, folding with carry-less multiply (PCLMULQDQ or PMULL) on
+ * CPUs that support it. Returns the same value as Crc32Reference().
+ */
+uint32_t Crc32Fast(const void *buffer, uint32_t len);
+
+/**
+ * Allow or forbid use of carry-less multiply in Crc32Fast().
+ *
+ * Allowed by default. Meant for tests and benchmarks.
+ */
+void Crc32AllowHw(int allow);
+#endif
+
 #endif  /* VBOOT_REFERENCE_CRC32_H_ */
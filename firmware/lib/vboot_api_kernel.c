@@ -29,6 +29,13 @@ struct VbSelectAndLoadKernelParams **VbApiKernelGetParamsPtr(void)
 }
 #endif
 
+static vb2_error_t commit_data(struct vb2_context *ctx)
+{
+	vb2_timing_start(ctx, VB2_TIMING_COMMIT_DATA);
+	return vb2_timing_end(ctx, VB2_TIMING_COMMIT_DATA,
+			      vb2ex_commit_data(ctx));
+}
+
 static vb2_error_t handle_battery_cutoff(struct vb2_context *ctx)
 {
 	/*
@@ -42,7 +49,7 @@ static vb2_error_t handle_battery_cutoff(struct vb2_context *ctx)
 		vb2_nv_set(ctx, VB2_NV_BATTERY_CUTOFF_REQUEST, 0);
 
 		/* May lose power immediately, so commit our update now. */
-		VB2_TRY(vb2ex_commit_data(ctx));
+		VB2_TRY(commit_data(ctx));
 
 		vb2ex_ec_battery_cutoff();
 		return VB2_REQUEST_SHUTDOWN;
@@ -205,7 +212,7 @@ vb2_error_t VbSelectAndLoadKernel(struct vb2_context *ctx,
 		 * Need to commit nvdata changes immediately, since we will be
 		 * entering either manual recovery UI or BROKEN screen shortly.
 		 */
-		vb2ex_commit_data(ctx);
+		commit_data(ctx);
 
 		/*
 		 * In EFS2, recovery mode can be entered even when battery is
@@ -230,7 +237,7 @@ vb2_error_t VbSelectAndLoadKernel(struct vb2_context *ctx,
 		 * forced system reset occurs.
 		 */
 		vb2_nv_set(ctx, VB2_NV_DIAG_REQUEST, 0);
-		vb2ex_commit_data(ctx);
+		commit_data(ctx);
 
 		/* Diagnostic boot.  This has UI. */
 		VB2_TRY(vb2ex_diagnostic_ui(ctx));
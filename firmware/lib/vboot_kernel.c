@@ -188,7 +188,10 @@ static vb2_error_t vb2_verify_kernel_vblock(
 
 	/* Verify the keyblock. */
 	struct vb2_keyblock *keyblock = get_keyblock(kbuf);
-	rv = vb2_verify_keyblock(keyblock, kbuf_size, &kernel_key, wb);
+	vb2_timing_start(ctx, VB2_TIMING_KERNEL_KEYBLOCK);
+	rv = vb2_timing_end(ctx, VB2_TIMING_KERNEL_KEYBLOCK,
+			    vb2_verify_keyblock(keyblock, kbuf_size,
+						&kernel_key, wb));
 	if (rv) {
 		VB2_DEBUG("Verifying keyblock signature failed.\n");
 		keyblock_valid = 0;
@@ -284,10 +287,12 @@ static vb2_error_t vb2_verify_kernel_vblock(
 
 	/* Verify the preamble, which follows the keyblock */
 	struct vb2_kernel_preamble *preamble = get_preamble(kbuf);
-	rv = vb2_verify_kernel_preamble(preamble,
-					kbuf_size - keyblock->keyblock_size,
-					&data_key,
-					wb);
+	vb2_timing_start(ctx, VB2_TIMING_KERNEL_PREAMBLE);
+	rv = vb2_timing_end(ctx, VB2_TIMING_KERNEL_PREAMBLE,
+			    vb2_verify_kernel_preamble(
+				    preamble,
+				    kbuf_size - keyblock->keyblock_size,
+				    &data_key, wb));
 	if (rv) {
 		VB2_DEBUG("Preamble verification failed.\n");
 		return rv;
@@ -338,21 +343,180 @@ static vb2_error_t vb2_verify_kernel_vblock(
 	return VB2_SUCCESS;
 }
 
+/**
+ * Extend a digest started by vb2_load_body_chunked().
+ */
+static vb2_error_t body_digest_extend(struct vb2_digest_context *dc,
+				      const uint8_t *buf, uint32_t size)
+{
+	if (dc->using_hwcrypto)
+		return vb2ex_hwcrypto_digest_extend(buf, size);
+	return vb2_digest_extend(dc, buf, size);
+}
+
+/**
+ * Read the rest of the kernel body in chunks and verify it.
+ *
+ * Each chunk is added to the body digest as soon as it has been read, while
+ * it is still in cache (or, with a hardware crypto engine, so the engine can
+ * work on it before the next read), instead of hashing the whole body once
+ * it has all been read.
+ *
+ * @param stream	Stream to read the body from
+ * @param body		Kernel body buffer
+ * @param body_copied	Bytes at the start of body already read
+ * @param chunk_size	Bytes to read at a time
+ * @param key		Key to verify the body with
+ * @param sig		Body signature (may be destroyed in process)
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+static vb2_error_t vb2_load_body_chunked(
+	VbExStream_t stream, uint8_t *body, uint32_t body_copied,
+	uint32_t chunk_size, const struct vb2_public_key *key,
+	struct vb2_signature *sig, const struct vb2_workbuf *wb)
+{
+	struct vb2_workbuf wblocal = *wb;
+	struct vb2_digest_context *dc;
+	uint32_t digest_size = vb2_digest_size(key->hash_alg);
+	uint32_t offset, size;
+	uint8_t *digest;
+	vb2_error_t rv;
+
+	dc = vb2_workbuf_alloc(&wblocal, sizeof(*dc));
+	digest = vb2_workbuf_alloc(&wblocal, digest_size);
+	if (!dc || !digest)
+		return VB2_ERROR_LOAD_PARTITION_WORKBUF;
+
+	rv = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	if (key->allow_hwcrypto) {
+		rv = vb2ex_hwcrypto_digest_init(key->hash_alg, sig->data_size);
+		if (rv == VB2_SUCCESS) {
+			VB2_DEBUG("Using HW crypto engine for hash_alg %d\n",
+				  key->hash_alg);
+			dc->hash_alg = key->hash_alg;
+			dc->using_hwcrypto = 1;
+		} else if (rv != VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED) {
+			VB2_DEBUG("HW crypto init error : %d\n", rv);
+			return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+		}
+	}
+	if (rv && vb2_digest_init(dc, key->hash_alg))
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+
+	if (body_digest_extend(dc, body, body_copied))
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+
+	for (offset = body_copied; offset < sig->data_size; offset += size) {
+		size = VB2_MIN(chunk_size, sig->data_size - offset);
+		if (VbExStreamRead(stream, size, body + offset)) {
+			VB2_DEBUG("Unable to read kernel data.\n");
+			return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		}
+		if (body_digest_extend(dc, body + offset, size))
+			return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+	}
+
+	if (dc->using_hwcrypto)
+		rv = vb2ex_hwcrypto_digest_finalize(digest, digest_size);
+	else
+		rv = vb2_digest_finalize(dc, digest, digest_size);
+	if (rv || vb2_verify_digest(key, sig, digest, &wblocal)) {
+		VB2_DEBUG("Kernel data verification failed.\n");
+		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+	}
+
+	return VB2_SUCCESS;
+}
+
+/**
+ * Read more of the vblock, up to at least [want] bytes from its start.
+ *
+ * Reads are rounded up to whole sectors, and never go past KBUF_SIZE.
+ *
+ * @param stream	Stream to read from
+ * @param kbuf		Buffer of KBUF_SIZE bytes
+ * @param size		Bytes already in kbuf; updated
+ * @param want		Bytes needed
+ * @param sector_bytes	Disk sector size
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+static vb2_error_t read_vblock_to(VbExStream_t stream, uint8_t *kbuf,
+				  uint32_t *size, uint64_t want,
+				  uint32_t sector_bytes)
+{
+	want = (want + sector_bytes - 1) / sector_bytes * sector_bytes;
+	if (want > KBUF_SIZE)
+		want = KBUF_SIZE;
+	if (want <= *size)
+		return VB2_SUCCESS;
+
+	VB2_TRY(VbExStreamRead(stream, want - *size, kbuf + *size));
+	*size = want;
+	return VB2_SUCCESS;
+}
+
+/**
+ * Read only the vblock from the start of a partition.
+ *
+ * Reads the keyblock header to find where the preamble is, then the preamble
+ * header to find where it ends, then the rest of the preamble, instead of
+ * always reading KBUF_SIZE bytes.  The sizes come from unverified headers,
+ * so they only bound the reads; vb2_verify_kernel_vblock() checks them.
+ *
+ * @param stream	Stream to read from
+ * @param kbuf		Buffer of KBUF_SIZE bytes
+ * @param sector_bytes	Disk sector size
+ * @param size		Destination for the number of bytes read
+ * @return VB2_SUCCESS, or non-zero error code.
+ */
+static vb2_error_t read_vblock(VbExStream_t stream, uint8_t *kbuf,
+			       uint32_t sector_bytes, uint32_t *size)
+{
+	struct vb2_keyblock *keyblock = (struct vb2_keyblock *)kbuf;
+	struct vb2_kernel_preamble *preamble;
+	uint32_t keyblock_size;
+
+	*size = 0;
+
+	/* Reads must be whole sectors; if they can't be, read it all */
+	if (!sector_bytes || KBUF_SIZE % sector_bytes)
+		return read_vblock_to(stream, kbuf, size, KBUF_SIZE, 1);
+
+	VB2_TRY(read_vblock_to(stream, kbuf, size, sizeof(*keyblock),
+			       sector_bytes));
+	keyblock_size = keyblock->keyblock_size;
+	VB2_TRY(read_vblock_to(stream, kbuf, size, (uint64_t)keyblock_size +
+			       sizeof(*preamble), sector_bytes));
+	if ((uint64_t)keyblock_size + sizeof(*preamble) > *size)
+		return VB2_SUCCESS;  /* Too big; verification will fail */
+
+	preamble = (struct vb2_kernel_preamble *)(kbuf + keyblock_size);
+	return read_vblock_to(stream, kbuf, size, (uint64_t)keyblock_size +
+			      preamble->preamble_size, sector_bytes);
+}
+
 /**
  * Load and verify a partition from the stream.
  *
+ * With VB2_LOAD_PARTITION_FLAG_VBLOCK_ONLY, only the sectors holding the
+ * vblock are read.
+ *
  * @param ctx		Vboot context
  * @param params	Load-kernel parameters
+ * @param disk_info	Disk the stream is on
  * @param stream	Stream to load kernel from
  * @param lpflags	Flags (one or more of vb2_load_partition_flags)
  * @return VB2_SUCCESS, or non-zero error code.
  */
 static vb2_error_t vb2_load_partition(
 	struct vb2_context *ctx, VbSelectAndLoadKernelParams *params,
-	VbExStream_t stream, uint32_t lpflags)
+	VbDiskInfo *disk_info, VbExStream_t stream, uint32_t lpflags)
 {
 	uint32_t read_ms = 0, start_ts;
+	uint32_t kbuf_read = KBUF_SIZE;
 	struct vb2_workbuf wb;
+	vb2_error_t rv;
 
 	vb2_workbuf_from_ctx(ctx, &wb);
 
@@ -362,17 +526,24 @@ static vb2_error_t vb2_load_partition(
 		return VB2_ERROR_LOAD_PARTITION_WORKBUF;
 
 	start_ts = vb2ex_mtime();
-	if (VbExStreamRead(stream, KBUF_SIZE, kbuf)) {
+	if (lpflags & VB2_LOAD_PARTITION_FLAG_VBLOCK_ONLY)
+		rv = read_vblock(stream, kbuf, disk_info->bytes_per_lba,
+				 &kbuf_read);
+	else
+		rv = VbExStreamRead(stream, KBUF_SIZE, kbuf);
+	if (rv) {
 		VB2_DEBUG("Unable to read start of partition.\n");
 		return VB2_ERROR_LOAD_PARTITION_READ_VBLOCK;
 	}
 	read_ms += vb2ex_mtime() - start_ts;
 
-	if (vb2_verify_kernel_vblock(ctx, kbuf, KBUF_SIZE, lpflags, &wb))
+	if (vb2_verify_kernel_vblock(ctx, kbuf, kbuf_read, lpflags, &wb))
 		return VB2_ERROR_LOAD_PARTITION_VERIFY_VBLOCK;
 
-	if (lpflags & VB2_LOAD_PARTITION_FLAG_VBLOCK_ONLY)
+	if (lpflags & VB2_LOAD_PARTITION_FLAG_VBLOCK_ONLY) {
+		VB2_DEBUG("read %u byte vblock.\n", kbuf_read);
 		return VB2_SUCCESS;
+	}
 
 	struct vb2_keyblock *keyblock = get_keyblock(kbuf);
 	struct vb2_kernel_preamble *preamble = get_preamble(kbuf);
@@ -415,11 +586,32 @@ static vb2_error_t vb2_load_partition(
 	body_toread -= body_copied;
 	body_readptr += body_copied;
 
+	/* Get key for preamble/data verification from the keyblock. */
+	struct vb2_public_key data_key;
+	if (vb2_unpack_key(&data_key, &keyblock->data_key)) {
+		VB2_DEBUG("Unable to unpack kernel data key\n");
+		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
+	}
+
+	if (vb2_hwcrypto_allowed(ctx))
+		data_key.allow_hwcrypto = 1;
+
 	/* Read the kernel data */
+	vb2_timing_start(ctx, VB2_TIMING_KERNEL_BODY);
 	start_ts = vb2ex_mtime();
-	if (body_toread && VbExStreamRead(stream, body_toread, body_readptr)) {
+	if (params->body_read_chunk_size) {
+		/* Hash it as we go, and verify it along the way */
+		rv = vb2_load_body_chunked(
+			stream, kernbuf, body_copied,
+			params->body_read_chunk_size, &data_key,
+			&preamble->body_signature, &wb);
+		if (rv)
+			return vb2_timing_end(ctx, VB2_TIMING_KERNEL_BODY, rv);
+	} else if (body_toread &&
+		   VbExStreamRead(stream, body_toread, body_readptr)) {
 		VB2_DEBUG("Unable to read kernel data.\n");
-		return VB2_ERROR_LOAD_PARTITION_READ_BODY;
+		return vb2_timing_end(ctx, VB2_TIMING_KERNEL_BODY,
+				      VB2_ERROR_LOAD_PARTITION_READ_BODY);
 	}
 	read_ms += vb2ex_mtime() - start_ts;
 	if (read_ms == 0)  /* Avoid division by 0 in speed calculation */
@@ -429,22 +621,15 @@ static vb2_error_t vb2_load_partition(
 		  (uint32_t)(((body_toread + KBUF_SIZE) * VB2_MSEC_PER_SEC) /
 			     (read_ms * 1024)));
 
-	/* Get key for preamble/data verification from the keyblock. */
-	struct vb2_public_key data_key;
-	if (vb2_unpack_key(&data_key, &keyblock->data_key)) {
-		VB2_DEBUG("Unable to unpack kernel data key\n");
-		return VB2_ERROR_LOAD_PARTITION_DATA_KEY;
-	}
-
-	if (vb2_hwcrypto_allowed(ctx))
-		data_key.allow_hwcrypto = 1;
-
 	/* Verify kernel data */
-	if (vb2_verify_data(kernbuf, kernbuf_size, &preamble->body_signature,
+	if (!params->body_read_chunk_size &&
+	    vb2_verify_data(kernbuf, kernbuf_size, &preamble->body_signature,
 			    &data_key, &wb)) {
 		VB2_DEBUG("Kernel data verification failed.\n");
-		return VB2_ERROR_LOAD_PARTITION_VERIFY_BODY;
+		return vb2_timing_end(ctx, VB2_TIMING_KERNEL_BODY,
+				      VB2_ERROR_LOAD_PARTITION_VERIFY_BODY);
 	}
+	vb2_timing_end(ctx, VB2_TIMING_KERNEL_BODY, VB2_SUCCESS);
 
 	/* If we're still here, the kernel is valid */
 	VB2_DEBUG("Partition is good.\n");
@@ -477,7 +662,7 @@ static vb2_error_t try_minios_kernel(struct vb2_context *ctx,
 		return rv;
 	}
 
-	rv = vb2_load_partition(ctx, params, stream, lpflags);
+	rv = vb2_load_partition(ctx, params, disk_info, stream, lpflags);
 	VB2_DEBUG("vb2_load_partition returned: %d\n", rv);
 
 	VbExStreamClose(stream);
@@ -617,7 +802,9 @@ vb2_error_t LoadKernel(struct vb2_context *ctx,
 	gpt.gpt_drive_sectors = disk_info->lba_count;
 	gpt.flags = disk_info->flags & VB_DISK_FLAG_EXTERNAL_GPT
 			? GPT_FLAG_EXTERNAL : 0;
-	if (AllocAndReadGptData(disk_info->handle, &gpt)) {
+	vb2_timing_start(ctx, VB2_TIMING_GPT_READ);
+	if (vb2_timing_end(ctx, VB2_TIMING_GPT_READ,
+			   AllocAndReadGptData(disk_info->handle, &gpt))) {
 		VB2_DEBUG("Unable to read GPT data\n");
 		goto gpt_done;
 	}
@@ -659,7 +846,8 @@ vb2_error_t LoadKernel(struct vb2_context *ctx,
 			lpflags |= VB2_LOAD_PARTITION_FLAG_VBLOCK_ONLY;
 		}
 
-		rv = vb2_load_partition(ctx, params, stream, lpflags);
+		rv = vb2_load_partition(ctx, params, disk_info, stream,
+					lpflags);
 		VbExStreamClose(stream);
 
 		if (rv) {
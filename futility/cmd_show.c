@@ -28,6 +28,7 @@
 #include "futility.h"
 #include "futility_options.h"
 #include "host_common.h"
+#include "host_key_cache.h"
 #include "host_key21.h"
 #include "util_misc.h"
 #include "vb1_helper.h"
@@ -148,7 +149,7 @@ done:
 int ft_show_keyblock(const char *name, void *data)
 {
 	struct vb2_keyblock *block;
-	struct vb2_public_key *sign_key = show_option.k;
+	const struct vb2_public_key *sign_key = show_option.k;
 	int good_sig = 0;
 	int retval = 0;
 	int fd = -1;
@@ -167,8 +168,8 @@ int ft_show_keyblock(const char *name, void *data)
 	}
 
 	/* Check the signature if we have one */
-	if (sign_key &&
-	    VB2_SUCCESS == vb2_verify_keyblock(block, len, sign_key, &wb))
+	if (sign_key && VB2_SUCCESS ==
+	    vb2_key_cache_verify_keyblock(block, len, sign_key, &wb))
 		good_sig = 1;
 
 	if (show_option.strict && (!sign_key || !good_sig))
@@ -186,7 +187,7 @@ int show_fw_preamble_buf(const char *name, uint8_t *buf, uint32_t len,
 {
 	struct vb2_keyblock *keyblock = (struct vb2_keyblock *)buf;
 	struct bios_state_s *state = (struct bios_state_s *)data;
-	struct vb2_public_key *sign_key = show_option.k;
+	const struct vb2_public_key *sign_key = show_option.k;
 	uint8_t *fv_data = show_option.fv;
 	uint64_t fv_size = show_option.fv_size;
 	struct bios_area_s *fw_body_area = 0;
@@ -205,15 +206,15 @@ int show_fw_preamble_buf(const char *name, uint8_t *buf, uint32_t len,
 	 * have no state, then we're just looking at a standalone fw_preamble,
 	 * so we'll have to get any keys or data from options.
 	 */
-	struct vb2_public_key root_key;
+	const struct vb2_public_key *root_key;
 	if (state) {
 		if (!sign_key &&
 		    state->rootkey.is_valid &&
-		    VB2_SUCCESS == vb2_unpack_key_buffer(&root_key,
-							 state->rootkey.buf,
-							 state->rootkey.len)) {
+		    VB2_SUCCESS == vb2_key_cache_unpack_buffer(
+					&root_key, state->rootkey.buf,
+					state->rootkey.len)) {
 			/* BIOS should have a rootkey in the GBB */
-			sign_key = &root_key;
+			sign_key = root_key;
 		}
 
 		/* Identify the firmware body for this VBLOCK */
@@ -225,7 +226,7 @@ int show_fw_preamble_buf(const char *name, uint8_t *buf, uint32_t len,
 
 	/* If we have a key, check the signature too */
 	if (sign_key && VB2_SUCCESS ==
-	    vb2_verify_keyblock(keyblock, len, sign_key, &wb))
+	    vb2_key_cache_verify_keyblock(keyblock, len, sign_key, &wb))
 		good_sig = 1;
 
 	show_keyblock(keyblock, name, !!sign_key, good_sig);
@@ -233,8 +234,9 @@ int show_fw_preamble_buf(const char *name, uint8_t *buf, uint32_t len,
 	if (show_option.strict && (!sign_key || !good_sig))
 		retval = 1;
 
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
+	const struct vb2_public_key *data_key;
+	if (VB2_SUCCESS !=
+	    vb2_key_cache_unpack(&data_key, &keyblock->data_key)) {
 		fprintf(stderr, "Error parsing data key in %s\n", name);
 		return 1;
 	}
@@ -242,7 +244,7 @@ int show_fw_preamble_buf(const char *name, uint8_t *buf, uint32_t len,
 	uint32_t more = keyblock->keyblock_size;
 	struct vb2_fw_preamble *pre2 = (struct vb2_fw_preamble *)(buf + more);
 	if (VB2_SUCCESS != vb2_verify_fw_preamble(pre2, len - more,
-						  &data_key, &wb)) {
+						  data_key, &wb)) {
 		printf("%s is invalid\n", name);
 		return 1;
 	}
@@ -290,7 +292,7 @@ int show_fw_preamble_buf(const char *name, uint8_t *buf, uint32_t len,
 
 	if (VB2_SUCCESS !=
 	    vb2_verify_data(fv_data, fv_size, &pre2->body_signature,
-			    &data_key, &wb)) {
+			    data_key, &wb)) {
 		fprintf(stderr, "Error verifying firmware body.\n");
 		return 1;
 	}
@@ -331,7 +333,7 @@ int ft_show_fw_preamble(const char *name, void *data)
 int ft_show_kernel_preamble(const char *name, void *data)
 {
 	struct vb2_keyblock *keyblock;
-	struct vb2_public_key *sign_key = show_option.k;
+	const struct vb2_public_key *sign_key = show_option.k;
 	int retval = 1;
 	int fd = -1;
 	uint8_t *buf;
@@ -351,14 +353,15 @@ int ft_show_kernel_preamble(const char *name, void *data)
 	/* If we have a key, check the signature too */
 	int good_sig = 0;
 	if (sign_key && VB2_SUCCESS ==
-	    vb2_verify_keyblock(keyblock, len, sign_key, &wb))
+	    vb2_key_cache_verify_keyblock(keyblock, len, sign_key, &wb))
 		good_sig = 1;
 
 	printf("Kernel partition:        %s\n", name);
 	show_keyblock(keyblock, NULL, !!sign_key, good_sig);
 
-	struct vb2_public_key data_key;
-	if (VB2_SUCCESS != vb2_unpack_key(&data_key, &keyblock->data_key)) {
+	const struct vb2_public_key *data_key;
+	if (VB2_SUCCESS !=
+	    vb2_key_cache_unpack(&data_key, &keyblock->data_key)) {
 		fprintf(stderr, "Error parsing data key in %s\n", name);
 		goto done;
 	}
@@ -368,7 +371,7 @@ int ft_show_kernel_preamble(const char *name, void *data)
 		(struct vb2_kernel_preamble *)(buf + more);
 
 	if (VB2_SUCCESS != vb2_verify_kernel_preamble(pre2, len - more,
-						      &data_key, &wb)) {
+						      data_key, &wb)) {
 		printf("%s is invalid\n", name);
 		goto done;
 	}
@@ -422,7 +425,7 @@ int ft_show_kernel_preamble(const char *name, void *data)
 
 	if (VB2_SUCCESS !=
 	    vb2_verify_data(kernel_blob, kernel_size, &pre2->body_signature,
-			    &data_key, &wb)) {
+			    data_key, &wb)) {
 		fprintf(stderr, "Error verifying kernel body.\n");
 		goto done;
 	}
@@ -528,7 +531,7 @@ static int show_type(char *filename)
 static int do_show(int argc, char *argv[])
 {
 	uint8_t *pubkbuf = NULL;
-	struct vb2_public_key pubk2;
+	const struct vb2_public_key *pubk2;
 	char *infile = 0;
 	int i;
 	int errorcnt = 0;
@@ -560,13 +563,13 @@ static int do_show(int argc, char *argv[])
 			}
 
 			if (VB2_SUCCESS !=
-			    vb2_unpack_key_buffer(&pubk2, pubkbuf, len)) {
+			    vb2_key_cache_unpack_buffer(&pubk2, pubkbuf, len)) {
 				fprintf(stderr, "Error unpacking %s\n", optarg);
 				errorcnt++;
 				break;
 			}
 
-			show_option.k = &pubk2;
+			show_option.k = pubk2;
 			break;
 		case 't':
 			show_option.t_flag = 1;
@@ -653,6 +656,7 @@ done:
 		free(pubkbuf);
 	if (show_option.fv)
 		free(show_option.fv);
+	vb2_key_cache_clear();
 
 	return !!errorcnt;
 }
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "2common.h"
@@ -54,6 +55,17 @@ static int no_opt_if(int expr, const char *optname)
 	return 0;
 }
 
+/* PEM signing key, read once so batch children share the parent's copy */
+static struct vb2_private_key *pem_signprivate;
+
+static struct vb2_private_key *read_pem_signpriv(void)
+{
+	if (!pem_signprivate)
+		pem_signprivate = vb2_read_private_key_pem(
+			sign_option.pem_signpriv, sign_option.pem_algo);
+	return pem_signprivate;
+}
+
 /* This wraps/signs a public key, producing a keyblock. */
 int ft_sign_pubkey(const char *name, void *data)
 {
@@ -82,17 +94,13 @@ int ft_sign_pubkey(const char *name, void *data)
 				sign_option.flags,
 				sign_option.pem_external);
 		} else {
-			sign_option.signprivate = vb2_read_private_key_pem(
-				sign_option.pem_signpriv,
-				sign_option.pem_algo);
-			if (!sign_option.signprivate) {
+			if (!read_pem_signpriv()) {
 				fprintf(stderr,
 					"Unable to read PEM signing key: %s\n",
 					strerror(errno));
 				goto done;
 			}
-			block = vb2_create_keyblock(data_key,
-						    sign_option.signprivate,
+			block = vb2_create_keyblock(data_key, pem_signprivate,
 						    sign_option.flags);
 		}
 	} else {
@@ -327,6 +335,9 @@ static const char usage_pubkey[] = "\n"
 	"  --pem_external   PROGRAM"
 	"         External program to compute the signature\n"
 	"                                     (requires a PEM signing key)\n"
+	"  --pem_coprocess"
+	"                  Keep PROGRAM running between signatures,\n"
+	"                                     if it supports --coprocess\n"
 	"\n";
 static void print_help_pubkey(int argc, char *argv[])
 {
@@ -548,6 +559,7 @@ static void (*help_type[NUM_FILE_TYPES])(int argc, char *argv[]) = {
 
 static const char usage_default[] = "\n"
 	"Usage:  " MYNAME " %s [PARAMS] INFILE [OUTFILE]\n"
+	"        " MYNAME " %s [PARAMS] --batch MANIFEST [--jobs N]\n"
 	"\n"
 	"The following signing operations are supported:\n"
 	"\n"
@@ -560,13 +572,20 @@ static const char usage_default[] = "\n"
 	"  usbpd1 firmware image               same, or signed in-place\n"
 	"  RW device image                     same, or signed in-place\n"
 	"\n"
+	"With --batch, each line of MANIFEST names an INFILE and optional\n"
+	"OUTFILE, separated by whitespace. Blank lines and lines starting\n"
+	"with '#' are ignored. The keys are loaded once and the files are\n"
+	"signed in up to N parallel jobs (default: one per CPU). The result\n"
+	"for each file is printed, and the exit status is nonzero if any\n"
+	"file failed.\n"
+	"\n"
 	"For more information, use \"" MYNAME " help %s TYPE\", where\n"
 	"TYPE is one of:\n\n";
 static void print_help_default(int argc, char *argv[])
 {
 	enum futil_file_type type;
 
-	printf(usage_default, argv[0], argv[0]);
+	printf(usage_default, argv[0], argv[0], argv[0]);
 	for (type = 0; type < NUM_FILE_TYPES; type++)
 		if (help_type[type])
 			printf("  %s", futil_file_type_name(type));
@@ -607,6 +626,8 @@ enum no_short_opts {
 	OPT_DATA_SIZE,
 	OPT_SIG_SIZE,
 	OPT_PRIKEY,
+	OPT_BATCH,
+	OPT_JOBS,
 	OPT_HELP,
 };
 
@@ -633,6 +654,7 @@ static const struct option long_opts[] = {
 	{"pem",          1, NULL, OPT_PEM_SIGNPRIV}, /* alias */
 	{"pem_algo",     1, NULL, OPT_PEM_ALGO},
 	{"pem_external", 1, NULL, OPT_PEM_EXTERNAL},
+	{"pem_coprocess", 0, &sign_option.pem_coprocess, 1},
 	{"type",         1, NULL, OPT_TYPE},
 	{"vblockonly",   0, &sign_option.vblockonly, 1},
 	{"hash_alg",     1, NULL, OPT_HASH_ALG},
@@ -644,6 +666,8 @@ static const struct option long_opts[] = {
 	{"sig_size",     1, NULL, OPT_SIG_SIZE},
 	{"prikey",       1, NULL, OPT_PRIKEY},
 	{"privkey",      1, NULL, OPT_PRIKEY},	/* alias */
+	{"batch",        1, NULL, OPT_BATCH},
+	{"jobs",         1, NULL, OPT_JOBS},
 	{"help",         0, NULL, OPT_HELP},
 	{NULL,           0, NULL, 0},
 };
@@ -662,9 +686,311 @@ static int parse_number_opt(const char *arg, const char *name, uint32_t *dest)
 	return 0;
 }
 
+/*
+ * Sign one file, using the keys and options already in sign_option. Return
+ * the number of errors.
+ */
+static int sign_file(char *infile)
+{
+	int errorcnt = 0;
+
+	/* What are we looking at? */
+	if (sign_option.type == FILE_TYPE_UNKNOWN &&
+	    futil_file_type(infile, &sign_option.type)) {
+		return 1;
+	}
+
+	/* We may be able to infer the type based on the other args */
+	if (sign_option.type == FILE_TYPE_UNKNOWN) {
+		if (sign_option.bootloader_data || sign_option.config_data
+		    || sign_option.arch != ARCH_UNSPECIFIED)
+			sign_option.type = FILE_TYPE_RAW_KERNEL;
+		else if (sign_option.kernel_subkey || sign_option.fv_specified)
+			sign_option.type = FILE_TYPE_RAW_FIRMWARE;
+	}
+
+	VB2_DEBUG("type=%s\n", futil_file_type_name(sign_option.type));
+
+	/* Check the arguments for the type of thing we want to sign */
+	switch (sign_option.type) {
+	case FILE_TYPE_PUBKEY:
+		sign_option.create_new_outfile = 1;
+		if (sign_option.signprivate && sign_option.pem_signpriv) {
+			fprintf(stderr,
+				"Only one of --signprivate and --pem_signpriv"
+				" can be specified\n");
+			errorcnt++;
+		}
+		if ((sign_option.signprivate &&
+		     sign_option.pem_algo_specified) ||
+		    (sign_option.pem_signpriv &&
+		     !sign_option.pem_algo_specified)) {
+			fprintf(stderr, "--pem_algo must be used with"
+				" --pem_signpriv\n");
+			errorcnt++;
+		}
+		if (sign_option.pem_external && !sign_option.pem_signpriv) {
+			fprintf(stderr, "--pem_external must be used with"
+				" --pem_signpriv\n");
+			errorcnt++;
+		}
+		if (sign_option.pem_coprocess && !sign_option.pem_external) {
+			fprintf(stderr, "--pem_coprocess must be used with"
+				" --pem_external\n");
+			errorcnt++;
+		}
+		/* We'll wait to read the PEM file, since the external signer
+		 * may want to read it instead. */
+		break;
+	case FILE_TYPE_BIOS_IMAGE:
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
+		break;
+	case FILE_TYPE_KERN_PREAMBLE:
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		if (sign_option.vblockonly || sign_option.inout_file_count > 1)
+			sign_option.create_new_outfile = 1;
+		break;
+	case FILE_TYPE_RAW_FIRMWARE:
+		sign_option.create_new_outfile = 1;
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
+		errorcnt += no_opt_if(!sign_option.version_specified,
+				      "version");
+		break;
+	case FILE_TYPE_RAW_KERNEL:
+		sign_option.create_new_outfile = 1;
+		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
+		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
+		errorcnt += no_opt_if(!sign_option.version_specified,
+				      "version");
+		errorcnt += no_opt_if(!sign_option.bootloader_data,
+				      "bootloader");
+		errorcnt += no_opt_if(!sign_option.config_data, "config");
+		errorcnt += no_opt_if(sign_option.arch == ARCH_UNSPECIFIED,
+				      "arch");
+		break;
+	case FILE_TYPE_USBPD1:
+		errorcnt += no_opt_if(!sign_option.pem_signpriv, "pem");
+		errorcnt += no_opt_if(sign_option.hash_alg == VB2_HASH_INVALID,
+				      "hash_alg");
+		break;
+	case FILE_TYPE_RWSIG:
+		if (sign_option.inout_file_count > 1)
+			/* Signing raw data. No signature pre-exists. */
+			errorcnt += no_opt_if(!sign_option.prikey, "prikey");
+		break;
+	default:
+		/* Anything else we don't care */
+		break;
+	}
+
+	VB2_DEBUG("infile=%s\n", infile);
+	VB2_DEBUG("sign_option.inout_file_count=%d\n",
+		  sign_option.inout_file_count);
+	VB2_DEBUG("sign_option.create_new_outfile=%d\n",
+		  sign_option.create_new_outfile);
+
+	/* Make sure we have an output file if one is needed */
+	if (!sign_option.outfile) {
+		if (sign_option.create_new_outfile) {
+			errorcnt++;
+			fprintf(stderr, "Missing output filename\n");
+			return errorcnt;
+		} else {
+			sign_option.outfile = infile;
+		}
+	}
+
+	VB2_DEBUG("sign_option.outfile=%s\n", sign_option.outfile);
+
+	if (errorcnt)
+		return errorcnt;
+
+	if (!sign_option.create_new_outfile) {
+		/* We'll read-modify-write the output file */
+		if (sign_option.inout_file_count > 1)
+			futil_copy_file_or_die(infile, sign_option.outfile);
+		infile = sign_option.outfile;
+	}
+
+	return futil_file_type_sign(sign_option.type, infile);
+}
+
+struct batch_entry {
+	char *infile;
+	char *outfile;		/* NULL to sign in place */
+	pid_t pid;
+	int status;
+};
+
+/*
+ * Read a batch manifest. Each non-blank line not starting with '#' holds an
+ * input file and an optional output file. Return the number of entries, or
+ * -1 on error.
+ */
+static int read_batch_manifest(const char *filename,
+			       struct batch_entry **entries_ptr)
+{
+	struct batch_entry *entries = NULL, *tmp;
+	int count = 0, lineno = 0;
+	char *line = NULL, *extra, *ctx;
+	size_t len = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "Unable to open %s: %s\n", filename,
+			strerror(errno));
+		return -1;
+	}
+
+	while (getline(&line, &len, fp) != -1) {
+		char *infile, *outfile;
+
+		lineno++;
+		infile = strtok_r(line, " \t\r\n", &ctx);
+		if (!infile || *infile == '#')
+			continue;
+		outfile = strtok_r(NULL, " \t\r\n", &ctx);
+		extra = strtok_r(NULL, " \t\r\n", &ctx);
+		if (extra) {
+			fprintf(stderr, "%s:%d: too many fields\n",
+				filename, lineno);
+			goto fail;
+		}
+
+		tmp = realloc(entries, (count + 1) * sizeof(*entries));
+		if (!tmp)
+			goto fail;
+		entries = tmp;
+		memset(&entries[count], 0, sizeof(*entries));
+		entries[count].infile = strdup(infile);
+		if (outfile)
+			entries[count].outfile = strdup(outfile);
+		count++;
+		if (!entries[count - 1].infile ||
+		    (outfile && !entries[count - 1].outfile))
+			goto fail;
+	}
+
+	free(line);
+	fclose(fp);
+	*entries_ptr = entries;
+	return count;
+
+fail:
+	while (count--) {
+		free(entries[count].infile);
+		free(entries[count].outfile);
+	}
+	free(entries);
+	free(line);
+	fclose(fp);
+	return -1;
+}
+
+/*
+ * Sign every file listed in the manifest, running up to |jobs| at once.
+ *
+ * The signing code keeps its per-file state in sign_option, so each file is
+ * signed in a forked child. The keys were already loaded by the parent, or
+ * for --pem_signpriv are loaded here, and are shared with every child, so
+ * they are only read once. Likewise a --pem_coprocess signer is started once
+ * here and used by every child.
+ * Return non-zero if any file failed.
+ */
+static int sign_batch(const char *manifest, uint32_t jobs)
+{
+	struct batch_entry *entries;
+	int count, next = 0, failed = 0;
+	uint32_t running = 0;
+	int i, status;
+	pid_t pid;
+
+	if (sign_option.pem_signpriv && sign_option.pem_algo_specified &&
+	    !sign_option.pem_external && !read_pem_signpriv()) {
+		fprintf(stderr, "Unable to read PEM signing key: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	count = read_batch_manifest(manifest, &entries);
+	if (count < 0)
+		return 1;
+
+	/* Start the signer here, so every child sends its requests to it */
+	if (sign_option.pem_coprocess && sign_option.pem_external &&
+	    sign_option.pem_signpriv &&
+	    vb2_external_signer_start(sign_option.pem_signpriv,
+				      sign_option.pem_external))
+		VB2_DEBUG("Signing with one signer process per signature\n");
+
+	while (next < count || running) {
+		if (next < count && running < jobs) {
+			struct batch_entry *ent = &entries[next++];
+
+			/* Don't let the children repeat buffered output */
+			fflush(NULL);
+			pid = fork();
+			if (pid < 0) {
+				fprintf(stderr, "Unable to fork: %s\n",
+					strerror(errno));
+				ent->status = -1;
+				continue;
+			}
+			if (!pid) {
+				sign_option.outfile = ent->outfile;
+				sign_option.inout_file_count =
+					ent->outfile ? 2 : 1;
+				status = sign_file(ent->infile);
+				vb2_external_signer_close();
+				exit(!!status);
+			}
+			ent->pid = pid;
+			running++;
+			continue;
+		}
+
+		pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			FATAL("waitpid: %s\n", strerror(errno));
+		}
+		for (i = 0; i < next; i++) {
+			if (entries[i].pid != pid)
+				continue;
+			entries[i].status = status;
+			entries[i].pid = 0;
+			running--;
+			break;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		int ok = entries[i].status == 0;
+
+		printf("%s: %s\n", entries[i].infile, ok ? "OK" : "FAILED");
+		if (!ok)
+			failed++;
+		free(entries[i].infile);
+		free(entries[i].outfile);
+	}
+	printf("Signed %d of %d files\n", count - failed, count);
+	free(entries);
+
+	return !!failed;
+}
+
 static int do_sign(int argc, char *argv[])
 {
 	char *infile = 0;
+	char *batchfile = 0;
+	uint32_t jobs = 0;
+	int batch_failed = 0;
 	int i;
 	int errorcnt = 0;
 	char *e = 0;
@@ -840,6 +1166,17 @@ static int do_sign(int argc, char *argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_BATCH:
+			batchfile = optarg;
+			break;
+		case OPT_JOBS:
+			errorcnt += parse_number_opt(optarg, "jobs", &jobs);
+			if (!jobs) {
+				fprintf(stderr, "Invalid --jobs \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
 		case OPT_HELP:
 			helpind = optind - 1;
 			break;
@@ -874,6 +1211,32 @@ static int do_sign(int argc, char *argv[])
 		return !!errorcnt;
 	}
 
+	if (jobs && !batchfile) {
+		fprintf(stderr, "ERROR: --jobs must be used with --batch\n");
+		errorcnt++;
+	}
+
+	if (errorcnt)
+		goto done;
+
+	vb2_external_signer_persist(sign_option.pem_coprocess);
+
+	if (batchfile) {
+		if (infile || sign_option.outfile || argc - optind > 0) {
+			errorcnt++;
+			fprintf(stderr, "ERROR: --batch takes no other input or"
+				" output files\n");
+			goto done;
+		}
+		if (!jobs) {
+			long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+			jobs = ncpus > 0 ? ncpus : 1;
+		}
+		/* Failures here are reported per file, not as usage errors */
+		batch_failed = sign_batch(batchfile, jobs);
+		goto done;
+	}
+
 	/* If we don't have an input file already, we need one */
 	if (!infile) {
 		if (argc - optind <= 0) {
@@ -892,132 +1255,17 @@ static int do_sign(int argc, char *argv[])
 		sign_option.outfile = argv[optind++];
 	}
 
-	/* What are we looking at? */
-	if (sign_option.type == FILE_TYPE_UNKNOWN &&
-	    futil_file_type(infile, &sign_option.type)) {
-		errorcnt++;
-		goto done;
-	}
-
-	/* We may be able to infer the type based on the other args */
-	if (sign_option.type == FILE_TYPE_UNKNOWN) {
-		if (sign_option.bootloader_data || sign_option.config_data
-		    || sign_option.arch != ARCH_UNSPECIFIED)
-			sign_option.type = FILE_TYPE_RAW_KERNEL;
-		else if (sign_option.kernel_subkey || sign_option.fv_specified)
-			sign_option.type = FILE_TYPE_RAW_FIRMWARE;
-	}
-
-	VB2_DEBUG("type=%s\n", futil_file_type_name(sign_option.type));
-
-	/* Check the arguments for the type of thing we want to sign */
-	switch (sign_option.type) {
-	case FILE_TYPE_PUBKEY:
-		sign_option.create_new_outfile = 1;
-		if (sign_option.signprivate && sign_option.pem_signpriv) {
-			fprintf(stderr,
-				"Only one of --signprivate and --pem_signpriv"
-				" can be specified\n");
-			errorcnt++;
-		}
-		if ((sign_option.signprivate &&
-		     sign_option.pem_algo_specified) ||
-		    (sign_option.pem_signpriv &&
-		     !sign_option.pem_algo_specified)) {
-			fprintf(stderr, "--pem_algo must be used with"
-				" --pem_signpriv\n");
-			errorcnt++;
-		}
-		if (sign_option.pem_external && !sign_option.pem_signpriv) {
-			fprintf(stderr, "--pem_external must be used with"
-				" --pem_signpriv\n");
-			errorcnt++;
-		}
-		/* We'll wait to read the PEM file, since the external signer
-		 * may want to read it instead. */
-		break;
-	case FILE_TYPE_BIOS_IMAGE:
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
-		break;
-	case FILE_TYPE_KERN_PREAMBLE:
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		if (sign_option.vblockonly || sign_option.inout_file_count > 1)
-			sign_option.create_new_outfile = 1;
-		break;
-	case FILE_TYPE_RAW_FIRMWARE:
-		sign_option.create_new_outfile = 1;
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.kernel_subkey, "kernelkey");
-		errorcnt += no_opt_if(!sign_option.version_specified,
-				      "version");
-		break;
-	case FILE_TYPE_RAW_KERNEL:
-		sign_option.create_new_outfile = 1;
-		errorcnt += no_opt_if(!sign_option.signprivate, "signprivate");
-		errorcnt += no_opt_if(!sign_option.keyblock, "keyblock");
-		errorcnt += no_opt_if(!sign_option.version_specified,
-				      "version");
-		errorcnt += no_opt_if(!sign_option.bootloader_data,
-				      "bootloader");
-		errorcnt += no_opt_if(!sign_option.config_data, "config");
-		errorcnt += no_opt_if(sign_option.arch == ARCH_UNSPECIFIED,
-				      "arch");
-		break;
-	case FILE_TYPE_USBPD1:
-		errorcnt += no_opt_if(!sign_option.pem_signpriv, "pem");
-		errorcnt += no_opt_if(sign_option.hash_alg == VB2_HASH_INVALID,
-				      "hash_alg");
-		break;
-	case FILE_TYPE_RWSIG:
-		if (sign_option.inout_file_count > 1)
-			/* Signing raw data. No signature pre-exists. */
-			errorcnt += no_opt_if(!sign_option.prikey, "prikey");
-		break;
-	default:
-		/* Anything else we don't care */
-		break;
-	}
-
-	VB2_DEBUG("infile=%s\n", infile);
-	VB2_DEBUG("sign_option.inout_file_count=%d\n",
-		  sign_option.inout_file_count);
-	VB2_DEBUG("sign_option.create_new_outfile=%d\n",
-		  sign_option.create_new_outfile);
-
-	/* Make sure we have an output file if one is needed */
-	if (!sign_option.outfile) {
-		if (sign_option.create_new_outfile) {
-			errorcnt++;
-			fprintf(stderr, "Missing output filename\n");
-			goto done;
-		} else {
-			sign_option.outfile = infile;
-		}
-	}
-
-	VB2_DEBUG("sign_option.outfile=%s\n", sign_option.outfile);
-
 	if (argc - optind > 0) {
 		errorcnt++;
 		fprintf(stderr, "ERROR: too many arguments left over\n");
-	}
-
-	if (errorcnt)
 		goto done;
-
-	if (!sign_option.create_new_outfile) {
-		/* We'll read-modify-write the output file */
-		if (sign_option.inout_file_count > 1)
-			futil_copy_file_or_die(infile, sign_option.outfile);
-		infile = sign_option.outfile;
 	}
 
-	errorcnt += futil_file_type_sign(sign_option.type, infile);
+	errorcnt += sign_file(infile);
 done:
+	vb2_external_signer_close();
 	free(sign_option.signprivate);
+	vb2_free_private_key(pem_signprivate);
 	free(sign_option.keyblock);
 	free(sign_option.kernel_subkey);
 	if (sign_option.prikey)
@@ -1026,7 +1274,7 @@ done:
 	if (errorcnt)
 		fprintf(stderr, "Use --help for usage instructions\n");
 
-	return !!errorcnt;
+	return errorcnt || batch_failed;
 }
 
 DECLARE_FUTIL_COMMAND(sign, do_sign, VBOOT_VERSION_ALL,
@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 
 #include "futility.h"
@@ -18,10 +19,12 @@
 enum {
 	OPT_DUMMY = 0x100,
 
+	OPT_ARCHIVE_MEM,
 	OPT_CCD,
 	OPT_EMULATE,
 	OPT_FACTORY,
 	OPT_FAST,
+	OPT_FLASH_KBPS,
 	OPT_FORCE,
 	OPT_GBB_FLAGS,
 	OPT_HOST_ONLY,
@@ -29,6 +32,7 @@ enum {
 	OPT_MODEL,
 	OPT_OUTPUT_DIR,
 	OPT_PD_IMAGE,
+	OPT_PLAN,
 	OPT_QUIRKS,
 	OPT_QUIRKS_LIST,
 	OPT_REPACK,
@@ -37,7 +41,9 @@ enum {
 	OPT_SERVO_PORT,
 	OPT_SIGNATURE,
 	OPT_SYS_PROPS,
+	OPT_TIMING,
 	OPT_UNPACK,
+	OPT_VERIFY_WRITTEN,
 	OPT_WRITE_PROTECTION,
 };
 
@@ -55,12 +61,14 @@ static struct option const long_opts[] = {
 	{"programmer", 1, NULL, 'p'},
 	{"mode", 1, NULL, 'm'},
 
+	{"archive_mem", 1, NULL, OPT_ARCHIVE_MEM},
 	{"ccd", 0, NULL, OPT_CCD},
 	{"servo", 0, NULL, OPT_SERVO},
 	{"servo_port", 1, NULL, OPT_SERVO_PORT},
 	{"emulate", 1, NULL, OPT_EMULATE},
 	{"factory", 0, NULL, OPT_FACTORY},
 	{"fast", 0, NULL, OPT_FAST},
+	{"flash_kbps", 1, NULL, OPT_FLASH_KBPS},
 	{"force", 0, NULL, OPT_FORCE},
 	{"gbb_flags", 1, NULL, OPT_GBB_FLAGS},
 	{"host_only", 0, NULL, OPT_HOST_ONLY},
@@ -69,11 +77,14 @@ static struct option const long_opts[] = {
 	{"model", 1, NULL, OPT_MODEL},
 	{"output_dir", 1, NULL, OPT_OUTPUT_DIR},
 	{"pd_image", 1, NULL, OPT_PD_IMAGE},
+	{"plan", 0, NULL, OPT_PLAN},
 	{"quirks", 1, NULL, OPT_QUIRKS},
 	{"repack", 1, NULL, OPT_REPACK},
 	{"signature_id", 1, NULL, OPT_SIGNATURE},
 	{"sys_props", 1, NULL, OPT_SYS_PROPS},
+	{"timing", 1, NULL, OPT_TIMING},
 	{"unpack", 1, NULL, OPT_UNPACK},
+	{"verify_written", 0, NULL, OPT_VERIFY_WRITTEN},
 	{"wp", 1, NULL, OPT_WRITE_PROTECTION},
 
 	/* TODO(hungte) Remove following deprecated options. */
@@ -111,11 +122,13 @@ static void print_help(int argc, char *argv[])
 		"    --pd_image=FILE \tPD firmware image (i.e, pd.bin)\n"
 		"-t, --try           \tTry A/B update on reboot if possible\n"
 		"-a, --archive=PATH  \tRead resources from archive\n"
+		"    --archive_mem=MB\tMemory for caching archive contents\n"
 		"    --manifest      \tPrint out a JSON manifest and exit\n"
 		"    --repack=DIR    \tUpdates archive from DIR\n"
 		"    --unpack=DIR    \tExtracts archive to DIR\n"
 		"-p, --programmer=PRG\tChange AP (host) flashrom programmer\n"
 		"    --fast          \tReduce read cycles and do not verify\n"
+		"    --verify_written\tVerify written blocks in updater\n"
 		"    --quirks=LIST   \tSpecify the quirks to apply\n"
 		"    --list-quirks   \tPrint all available quirks\n"
 		"-m, --mode=MODE     \tRun updater in specified mode\n"
@@ -129,6 +142,9 @@ static void print_help(int argc, char *argv[])
 		"    --wp=1|0        \tSpecify write protection status\n"
 		"    --host_only     \tUpdate only AP (host) firmware\n"
 		"    --emulate=FILE  \tEmulate system firmware using file\n"
+		"    --plan          \tEstimate (not write) --emulate update\n"
+		"    --timing=FILE   \tWrite JSON timing report to FILE (-)\n"
+		"    --flash_kbps=E,W\tFlash erase,write speed for estimates\n"
 		"    --model=MODEL   \tOverride system model for images\n"
 		"    --gbb_flags=FLAG\tOverride new GBB flags\n"
 		"    --ccd           \tDo fast,force,wp=0,p=raiden_debug_spi\n"
@@ -160,7 +176,9 @@ static int do_update(int argc, char *argv[])
 	int i, errorcnt = 0, do_update = 1;
 	int detect_servo = 0;
 	const char *prepare_ctrl_name = NULL;
+	const char *timing_file = NULL;
 	char *servo_programmer = NULL;
+	size_t archive_mem;
 	char *endptr;
 
 	cfg = updater_new_config();
@@ -199,6 +217,17 @@ static int do_update(int argc, char *argv[])
 			args.programmer = optarg;
 			break;
 
+		case OPT_ARCHIVE_MEM:
+			/* strtoul takes (and negates) a leading '-'. */
+			archive_mem = strtoul(optarg, &endptr, 0);
+			if (!*optarg || *endptr || strchr(optarg, '-') ||
+			    archive_mem > SIZE_MAX >> 20) {
+				ERROR("Invalid size: %s\n", optarg);
+				errorcnt++;
+			} else {
+				archive_set_cache_limit(archive_mem << 20);
+			}
+			break;
 		case OPT_PD_IMAGE:
 			args.pd_image = optarg;
 			break;
@@ -248,6 +277,18 @@ static int do_update(int argc, char *argv[])
 		case OPT_FAST:
 			args.fast_update = 1;
 			break;
+		case OPT_VERIFY_WRITTEN:
+			args.verify_written = 1;
+			break;
+		case OPT_TIMING:
+			args.timing = optarg;
+			break;
+		case OPT_PLAN:
+			args.do_plan = 1;
+			break;
+		case OPT_FLASH_KBPS:
+			args.flash_speed = optarg;
+			break;
 		case OPT_GBB_FLAGS:
 			args.gbb_flags = strtoul(optarg, &endptr, 0);
 			if (*endptr) {
@@ -317,8 +358,12 @@ static int do_update(int argc, char *argv[])
 	 */
 	prepare_servo_control(prepare_ctrl_name, 1);
 
-	if (!errorcnt)
+	if (!errorcnt) {
 		errorcnt += updater_setup_config(cfg, &args, &do_update);
+		/* The timing report is also wanted when the update fails. */
+		if (do_update && (args.timing || args.do_plan))
+			timing_file = args.timing ? args.timing : "-";
+	}
 	if (!errorcnt && do_update) {
 		int r;
 		STATUS("Starting firmware updater.\n");
@@ -328,11 +373,18 @@ static int do_update(int argc, char *argv[])
 			ERROR("%s\n", updater_error_messages[r]);
 			errorcnt++;
 		}
-		/* Use stdout for the final result. */
-		printf(">> %s: Firmware updater %s.\n",
+		/*
+		 * Use stdout for the final result, unless the JSON report is
+		 * printed there.
+		 */
+		fprintf(timing_file && !strcmp(timing_file, "-") ?
+			stderr : stdout,
+			">> %s: Firmware updater %s.\n",
 			errorcnt ? "FAILED": "DONE",
 			errorcnt ? "aborted" : "exits successfully");
 	}
+	if (timing_file)
+		errorcnt += !!updater_write_json_timing(cfg, timing_file);
 
 	prepare_servo_control(prepare_ctrl_name, 0);
 	free(servo_programmer);
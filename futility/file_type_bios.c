@@ -15,6 +15,7 @@
 #include "futility.h"
 #include "futility_options.h"
 #include "host_common.h"
+#include "sha_multibuf.h"
 #include "vb1_helper.h"
 
 static const char * const fmap_name[] = {
@@ -324,13 +325,14 @@ whatever:
 
 static int write_new_preamble(struct bios_area_s *vblock,
 			      struct bios_area_s *fw_body,
+			      const uint8_t *fw_body_digest,
 			      struct vb2_private_key *signkey,
 			      struct vb2_keyblock *keyblock)
 {
 	struct vb2_signature *body_sig;
 	struct vb2_fw_preamble *preamble;
 
-	body_sig = vb2_calculate_signature(fw_body->buf, fw_body->len, signkey);
+	body_sig = vb2_sign_digest(fw_body_digest, fw_body->len, signkey);
 	if (!body_sig) {
 		fprintf(stderr, "Error calculating body signature\n");
 		return 1;
@@ -400,6 +402,12 @@ static int sign_bios_at_end(struct bios_state_s *state)
 	struct bios_area_s *vblock_b = &state->area[BIOS_FMAP_VBLOCK_B];
 	struct bios_area_s *fw_a = &state->area[BIOS_FMAP_FW_MAIN_A];
 	struct bios_area_s *fw_b = &state->area[BIOS_FMAP_FW_MAIN_B];
+	uint8_t digest_a[VB2_MAX_DIGEST_SIZE];
+	uint8_t digest_b[VB2_MAX_DIGEST_SIZE];
+	struct vb2_digest_job jobs[] = {
+		{ fw_a->buf, fw_a->len, digest_a, sizeof(digest_a) },
+		{ fw_b->buf, fw_b->len, digest_b, sizeof(digest_b) },
+	};
 	int retval = 0;
 
 	if (!vblock_a->is_valid || !vblock_b->is_valid ||
@@ -408,10 +416,19 @@ static int sign_bios_at_end(struct bios_state_s *state)
 		return 1;
 	}
 
-	retval |= write_new_preamble(vblock_a, fw_a, sign_option.signprivate,
+	/* Hash both firmware bodies in one pass */
+	if (VB2_SUCCESS != vb2_digest_buffers(jobs, ARRAY_SIZE(jobs),
+					sign_option.signprivate->hash_alg)) {
+		fprintf(stderr, "Error calculating body digests\n");
+		return 1;
+	}
+
+	retval |= write_new_preamble(vblock_a, fw_a, digest_a,
+				     sign_option.signprivate,
 				     sign_option.keyblock);
 
-	retval |= write_new_preamble(vblock_b, fw_b, sign_option.signprivate,
+	retval |= write_new_preamble(vblock_b, fw_b, digest_b,
+				     sign_option.signprivate,
 				     sign_option.keyblock);
 
 	if (sign_option.loemid) {
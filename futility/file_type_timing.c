@@ -0,0 +1,111 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Boot timing events exported by vb2api_export_timing().
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "2common.h"
+#include "2struct.h"
+#include "2sysincludes.h"
+#include "file_type.h"
+#include "futility.h"
+
+static const char *const step_names[] = {
+	[VB2_TIMING_FW_PHASE1] = "fw_phase1",
+	[VB2_TIMING_FW_PHASE2] = "fw_phase2",
+	[VB2_TIMING_FW_PHASE3] = "fw_phase3",
+	[VB2_TIMING_FW_KEYBLOCK] = "fw_keyblock",
+	[VB2_TIMING_FW_PREAMBLE] = "fw_preamble",
+	[VB2_TIMING_FW_BODY_HASH] = "fw_body_hash",
+	[VB2_TIMING_KERNEL_PHASE1] = "kernel_phase1",
+	[VB2_TIMING_GPT_READ] = "gpt_read",
+	[VB2_TIMING_KERNEL_KEYBLOCK] = "kernel_keyblock",
+	[VB2_TIMING_KERNEL_PREAMBLE] = "kernel_preamble",
+	[VB2_TIMING_KERNEL_BODY] = "kernel_body",
+	[VB2_TIMING_COMMIT_DATA] = "commit_data",
+	[VB2_TIMING_TPM_CLEAR_OWNER] = "tpm_clear_owner",
+};
+
+static const char *step_name(uint16_t step)
+{
+	if (step < ARRAY_SIZE(step_names) && step_names[step])
+		return step_names[step];
+	return "unknown";
+}
+
+enum futil_file_type ft_recognize_timing(uint8_t *buf, uint32_t len)
+{
+	struct vb2_timing_export *timing = (struct vb2_timing_export *)buf;
+
+	if (len < sizeof(*timing))
+		return FILE_TYPE_UNKNOWN;
+	if (timing->magic != VB2_TIMING_EXPORT_MAGIC)
+		return FILE_TYPE_UNKNOWN;
+	if (timing->struct_version_major != VB2_TIMING_EXPORT_VERSION_MAJOR)
+		return FILE_TYPE_UNKNOWN;
+
+	return FILE_TYPE_BOOT_TIMING;
+}
+
+int ft_show_timing(const char *name, void *data)
+{
+	struct vb2_timing_export *timing;
+	const struct vb2_timing_event *ev;
+	int fd = -1;
+	uint8_t *buf;
+	uint32_t len;
+	uint32_t count, i, j;
+	int rv = 1;
+
+	if (futil_open_and_map_file(name, &fd, FILE_RO, &buf, &len))
+		return 1;
+
+	timing = (struct vb2_timing_export *)buf;
+	if (ft_recognize_timing(buf, len) != FILE_TYPE_BOOT_TIMING) {
+		ERROR("%s is not a boot timing export\n", name);
+		goto done;
+	}
+
+	count = timing->event_count;
+	if (count > VB2_TIMING_MAX_EVENTS)
+		count = VB2_TIMING_MAX_EVENTS;
+
+	printf("Boot timing:             %s\n", name);
+	printf("  Version:               %d.%d\n",
+	       timing->struct_version_major, timing->struct_version_minor);
+	printf("  Events:                %u (%u dropped)\n",
+	       count, timing->dropped_count);
+	printf("  %10s  %-16s %-5s  %s\n", "Time (ms)", "Step", "Event",
+	       "Duration (ms)");
+
+	for (i = 0; i < count; i++) {
+		uint16_t step = timing->events[i].tag & ~VB2_TIMING_END;
+
+		ev = &timing->events[i];
+		printf("  %10u  %-16s %-5s", ev->time_ms, step_name(step),
+		       ev->tag & VB2_TIMING_END ? "end" : "start");
+
+		/* Pair an end with the most recent start of the same step */
+		if (ev->tag & VB2_TIMING_END) {
+			for (j = i; j-- > 0;) {
+				if (timing->events[j].tag == step) {
+					printf("  %u", ev->time_ms -
+					       timing->events[j].time_ms);
+					break;
+				}
+			}
+		}
+		if (ev->flags & VB2_TIMING_FLAG_FAILED)
+			printf(" FAILED");
+		printf("\n");
+	}
+	rv = 0;
+
+done:
+	futil_unmap_and_close_file(fd, FILE_RO, buf, len);
+	return rv;
+}
@@ -18,7 +18,7 @@ struct vb2_private_key;
 struct vb21_packed_key;
 
 struct show_option_s {
-	struct vb2_public_key *k;
+	const struct vb2_public_key *k;
 	uint8_t *fv;
 	uint64_t fv_size;
 	uint32_t padding;
@@ -56,6 +56,7 @@ struct sign_option_s {
 	int pem_algo_specified;
 	uint32_t pem_algo;
 	char *pem_external;
+	int pem_coprocess;
 	enum futil_file_type type;
 	enum vb2_hash_algorithm hash_alg;
 	uint32_t ro_size, rw_size;
@@ -53,6 +53,9 @@ int get_system_property(enum system_property_type property_type,
 	assert(property_type < SYS_PROP_MAX);
 	prop = &cfg->system_properties[property_type];
 	if (!prop->initialized) {
+		/* Software write protection is read using flashrom. */
+		if (property_type == SYS_PROP_WP_SW)
+			wait_system_firmware_prefetch(cfg);
 		prop->initialized = 1;
 		prop->value = prop->getter();
 	}
@@ -814,18 +817,11 @@ static int legacy_needs_update(struct updater_config *cfg)
 	int has_from, has_to;
 	const char * const tag = "cros_allow_auto_update";
 	const char *section = FMAP_RW_LEGACY;
-	const char *tmp_to, *tmp_from;
 
 	VB2_DEBUG("Checking %s contents...\n", FMAP_RW_LEGACY);
 
-	tmp_to = get_firmware_image_temp_file(&cfg->image, &cfg->tempfiles);
-	tmp_from = get_firmware_image_temp_file(&cfg->image_current,
-						&cfg->tempfiles);
-	if (!tmp_from || !tmp_to)
-		return 0;
-
-	has_to = cbfs_file_exists(tmp_to, section, tag);
-	has_from = cbfs_file_exists(tmp_from, section, tag);
+	has_to = cbfs_file_exists(&cfg->image, section, tag);
+	has_from = cbfs_file_exists(&cfg->image_current, section, tag);
 
 	if (!has_from || !has_to) {
 		VB2_DEBUG("Current legacy firmware has%s updater tag (%s) and "
@@ -1117,10 +1113,14 @@ static enum updater_error_codes update_whole_firmware(
 		struct updater_config *cfg,
 		struct firmware_image *image_to)
 {
+	uint64_t start;
+
 	STATUS("FULL UPDATE: Updating whole firmware image(s), RO+RW.\n");
 
+	start = updater_timing_now();
 	if (preserve_images(cfg))
 		VB2_DEBUG("Failed to preserve some sections - ignore.\n");
+	updater_timing_record(cfg, STAGE_PRESERVE, start, 0);
 
 	INFO("Checking compatibility...\n");
 	if (!cfg->force_update) {
@@ -1284,6 +1284,9 @@ struct updater_config *updater_new_config(void)
 
 	cfg->check_platform = 1;
 	cfg->do_verify = 1;
+	cfg->flash_speed.erase_kbps = FLASH_ERASE_KBPS;
+	cfg->flash_speed.write_kbps = FLASH_WRITE_KBPS;
+	cfg->timing.start_us = updater_timing_now();
 
 	init_system_properties(&cfg->system_properties[0],
 			       ARRAY_SIZE(cfg->system_properties));
@@ -1318,6 +1321,22 @@ static int updater_setup_quirks(struct updater_config *cfg,
 	return errorcnt;
 }
 
+/*
+ * Loads a firmware image and records the time in given stage.
+ * Returns the same as load_firmware_image.
+ */
+static int updater_load_image(struct updater_config *cfg,
+			      enum updater_stage stage,
+			      struct firmware_image *image,
+			      const char *file_name, struct u_archive *archive)
+{
+	uint64_t start = updater_timing_now();
+	int r = load_firmware_image(image, file_name, archive);
+
+	updater_timing_record(cfg, stage, start, image->size);
+	return r;
+}
+
 /*
  * Loads images into updater configuration.
  * Returns 0 on success, otherwise number of failures.
@@ -1338,7 +1357,8 @@ static int updater_load_images(struct updater_config *cfg,
 			if (image)
 				errorcnt += !!save_file_from_stdin(image);
 		}
-		errorcnt += !!load_firmware_image(&cfg->image, image, ar);
+		errorcnt += !!updater_load_image(cfg, STAGE_LOAD_IMAGE,
+						 &cfg->image, image, ar);
 		if (!errorcnt)
 			errorcnt += updater_setup_quirks(cfg, arg);
 	}
@@ -1346,9 +1366,11 @@ static int updater_load_images(struct updater_config *cfg,
 		return errorcnt;
 
 	if (!cfg->ec_image.data && ec_image)
-		errorcnt += !!load_firmware_image(&cfg->ec_image, ec_image, ar);
+		errorcnt += !!updater_load_image(cfg, STAGE_LOAD_IMAGE,
+						 &cfg->ec_image, ec_image, ar);
 	if (!cfg->pd_image.data && pd_image)
-		errorcnt += !!load_firmware_image(&cfg->pd_image, pd_image, ar);
+		errorcnt += !!updater_load_image(cfg, STAGE_LOAD_IMAGE,
+						 &cfg->pd_image, pd_image, ar);
 	return errorcnt;
 }
 
@@ -1480,11 +1502,13 @@ int updater_setup_config(struct updater_config *cfg,
 	int check_single_image = 0, check_wp_disabled = 0;
 	int do_output = 0;
 	const char *archive_path = arg->archive;
+	uint64_t start;
 
 	/* Setup values that may change output or decision of other argument. */
 	cfg->verbosity = arg->verbosity;
 	cfg->use_diff_image = arg->fast_update;
 	cfg->do_verify = !arg->fast_update;
+	cfg->verify_written = cfg->do_verify && arg->verify_written;
 	cfg->factory_update = arg->is_factory;
 	if (arg->force_update)
 		cfg->force_update = 1;
@@ -1559,13 +1583,38 @@ int updater_setup_config(struct updater_config *cfg,
 		override_system_property(SYS_PROP_WP_SW, cfg, r);
 	}
 
+	/*
+	 * Reading the system firmware is slow and doesn't depend on the
+	 * archive or target images, so start it now.
+	 */
+	if (*do_update && !arg->emulation && !do_output &&
+	    cfg->try_update != TRY_UPDATE_DEFERRED_APPLY)
+		prefetch_system_firmware(cfg);
+
 	/* Set up archive and load images. */
 	if (arg->emulation) {
 		/* Process emulation file first. */
 		cfg->emulation = arg->emulation;
 		VB2_DEBUG("Using file %s for emulation.\n", arg->emulation);
-		errorcnt += !!load_firmware_image(
-				&cfg->image_current, arg->emulation, NULL);
+		errorcnt += !!updater_load_image(
+				cfg, STAGE_FLASH_READ, &cfg->image_current,
+				arg->emulation, NULL);
+		/* Writing rewrites the file, which must not be mapped. */
+		errorcnt += !!unmap_firmware_image(&cfg->image_current);
+	}
+	if (arg->do_plan) {
+		if (!arg->emulation) {
+			ERROR("--plan needs --emulate.\n");
+			return ++errorcnt;
+		}
+		cfg->dry_run = 1;
+	}
+	if (arg->flash_speed &&
+	    (sscanf(arg->flash_speed, "%u,%u", &cfg->flash_speed.erase_kbps,
+		    &cfg->flash_speed.write_kbps) != 2 ||
+	     !cfg->flash_speed.erase_kbps || !cfg->flash_speed.write_kbps)) {
+		ERROR("Invalid flash speed: %s\n", arg->flash_speed);
+		return ++errorcnt;
 	}
 
 	/* Always load images specified from command line directly. */
@@ -1574,7 +1623,9 @@ int updater_setup_config(struct updater_config *cfg,
 
 	if (!archive_path)
 		archive_path = ".";
+	start = updater_timing_now();
 	cfg->archive = archive_open(archive_path);
+	updater_timing_record(cfg, STAGE_ARCHIVE, start, 0);
 	if (!cfg->archive) {
 		ERROR("Failed to open archive: %s\n", archive_path);
 		return ++errorcnt;
@@ -1605,7 +1656,11 @@ int updater_setup_config(struct updater_config *cfg,
 
 	/* Load images from archive. */
 	if (arg->archive) {
-		struct manifest *m = new_manifest_from_archive(cfg->archive);
+		struct manifest *m;
+
+		start = updater_timing_now();
+		m = new_manifest_from_archive(cfg->archive);
+		updater_timing_record(cfg, STAGE_MANIFEST, start, 0);
 		if (m) {
 			errorcnt += updater_setup_archive(
 					cfg, arg, m, cfg->factory_update);
@@ -1668,6 +1723,8 @@ int updater_setup_config(struct updater_config *cfg,
 void updater_delete_config(struct updater_config *cfg)
 {
 	assert(cfg);
+	wait_system_firmware_prefetch(cfg);
+	free(cfg->prefetch);
 	free_firmware_image(&cfg->image);
 	free_firmware_image(&cfg->image_current);
 	free_firmware_image(&cfg->ec_image);
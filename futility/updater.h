@@ -60,6 +60,37 @@ enum {
 	EC_RECOVERY_DONE
 };
 
+/* Stages of an update, for the timing report. */
+enum updater_stage {
+	STAGE_ARCHIVE,
+	STAGE_MANIFEST,
+	STAGE_LOAD_IMAGE,
+	STAGE_FLASH_READ,
+	STAGE_PRESERVE,
+	STAGE_COMPARE,
+	STAGE_FLASH_WRITE,
+	STAGE_VERIFY,
+	STAGE_MAX,
+};
+
+struct updater_stage_stats {
+	int count;
+	uint64_t us;
+	uint64_t bytes;
+};
+
+struct updater_timing {
+	uint64_t start_us;
+	struct updater_stage_stats stages[STAGE_MAX];
+
+	/* Totals of the flash write plans. */
+	int num_plans;
+	uint64_t bytes_changed;
+	uint64_t blocks_erased;
+	uint64_t bytes_written;
+	uint64_t estimated_ms;
+};
+
 struct updater_config {
 	struct firmware_image image, image_current;
 	struct firmware_image ec_image, pd_image;
@@ -74,10 +105,15 @@ struct updater_config {
 	int check_platform;
 	int use_diff_image;
 	int do_verify;
+	int verify_written;
 	int verbosity;
 	const char *emulation;
 	int override_gbb_flags;
 	uint32_t gbb_flags;
+	int dry_run;
+	struct flash_speed flash_speed;
+	struct updater_timing timing;
+	struct system_firmware_prefetch *prefetch;
 };
 
 struct updater_config_arguments {
@@ -89,10 +125,12 @@ struct updater_config_arguments {
 	char *output_dir;
 	char *repack, *unpack;
 	int is_factory, try_update, force_update, do_manifest, host_only;
-	int fast_update;
+	int fast_update, verify_written;
 	int verbosity;
 	int override_gbb_flags;
 	uint32_t gbb_flags;
+	char *timing, *flash_speed;
+	int do_plan;
 };
 
 struct patch_config {
@@ -200,8 +238,38 @@ int quirk_override_signature_id(struct updater_config *cfg,
 				struct model_config *model,
 				const char **signature_id);
 
+/* Functions from updater_plan.c */
+
+/* Returns a monotonic time stamp in microseconds, for timing stages. */
+uint64_t updater_timing_now(void);
+
+/*
+ * Records that a stage which began at start_us (from updater_timing_now) has
+ * finished after processing the given number of bytes.
+ */
+void updater_timing_record(struct updater_config *cfg,
+			   enum updater_stage stage, uint64_t start_us,
+			   uint64_t bytes);
+
+/* Adds a flash write plan to the estimates in the timing report. */
+void updater_timing_add_plan(struct updater_config *cfg,
+			     const struct flash_write_plan *plan);
+
+/*
+ * Writes the timing report in JSON format to given file, or stdout if the
+ * file name is "-". Returns 0 on success, otherwise failure.
+ */
+int updater_write_json_timing(const struct updater_config *cfg,
+			      const char *file_name);
+
 /* Functions from updater_archive.c */
 
+/*
+ * Sets the maximum size of file contents that drivers without random access
+ * (libarchive) keep in memory, for archives opened afterwards.
+ */
+void archive_set_cache_limit(size_t limit);
+
 /*
  * Opens an archive from given path.
  * The type of archive will be determined automatically.
@@ -230,6 +298,22 @@ int archive_has_entry(struct u_archive *ar, const char *name);
 int archive_read_file(struct u_archive *ar, const char *fname,
 		      uint8_t **data, uint32_t *size, int64_t *mtime);
 
+/*
+ * Maps a file from archive into memory, if the driver allows that.
+ * The mapping is private and copy-on-write, so the data can be modified without
+ * changing the archive and only the pages modified take extra memory.
+ * The data has no extra '\0' in the end and must be released by
+ * archive_unmap_file.
+ * Returns 0 on success, otherwise non-zero (use archive_read_file instead).
+ */
+int archive_map_file(struct u_archive *ar, const char *fname,
+		     uint8_t **data, uint32_t *size);
+
+/*
+ * Releases the data returned by archive_map_file.
+ */
+void archive_unmap_file(uint8_t *data, uint32_t size);
+
 /*
  * Writes a file into archive.
  * If entry name (fname) is an absolute path (/file), always write into real
@@ -249,6 +333,14 @@ int archive_write_file(struct u_archive *ar, const char *fname,
 int archive_walk(struct u_archive *ar, void *arg,
 		 int (*callback)(const char *path, void *arg));
 
+/*
+ * Traverses files within archive with names starting with prefix, in sorted
+ * order. Otherwise the same as archive_walk.
+ * Returns 0 on success otherwise non-zero as failure.
+ */
+int archive_walk_prefix(struct u_archive *ar, const char *prefix, void *arg,
+			int (*callback)(const char *path, void *arg));
+
 /*
  * Copies all entries from one archive to another.
  * Returns 0 on success, otherwise non-zero as failure.
@@ -10,7 +10,9 @@
 #if defined(__OpenBSD__)
 #include <sys/types.h>
 #endif
+#include <fcntl.h>
 #include <fts.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -48,13 +50,248 @@ struct u_archive {
 
 	int (*walk)(void *handle, void *arg,
 		    int (*callback)(const char *path, void *arg));
+	int (*walk_prefix)(void *handle, const char *prefix, void *arg,
+			   int (*callback)(const char *path, void *arg));
 	int (*has_entry)(void *handle, const char *name);
 	int (*read_file)(void *handle, const char *fname,
 			 uint8_t **data, uint32_t *size, int64_t *mtime);
+	int (*map_file)(void *handle, const char *fname,
+			uint8_t **data, uint32_t *size);
 	int (*write_file)(void *handle, const char *fname,
 			  uint8_t *data, uint32_t size, int64_t mtime);
 };
 
+/*
+ * -- The cache driver (used by other drivers). --
+ */
+
+/*
+ * The cache keeps the names (and for stream-based archives like tar+gz, also
+ * the contents) of entries in an archive.  Building a manifest looks up names
+ * for every image of every model, so entries are indexed by a hash of their
+ * names.  A sorted list of names is built on demand for walking the entries
+ * under a given prefix.
+ */
+struct archive_cache_entry {
+	char *name;
+	uint8_t *data;
+	int64_t mtime;
+	size_t size;
+	int has_data;
+	/* Driver specific identifier, for example the index in a ZIP. */
+	int64_t id;
+	/* Index of the next entry in the same hash bucket, or -1. */
+	int next;
+};
+
+struct archive_cache {
+	/* Entries in the order they were added. */
+	struct archive_cache_entry *entries;
+	int num_entries;
+	int max_entries;
+
+	/* Index of the first entry in each bucket (or -1); a power of 2. */
+	int *buckets;
+	int num_buckets;
+
+	/* Names of all entries in strcmp order, or NULL if not built yet. */
+	char **sorted;
+};
+
+/* Returns the FNV-1a hash of a name. */
+static uint32_t archive_cache_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	for (; *name; name++)
+		hash = (hash ^ (uint8_t)*name) * 16777619u;
+	return hash;
+}
+
+/* Creates an empty cache. Returns NULL on failure. */
+static struct archive_cache *archive_cache_new(void)
+{
+	struct archive_cache *c;
+	int i;
+
+	c = (struct archive_cache *)calloc(sizeof(*c), 1);
+	if (!c)
+		return NULL;
+
+	c->num_buckets = 64;
+	c->buckets = (int *)malloc(c->num_buckets * sizeof(*c->buckets));
+	if (!c->buckets) {
+		free(c);
+		return NULL;
+	}
+	for (i = 0; i < c->num_buckets; i++)
+		c->buckets[i] = -1;
+	return c;
+}
+
+/* Links an entry into its hash bucket. */
+static void archive_cache_link(struct archive_cache *c, int index)
+{
+	struct archive_cache_entry *e = &c->entries[index];
+	int *bucket = &c->buckets[archive_cache_hash(e->name) &
+				  (c->num_buckets - 1)];
+
+	e->next = *bucket;
+	*bucket = index;
+}
+
+/* Doubles the number of hash buckets. Returns 0 on success. */
+static int archive_cache_grow_buckets(struct archive_cache *c)
+{
+	int *buckets;
+	int i, num = c->num_buckets * 2;
+
+	buckets = (int *)realloc(c->buckets, num * sizeof(*buckets));
+	if (!buckets)
+		return -1;
+	c->buckets = buckets;
+	c->num_buckets = num;
+	for (i = 0; i < num; i++)
+		c->buckets[i] = -1;
+	for (i = 0; i < c->num_entries; i++)
+		archive_cache_link(c, i);
+	return 0;
+}
+
+/*
+ * Adds a new entry to the cache. Returns the new entry, or NULL on failure.
+ * The returned pointer is only valid until the next entry is added.
+ */
+static struct archive_cache_entry *archive_cache_add(struct archive_cache *c,
+						     const char *name)
+{
+	struct archive_cache_entry *e;
+
+	if (c->num_entries == c->max_entries) {
+		int num = c->max_entries ? c->max_entries * 2 : 64;
+
+		e = (struct archive_cache_entry *)realloc(
+				c->entries, num * sizeof(*e));
+		if (!e)
+			return NULL;
+		c->entries = e;
+		c->max_entries = num;
+	}
+	if (c->num_entries >= c->num_buckets &&
+	    archive_cache_grow_buckets(c))
+		return NULL;
+
+	e = &c->entries[c->num_entries];
+	memset(e, 0, sizeof(*e));
+	e->name = strdup(name);
+	if (!e->name)
+		return NULL;
+
+	archive_cache_link(c, c->num_entries++);
+	free(c->sorted);
+	c->sorted = NULL;
+	return e;
+}
+
+#if defined(HAVE_LIBARCHIVE) || defined(HAVE_LIBZIP)
+/* Find and return an entry (by name) from the cache. */
+static struct archive_cache_entry *archive_cache_find(struct archive_cache *c,
+						      const char *name)
+{
+	int i = c->buckets[archive_cache_hash(name) & (c->num_buckets - 1)];
+
+	for (; i >= 0; i = c->entries[i].next) {
+		assert(c->entries[i].name);
+		if (!strcmp(c->entries[i].name, name))
+			return &c->entries[i];
+	}
+	return NULL;
+}
+
+/* Callback for archive_walk to process all entries in the cache. */
+static int archive_cache_walk(
+		struct archive_cache *c, void *arg,
+		int (*callback)(const char *name, void *arg))
+{
+	int i;
+
+	for (i = 0; i < c->num_entries; i++) {
+		assert(c->entries[i].name);
+		if (callback(c->entries[i].name, arg))
+			break;
+	}
+	return 0;
+}
+#endif
+
+/* qsort callback to sort entry names. */
+static int archive_cache_compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/*
+ * Processes entries with names starting with prefix, in sorted order.
+ * Returns 0 on success, otherwise non-zero as failure.
+ */
+static int archive_cache_walk_prefix(
+		struct archive_cache *c, const char *prefix, void *arg,
+		int (*callback)(const char *name, void *arg))
+{
+	size_t len = strlen(prefix);
+	int i, lo = 0, hi = c->num_entries;
+
+	if (!c->num_entries)
+		return 0;
+
+	if (!c->sorted) {
+		c->sorted = (char **)malloc(c->num_entries * sizeof(char *));
+		if (!c->sorted)
+			return 1;
+		for (i = 0; i < c->num_entries; i++)
+			c->sorted[i] = c->entries[i].name;
+		qsort(c->sorted, c->num_entries, sizeof(char *),
+		      archive_cache_compare_names);
+	}
+
+	/* Find the first name not less than the prefix. */
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (strcmp(c->sorted[mid], prefix) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < c->num_entries; i++) {
+		if (strncmp(c->sorted[i], prefix, len))
+			break;
+		if (callback(c->sorted[i], arg))
+			break;
+	}
+	return 0;
+}
+
+/* Delete all entries in the cache. */
+static void *archive_cache_free(struct archive_cache *c)
+{
+	int i;
+
+	if (!c)
+		return NULL;
+
+	for (i = 0; i < c->num_entries; i++) {
+		free(c->entries[i].name);
+		free(c->entries[i].data);
+	}
+	free(c->entries);
+	free(c->buckets);
+	free(c->sorted);
+	free(c);
+	return NULL;
+}
+
 /*
  * -- The fallback driver (using general file system). --
  */
@@ -73,26 +310,36 @@ static int archive_fallback_close(void *handle)
 	return 0;
 }
 
-/* Callback for archive_walk on a general file system. */
-static int archive_fallback_walk(
-		void *handle, void *arg,
+/*
+ * Processes files under the dir directory (or all files if dir is NULL) of a
+ * general file system, with paths relative to the root of the archive.
+ * Returns 0 on success, otherwise non-zero as failure.
+ */
+static int archive_fallback_walk_dir(
+		void *handle, const char *dir, void *arg,
 		int (*callback)(const char *path, void *arg))
 {
 	FTS *fts_handle;
 	FTSENT *ent;
 	char *fts_argv[2] = {};
 	char default_path[] = ".";
-	char *root = default_path;
+	char *root = default_path, *temp_path = NULL;
 	size_t root_len;
 
 	if (handle)
 		root = (char *)handle;
 	root_len = strlen(root);
 	fts_argv[0] = root;
+	if (dir) {
+		ASPRINTF(&temp_path, "%s/%s", root, dir);
+		fts_argv[0] = temp_path;
+	}
 
 	fts_handle = fts_open(fts_argv, FTS_NOCHDIR, NULL);
-	if (!fts_handle)
+	if (!fts_handle) {
+		free(temp_path);
 		return -1;
+	}
 
 	while ((ent = fts_read(fts_handle)) != NULL) {
 		char *path = ent->fts_path + root_len;
@@ -105,9 +352,52 @@ static int archive_fallback_walk(
 		if (callback(path, arg))
 			break;
 	}
+	fts_close(fts_handle);
+	free(temp_path);
 	return 0;
 }
 
+/* Callback for archive_walk on a general file system. */
+static int archive_fallback_walk(
+		void *handle, void *arg,
+		int (*callback)(const char *path, void *arg))
+{
+	return archive_fallback_walk_dir(handle, NULL, arg, callback);
+}
+
+/* Callback for archive_fallback_walk_prefix to collect names. */
+static int archive_fallback_add_name(const char *path, void *arg)
+{
+	return !archive_cache_add((struct archive_cache *)arg, path);
+}
+
+/* Callback for archive_walk_prefix on a general file system. */
+static int archive_fallback_walk_prefix(
+		void *handle, const char *prefix, void *arg,
+		int (*callback)(const char *path, void *arg))
+{
+	struct archive_cache *cache = archive_cache_new();
+	const char *slash = strrchr(prefix, '/');
+	char *dir = NULL;
+	int r;
+
+	/*
+	 * Files may change at any time, so list them again for every walk,
+	 * but only those in the directory the prefix is in.
+	 */
+	if (!cache)
+		return -1;
+	if (slash)
+		dir = strndup(prefix, slash - prefix);
+	r = archive_fallback_walk_dir(handle, dir, cache,
+				      archive_fallback_add_name);
+	if (!r)
+		r = archive_cache_walk_prefix(cache, prefix, arg, callback);
+	free(dir);
+	archive_cache_free(cache);
+	return r;
+}
+
 /* Callback for fallback drivers to get full path easily. */
 static const char *archive_fallback_get_path(void *handle, const char *fname,
 					     char **temp_path)
@@ -156,6 +446,36 @@ static int archive_fallback_read_file(void *handle, const char *fname,
 	return r;
 }
 
+/* Callback for archive_map_file on a general file system. */
+static int archive_fallback_map_file(void *handle, const char *fname,
+				     uint8_t **data, uint32_t *size)
+{
+	char *temp_path = NULL;
+	const char *path = archive_fallback_get_path(handle, fname, &temp_path);
+	struct stat st;
+	void *ptr = MAP_FAILED;
+	int fd;
+
+	VB2_DEBUG("Mapping %s\n", path);
+	fd = open(path, O_RDONLY);
+	free(temp_path);
+	if (fd < 0)
+		return 1;
+
+	/* Empty files can't be mapped, and devices should be read. */
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    st.st_size <= UINT32_MAX)
+		ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+		return 1;
+
+	*data = (uint8_t *)ptr;
+	*size = st.st_size;
+	return 0;
+}
+
 /* Callback for archive_write_file on a general file system. */
 static int archive_fallback_write_file(void *handle, const char *fname,
 				       uint8_t *data, uint32_t size, int64_t mtime)
@@ -191,183 +511,201 @@ static int archive_fallback_write_file(void *handle, const char *fname,
 }
 
 /*
- * -- The cache driver (used by other drivers). --
+ * -- The libarchive driver (multiple formats but very slow). --
  */
 
-#ifdef HAVE_LIBARCHIVE
-
 /*
- * For stream-based archives (e.g., tar+gz) we want to create a cache for
- * storing the names and contents for later processing.
+ * Stream-based archives (for example tar+gz) can't seek to an entry, so
+ * reading a file may need to decompress everything before it. Small files
+ * (setvars.sh, keysets, signer_config.csv) are read and cached while scanning
+ * the names, and larger files (the firmware images) are only decompressed
+ * when requested. Contents are cached until the total reaches the limit.
  */
-struct archive_cache {
-	char *name;
-	uint8_t *data;
-	int64_t mtime;
-	size_t size;
-	int has_data;
-	struct archive_cache *next;
+#define LIBARCHIVE_SMALL_FILE_SIZE (64 * 1024)
+#define LIBARCHIVE_DEFAULT_CACHE_LIMIT (64 * 1024 * 1024)
+
+static size_t archive_cache_limit = LIBARCHIVE_DEFAULT_CACHE_LIMIT;
+
+#ifdef HAVE_LIBARCHIVE
+
+struct libarchive_handle {
+	char *path;
+	struct archive_cache *cache;
+
+	/* An open reader, positioned before the header of next_entry. */
+	struct archive *reader;
+	int64_t next_entry;
+
+	/* Total size of file contents kept in the cache. */
+	size_t cache_size;
+	size_t cache_limit;
 };
 
-/* Add a new cache node to an existing cache list and return the new head. */
-static struct archive_cache *archive_cache_new(struct archive_cache *cache,
-					       const char *name)
+/* Opens a new reader for given archive. Returns NULL on failure. */
+static struct archive *libarchive_open_reader(const char *fpath)
 {
-	struct archive_cache *c;
-
-	c = (struct archive_cache *)calloc(sizeof(*c), 1);
-	if (!c)
-		return NULL;
+	struct archive *a = archive_read_new();
 
-	c->name = strdup(name);
-	if (!c->name) {
-		free(c);
+	assert(a);
+	archive_read_support_filter_all(a);
+	archive_read_support_format_all(a);
+	if (archive_read_open_filename(a, fpath, 10240) != ARCHIVE_OK) {
+		ERROR("Failed parsing archive using libarchive: %s\n", fpath);
+		archive_read_free(a);
 		return NULL;
 	}
-
-	c->next = cache;
-	return c;
+	return a;
 }
 
-/* Find and return an entry (by name) from the cache. */
-static struct archive_cache *archive_cache_find(struct archive_cache *c,
-						const char *name)
+/*
+ * Reads the data of current entry from reader into a new buffer with an extra
+ * NUL byte. Returns the buffer, or NULL on failure.
+ */
+static uint8_t *libarchive_read_data(struct archive *a,
+				     struct archive_cache_entry *c)
 {
-	for (; c; c = c->next) {
-		assert(c->name);
-		if (!strcmp(c->name, name))
-			return c;
+	uint8_t *data = (uint8_t *)malloc(c->size + 1);
+
+	if (!data) {
+		ERROR("Out of memory when loading: %s\n", c->name);
+		return NULL;
 	}
-	return NULL;
+	if (archive_read_data(a, data, c->size) != (ssize_t)c->size) {
+		ERROR("Failed reading from archive: %s\n", c->name);
+		free(data);
+		return NULL;
+	}
+	data[c->size] = '\0';
+	return data;
 }
 
-/* Callback for archive_walk to process all entries in the cache. */
-static int archive_cache_walk(
-		struct archive_cache *c, void *arg,
-		int (*callback)(const char *name, void *arg))
+/*
+ * Keeps data as the cached contents of an entry if the cache limit allows.
+ * Returns 1 if the data is now owned by the cache, otherwise 0.
+ */
+static int libarchive_cache_data(struct libarchive_handle *h,
+				 struct archive_cache_entry *c, uint8_t *data)
 {
-	for (; c; c = c->next) {
-		assert(c->name);
-		if (callback(c->name, arg))
-			break;
-	}
-	return 0;
+	if (c->size > h->cache_limit - h->cache_size)
+		return 0;
+	c->data = data;
+	c->has_data = 1;
+	h->cache_size += c->size;
+	return 1;
 }
 
-/* Delete all entries in the cache. */
-static void *archive_cache_free(struct archive_cache *c)
+/*
+ * Decompresses the contents of an entry, continuing from the open reader if
+ * the entry is ahead of it, otherwise restarting from the beginning.
+ * Returns a new buffer, or NULL on failure.
+ */
+static uint8_t *libarchive_load_entry(struct libarchive_handle *h,
+				      struct archive_cache_entry *c)
 {
-	struct archive_cache *next;
+	struct archive_entry *entry;
 
-	while (c) {
-		next = c->next;
-		free(c->name);
-		free(c->data);
-		free(c);
-		c = next;
+	if (h->reader && h->next_entry > c->id) {
+		archive_read_free(h->reader);
+		h->reader = NULL;
 	}
+	if (!h->reader) {
+		VB2_DEBUG("Rewinding archive for: %s\n", c->name);
+		h->reader = libarchive_open_reader(h->path);
+		h->next_entry = 0;
+		if (!h->reader)
+			return NULL;
+	}
+
+	/* Headers skip the data of entries not read. */
+	while (archive_read_next_header(h->reader, &entry) == ARCHIVE_OK) {
+		if (h->next_entry++ == c->id)
+			return libarchive_read_data(h->reader, c);
+	}
+	ERROR("Entry disappeared from archive: %s\n", c->name);
+	archive_read_free(h->reader);
+	h->reader = NULL;
 	return NULL;
 }
 
-/*
- * -- The libarchive driver (multiple formats but very slow). --
- */
+/* Callback for archive_close on an ARCHIVE file. */
+static int archive_libarchive_close(void *handle)
+{
+	struct libarchive_handle *h = (struct libarchive_handle *)handle;
 
-enum {
-	FILTER_IGNORE,
-	FILTER_ABORT,
-	FILTER_NAME_ONLY,
-	FILTER_READ_ALL,
-};
+	if (h->reader)
+		archive_read_free(h->reader);
+	archive_cache_free(h->cache);
+	free(h->path);
+	free(h);
+	return 0;
+}
 
-static struct archive_cache *libarchive_read_file_entries(
-		const char *fpath, int (*filter)(struct archive_entry *entry))
+/* Callback for archive_open on an ARCHIVE file. */
+static void *archive_libarchive_open(const char *name)
 {
-	struct archive *a = archive_read_new();
+	struct libarchive_handle *h;
 	struct archive_entry *entry;
-	struct archive_cache *c, *cache = NULL;
-	int r;
+	struct archive_cache_entry *c;
+	struct archive *a;
+	uint8_t *data;
+	int64_t i;
 
-	assert(a);
-	archive_read_support_filter_all(a);
-	archive_read_support_format_all(a);
-	r = archive_read_open_filename(a, fpath, 10240);
-	if (r != ARCHIVE_OK) {
-		ERROR("Failed parsing archive using libarchive: %s\n", fpath);
+	a = libarchive_open_reader(name);
+	if (!a)
+		return NULL;
+
+	h = (struct libarchive_handle *)calloc(1, sizeof(*h));
+	if (h) {
+		h->path = strdup(name);
+		h->cache = archive_cache_new();
+		h->cache_limit = archive_cache_limit;
+	}
+	if (!h || !h->path || !h->cache) {
+		ERROR("Internal error: out of memory.\n");
+		if (h)
+			archive_libarchive_close(h);
 		archive_read_free(a);
 		return NULL;
 	}
 
-	WARN("Loading data from archive: %s ", fpath);
-	while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+	WARN("Loading data from archive: %s ", name);
+	for (i = 0; archive_read_next_header(a, &entry) == ARCHIVE_OK; i++) {
 		fputc('.', stderr);
 		if (archive_entry_filetype(entry) != AE_IFREG)
 			continue;
-		if (filter)
-			r = filter(entry);
-		else
-			r = FILTER_READ_ALL;
 
-		if (r == FILTER_ABORT)
-			break;
-		if (r == FILTER_IGNORE)
-			continue;
-
-		c = archive_cache_new(cache, archive_entry_pathname(entry));
+		c = archive_cache_add(h->cache, archive_entry_pathname(entry));
 		if (!c) {
 			ERROR("Internal error: out of memory.\n");
-			archive_cache_free(cache);
+			archive_libarchive_close(h);
 			archive_read_free(a);
 			return NULL;
 		}
-		cache = c;
-
-		if (r == FILTER_NAME_ONLY)
-			continue;
-
-		assert(r == FILTER_READ_ALL);
+		c->id = i;
 		c->size = archive_entry_size(entry);
 		c->mtime = archive_entry_mtime(entry);
-		c->data = (uint8_t *)calloc(1, c->size + 1);
-		if (!c->data) {
-			WARN("Out of memory when loading: %s\n", c->name);
-			continue;
-		}
-		if (archive_read_data(a, c->data, c->size) != c->size) {
-			WARN("Failed reading from archive: %s\n", c->name);
+
+		if (c->size > LIBARCHIVE_SMALL_FILE_SIZE ||
+		    c->size > h->cache_limit - h->cache_size)
 			continue;
-		}
-		c->has_data = 1;
+		data = libarchive_read_data(a, c);
+		if (data)
+			libarchive_cache_data(h, c, data);
 	}
 	fputs("\r\n", stderr);  /* Flush the '.' */
-	VB2_DEBUG("Finished loading from archive: %s.\n", fpath);
+	VB2_DEBUG("Finished scanning archive: %s (%zu bytes cached).\n",
+		  name, h->cache_size);
 
 	archive_read_free(a);
-	return cache;
-}
-
-/* Callback for archive_open on an ARCHIVE file. */
-static void *archive_libarchive_open(const char *name)
-{
-	/*
-	 * The firmware archives today can usually all load into memory
-	 * so we are using a NULL filter. Change that to a specific list in
-	 * future if the /build/$BOARD/firmware archive becomes too large.
-	 */
-	return libarchive_read_file_entries(name, NULL);
-}
-
-/* Callback for archive_close on an ARCHIVE file. */
-static int archive_libarchive_close(void *handle)
-{
-	archive_cache_free(handle);
-	return 0;
+	return h;
 }
 
 /* Callback for archive_has_entry on an ARCHIVE file. */
 static int archive_libarchive_has_entry(void *handle, const char *fname)
 {
-	return archive_cache_find(handle, fname) != NULL;
+	struct libarchive_handle *h = (struct libarchive_handle *)handle;
+
+	return archive_cache_find(h->cache, fname) != NULL;
 }
 
 /* Callback for archive_walk on an ARCHIVE file. */
@@ -375,7 +713,19 @@ static int archive_libarchive_walk(
 		void *handle, void *arg,
 		int (*callback)(const char *name, void *arg))
 {
-	return archive_cache_walk(handle, arg, callback);
+	struct libarchive_handle *h = (struct libarchive_handle *)handle;
+
+	return archive_cache_walk(h->cache, arg, callback);
+}
+
+/* Callback for archive_walk_prefix on an ARCHIVE file. */
+static int archive_libarchive_walk_prefix(
+		void *handle, const char *prefix, void *arg,
+		int (*callback)(const char *name, void *arg))
+{
+	struct libarchive_handle *h = (struct libarchive_handle *)handle;
+
+	return archive_cache_walk_prefix(h->cache, prefix, arg, callback);
 }
 
 /* Callback for archive_read_file on an ARCHIVE file. */
@@ -383,15 +733,26 @@ static int archive_libarchive_read_file(
 		void *handle, const char *fname, uint8_t **data,
 		uint32_t *size, int64_t *mtime)
 {
-	struct archive_cache *c = archive_cache_find(handle, fname);
+	struct libarchive_handle *h = (struct libarchive_handle *)handle;
+	struct archive_cache_entry *c = archive_cache_find(h->cache, fname);
+	uint8_t *loaded;
 
 	if (!c)
 		return 1;
 
 	if (!c->has_data) {
-		/* TODO(hungte) Re-read. */
-		ERROR("Not in the cache: %s\n", fname);
-		return 1;
+		loaded = libarchive_load_entry(h, c);
+		if (!loaded)
+			return 1;
+		/* Too large to cache: give the buffer to the caller. */
+		if (!libarchive_cache_data(h, c, loaded)) {
+			if (mtime)
+				*mtime = c->mtime;
+			if (size)
+				*size = c->size;
+			*data = loaded;
+			return 0;
+		}
 	}
 
 	if (mtime)
@@ -424,28 +785,71 @@ static int archive_libarchive_write_file(
 
 #ifdef HAVE_LIBZIP
 
-/* Callback for archive_open on a ZIP file. */
-static void *archive_zip_open(const char *name)
-{
-	return zip_open(name, 0, NULL);
-}
+/* A ZIP file, with the names of its files indexed by a cache. */
+struct zip_handle {
+	struct zip *zip;
+	struct archive_cache *cache;
+};
 
 /* Callback for archive_close on a ZIP file. */
 static int archive_zip_close(void *handle)
 {
-	struct zip *zip = (struct zip *)handle;
+	struct zip_handle *h = (struct zip_handle *)handle;
+	int r = 0;
+
+	if (!h)
+		return 0;
+	if (h->zip)
+		r = zip_close(h->zip);
+	archive_cache_free(h->cache);
+	free(h);
+	return r;
+}
 
-	if (zip)
-		return zip_close(zip);
-	return 0;
+/* Callback for archive_open on a ZIP file. */
+static void *archive_zip_open(const char *name)
+{
+	struct zip_handle *h;
+	zip_int64_t num, i;
+
+	h = (struct zip_handle *)calloc(sizeof(*h), 1);
+	if (!h)
+		return NULL;
+	h->zip = zip_open(name, 0, NULL);
+	h->cache = archive_cache_new();
+	if (!h->zip || !h->cache) {
+		archive_zip_close(h);
+		return NULL;
+	}
+
+	num = zip_get_num_entries(h->zip, 0);
+	for (i = 0; i < num; i++) {
+		const char *fname = zip_get_name(h->zip, i, 0);
+		struct archive_cache_entry *e;
+
+		if (!fname || (*fname && fname[strlen(fname) - 1] == '/'))
+			continue;
+		e = archive_cache_add(h->cache, fname);
+		if (!e) {
+			ERROR("Internal error: out of memory.\n");
+			archive_zip_close(h);
+			return NULL;
+		}
+		e->id = i;
+	}
+	return h;
 }
 
 /* Callback for archive_has_entry on a ZIP file. */
 static int archive_zip_has_entry(void *handle, const char *fname)
 {
-	struct zip *zip = (struct zip *)handle;
-	assert(zip);
-	return zip_name_locate(zip, fname, 0) != -1;
+	struct zip_handle *h = (struct zip_handle *)handle;
+	assert(h);
+
+	if (archive_cache_find(h->cache, fname))
+		return 1;
+	/* Directories are not in the cache. */
+	return zip_name_locate(h->zip, fname, 0) != -1;
 }
 
 /* Callback for archive_walk on a ZIP file. */
@@ -453,40 +857,40 @@ static int archive_zip_walk(
 		void *handle, void *arg,
 		int (*callback)(const char *name, void *arg))
 {
-	zip_int64_t num, i;
-	struct zip *zip = (struct zip *)handle;
-	assert(zip);
+	struct zip_handle *h = (struct zip_handle *)handle;
+	assert(h);
+	return archive_cache_walk(h->cache, arg, callback);
+}
 
-	num = zip_get_num_entries(zip, 0);
-	if (num < 0)
-		return 1;
-	for (i = 0; i < num; i++) {
-		const char *name = zip_get_name(zip, i, 0);
-		if (*name && name[strlen(name) - 1] == '/')
-			continue;
-		if (callback(name, arg))
-			break;
-	}
-	return 0;
+/* Callback for archive_walk_prefix on a ZIP file. */
+static int archive_zip_walk_prefix(
+		void *handle, const char *prefix, void *arg,
+		int (*callback)(const char *name, void *arg))
+{
+	struct zip_handle *h = (struct zip_handle *)handle;
+	assert(h);
+	return archive_cache_walk_prefix(h->cache, prefix, arg, callback);
 }
 
 /* Callback for archive_zip_read_file on a ZIP file. */
 static int archive_zip_read_file(void *handle, const char *fname,
 			     uint8_t **data, uint32_t *size, int64_t *mtime)
 {
-	struct zip *zip = (struct zip *)handle;
+	struct zip_handle *h = (struct zip_handle *)handle;
+	struct archive_cache_entry *e;
 	struct zip_file *fp;
 	struct zip_stat stat;
 
-	assert(zip);
+	assert(h);
 	*data = NULL;
 	*size = 0;
+	e = archive_cache_find(h->cache, fname);
 	zip_stat_init(&stat);
-	if (zip_stat(zip, fname, 0, &stat)) {
+	if (!e || zip_stat_index(h->zip, e->id, 0, &stat)) {
 		ERROR("Fail to stat entry in ZIP: %s\n", fname);
 		return 1;
 	}
-	fp = zip_fopen(zip, fname, 0);
+	fp = zip_fopen_index(h->zip, e->id, 0);
 	if (!fp) {
 		ERROR("Failed to open entry in ZIP: %s\n", fname);
 		return 1;
@@ -512,26 +916,37 @@ static int archive_zip_read_file(void *handle, const char *fname,
 static int archive_zip_write_file(void *handle, const char *fname,
 				  uint8_t *data, uint32_t size, int64_t mtime)
 {
-	struct zip *zip = (struct zip *)handle;
+	struct zip_handle *h = (struct zip_handle *)handle;
+	struct archive_cache_entry *e;
 	struct zip_source *src;
+	zip_int64_t index;
 
 	VB2_DEBUG("Writing %s\n", fname);
-	assert(zip);
-	src = zip_source_buffer(zip, data, size, 0);
+	assert(h);
+	src = zip_source_buffer(h->zip, data, size, 0);
 	if (!src) {
 		ERROR("Internal error: cannot allocate buffer: %s\n", fname);
 		return 1;
 	}
 
-	if (zip_file_add(zip, fname, src, ZIP_FL_OVERWRITE) < 0) {
+	index = zip_file_add(h->zip, fname, src, ZIP_FL_OVERWRITE);
+	if (index < 0) {
 		zip_source_free(src);
 		ERROR("Internal error: failed to add: %s\n", fname);
 		return 1;
 	}
 	/* zip_source_free is not needed if zip_file_add success. */
 #if LIBZIP_VERSION_MAJOR >= 1
-	zip_file_set_mtime(zip, zip_name_locate(zip, fname, 0), mtime, 0);
+	zip_file_set_mtime(h->zip, index, mtime, 0);
 #endif
+	e = archive_cache_find(h->cache, fname);
+	if (!e)
+		e = archive_cache_add(h->cache, fname);
+	if (!e) {
+		ERROR("Internal error: out of memory.\n");
+		return 1;
+	}
+	e->id = index;
 	return 0;
 }
 #endif
@@ -540,6 +955,15 @@ static int archive_zip_write_file(void *handle, const char *fname,
  * -- The public functions for using u_archive. --
  */
 
+/*
+ * Sets the maximum size of file contents that drivers without random access
+ * (libarchive) keep in memory, for archives opened afterwards.
+ */
+void archive_set_cache_limit(size_t limit)
+{
+	archive_cache_limit = limit;
+}
+
 /*
  * Opens an archive from given path.
  * The type of archive will be determined automatically.
@@ -569,8 +993,10 @@ struct u_archive *archive_open(const char *path)
 		ar->open = archive_fallback_open;
 		ar->close = archive_fallback_close;
 		ar->walk = archive_fallback_walk;
+		ar->walk_prefix = archive_fallback_walk_prefix;
 		ar->has_entry = archive_fallback_has_entry;
 		ar->read_file = archive_fallback_read_file;
+		ar->map_file = archive_fallback_map_file;
 		ar->write_file = archive_fallback_write_file;
 	}
 
@@ -584,6 +1010,7 @@ struct u_archive *archive_open(const char *path)
 			ar->open = archive_zip_open;
 			ar->close = archive_zip_close;
 			ar->walk = archive_zip_walk;
+			ar->walk_prefix = archive_zip_walk_prefix;
 			ar->has_entry = archive_zip_has_entry;
 			ar->read_file = archive_zip_read_file;
 			ar->write_file = archive_zip_write_file;
@@ -598,6 +1025,7 @@ struct u_archive *archive_open(const char *path)
 		ar->open = archive_libarchive_open;
 		ar->close = archive_libarchive_close;
 		ar->walk = archive_libarchive_walk;
+		ar->walk_prefix = archive_libarchive_walk_prefix;
 		ar->has_entry = archive_libarchive_has_entry;
 		ar->read_file = archive_libarchive_read_file;
 		ar->write_file = archive_libarchive_write_file;
@@ -661,6 +1089,20 @@ int archive_walk(struct u_archive *ar, void *arg,
 	return ar->walk(ar->handle, arg, callback);
 }
 
+/*
+ * Traverses files within archive with names starting with prefix, in sorted
+ * order. Otherwise the same as archive_walk.
+ * Returns 0 on success otherwise non-zero as failure.
+ */
+int archive_walk_prefix(struct u_archive *ar, const char *prefix, void *arg,
+			int (*callback)(const char *path, void *arg))
+{
+	if (!ar)
+		return archive_fallback_walk_prefix(NULL, prefix, arg,
+						    callback);
+	return ar->walk_prefix(ar->handle, prefix, arg, callback);
+}
+
 /*
  * Reads a file from archive.
  * If entry name (fname) is an absolute path (/file), always read
@@ -678,6 +1120,32 @@ int archive_read_file(struct u_archive *ar, const char *fname,
 	return ar->read_file(ar->handle, fname, data, size, mtime);
 }
 
+/*
+ * Maps a file from archive into memory, if the driver allows that.
+ * The mapping is private and copy-on-write, so the data can be modified without
+ * changing the archive and only the pages modified take extra memory.
+ * The data has no extra '\0' in the end and must be released by
+ * archive_unmap_file.
+ * Returns 0 on success, otherwise non-zero (use archive_read_file instead).
+ */
+int archive_map_file(struct u_archive *ar, const char *fname,
+		     uint8_t **data, uint32_t *size)
+{
+	if (!ar || *fname == '/')
+		return archive_fallback_map_file(NULL, fname, data, size);
+	if (!ar->map_file)
+		return 1;
+	return ar->map_file(ar->handle, fname, data, size);
+}
+
+/*
+ * Releases the data returned by archive_map_file.
+ */
+void archive_unmap_file(uint8_t *data, uint32_t size)
+{
+	munmap(data, size);
+}
+
 /*
  * Writes a file into archive.
  * If entry name (fname) is an absolute path (/file), always write into real
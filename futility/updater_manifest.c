@@ -64,6 +64,7 @@ static const char * const SETVARS_IMAGE_MAIN = "IMAGE_MAIN",
 		  * const VPD_CUSTOMIZATION_ID = "customization_id",
 		  * const ENV_VAR_MODEL_DIR = "${MODEL_DIR}",
 		  * const PATH_STARTSWITH_KEYSET = "keyset/",
+		  * const PATH_STARTSWITH_MODELS = "models/",
 		  * const PATH_SIGNER_CONFIG = "signer_config.csv",
 		  * const PATH_ENDSWITH_SETVARS = "/setvars.sh";
 
@@ -331,7 +332,19 @@ static struct model_config *manifest_add_model(
 }
 
 /*
- * A callback function for manifest to scan files in archive.
+ * A callback function for manifest to find files in keyset/.
+ * Returns non-zero to stop at the first file.
+ */
+static int manifest_scan_keyset(const char *name, void *arg)
+{
+	struct manifest *manifest = (struct manifest *)arg;
+
+	manifest->has_keyset = 1;
+	return 1;
+}
+
+/*
+ * A callback function for manifest to scan files in models/.
  * Returns 0 to keep scanning, or non-zero to stop.
  */
 static int manifest_scan_entries(const char *name, void *arg)
@@ -341,8 +354,6 @@ static int manifest_scan_entries(const char *name, void *arg)
 	struct model_config model = {0};
 	char *slash;
 
-	if (str_startswith(name, PATH_STARTSWITH_KEYSET))
-		manifest->has_keyset = 1;
 	if (!str_endswith(name, PATH_ENDSWITH_SETVARS))
 		return 0;
 
@@ -762,8 +773,13 @@ struct manifest *new_manifest_from_archive(struct u_archive *archive)
 	manifest.archive = archive;
 	manifest.default_model = -1;
 
-	VB2_DEBUG("Try to build a manifest from *%s\n", PATH_ENDSWITH_SETVARS);
-	archive_walk(archive, &manifest, manifest_scan_entries);
+	archive_walk_prefix(archive, PATH_STARTSWITH_KEYSET, &manifest,
+			    manifest_scan_keyset);
+
+	VB2_DEBUG("Try to build a manifest from %s*%s\n",
+		  PATH_STARTSWITH_MODELS, PATH_ENDSWITH_SETVARS);
+	archive_walk_prefix(archive, PATH_STARTSWITH_MODELS, &manifest,
+			    manifest_scan_entries);
 
 	if (manifest.num == 0) {
 		VB2_DEBUG("Try to build a manifest from %s\n",
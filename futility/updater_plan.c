@@ -0,0 +1,438 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Planning the erase and write operations for updating firmware sections,
+ * and reporting where the time of an update goes.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+
+#include "updater.h"
+
+/* An FMAP section (or whole image) to be written, in image offsets. */
+struct plan_region {
+	uint32_t start, end;
+};
+
+/* qsort callback to sort regions by offset. */
+static int compare_regions(const void *a, const void *b)
+{
+	const struct plan_region *ra = a, *rb = b;
+
+	if (ra->start != rb->start)
+		return ra->start < rb->start ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Collects the regions to write from image_to, sorted by offset with the
+ * overlapping ones merged. Returns the number of regions, or -1 on failure.
+ */
+static int collect_regions(struct plan_region **regions,
+			   const struct firmware_image *image_to,
+			   const char * const sections[])
+{
+	struct firmware_section section;
+	struct plan_region *r;
+	int i, n, count = 0;
+
+	for (n = 0; sections && sections[n]; n++)
+		;
+	r = (struct plan_region *)calloc(n ? n : 1, sizeof(*r));
+	if (!r)
+		return -1;
+
+	if (!sections) {
+		r[0].end = image_to->size;
+		*regions = r;
+		return 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (find_firmware_section(&section, image_to, sections[i])) {
+			VB2_DEBUG("Cannot find section %s.\n", sections[i]);
+			free(r);
+			return -1;
+		}
+		r[i].start = section.data - image_to->data;
+		r[i].end = r[i].start + section.size;
+	}
+	qsort(r, n, sizeof(*r), compare_regions);
+
+	for (i = 0; i < n; i++) {
+		if (count && r[i].start <= r[count - 1].end) {
+			if (r[i].end > r[count - 1].end)
+				r[count - 1].end = r[i].end;
+			continue;
+		}
+		r[count++] = r[i];
+	}
+	*regions = r;
+	return count;
+}
+
+/* Appends a range to the plan, merging with the last one if possible. */
+static int add_range(struct flash_write_plan *plan, uint32_t offset,
+		     uint32_t size, int erase)
+{
+	struct flash_range *last = NULL, *ranges;
+
+	if (plan->num_ranges)
+		last = &plan->ranges[plan->num_ranges - 1];
+	if (last && last->erase == erase &&
+	    last->offset + last->size == offset) {
+		last->size += size;
+		return 0;
+	}
+
+	ranges = (struct flash_range *)realloc(
+			plan->ranges, (plan->num_ranges + 1) * sizeof(*ranges));
+	if (!ranges)
+		return -1;
+	plan->ranges = ranges;
+	plan->ranges[plan->num_ranges].offset = offset;
+	plan->ranges[plan->num_ranges].size = size;
+	plan->ranges[plan->num_ranges].erase = erase;
+	plan->num_ranges++;
+	return 0;
+}
+
+/*
+ * Compares the part of an erase block (from offset to end) that should be
+ * written, and updates the plan if anything has changed.
+ * Returns 0 on success, otherwise -1.
+ */
+static int plan_block(struct flash_write_plan *plan,
+		      const uint8_t *from, const uint8_t *to,
+		      uint32_t offset, uint32_t end)
+{
+	uint32_t i, written = 0;
+	int erase = 0;
+
+	if (!memcmp(from + offset, to + offset, end - offset))
+		return 0;
+
+	/* Erasing sets all bits; programming can only clear bits. */
+	for (i = offset; i < end && !erase; i++)
+		erase = (from[i] & to[i]) != to[i];
+
+	for (i = offset; i < end; i++) {
+		if (erase ? to[i] != 0xff : to[i] != from[i])
+			written++;
+	}
+
+	plan->bytes_changed += end - offset;
+	plan->bytes_written += written;
+	if (erase)
+		plan->blocks_erased++;
+	return add_range(plan, offset, end - offset, erase);
+}
+
+/*
+ * Plans the erase and write operations needed to change the sections of
+ * image_from (usually what is on the flash) into the ones in image_to, in
+ * erase blocks of block_size bytes. Sections should be NULL for the whole
+ * image, or a NULL terminated list of FMAP section names.
+ * The ranges are ordered by offset and limited to the sections.
+ * Returns 0 on success (plan must be released by free_flash_write_plan),
+ * otherwise non-zero if the images can't be compared.
+ */
+int plan_flash_write(struct flash_write_plan *plan,
+		     const struct firmware_image *image_from,
+		     const struct firmware_image *image_to,
+		     const char * const sections[], uint32_t block_size)
+{
+	struct plan_region *regions = NULL;
+	uint32_t offset, end;
+	int i, count;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->block_size = block_size;
+
+	assert(block_size);
+	if (!image_from->data || !image_to->data ||
+	    image_from->size != image_to->size)
+		return -1;
+
+	count = collect_regions(&regions, image_to, sections);
+	if (count < 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		plan->bytes_total += regions[i].end - regions[i].start;
+		for (offset = regions[i].start; offset < regions[i].end;
+		     offset = end) {
+			end = (offset / block_size + 1) * block_size;
+			if (end > regions[i].end)
+				end = regions[i].end;
+			if (plan_block(plan, image_from->data, image_to->data,
+				       offset, end)) {
+				free(regions);
+				free_flash_write_plan(plan);
+				return -1;
+			}
+		}
+	}
+	free(regions);
+	return 0;
+}
+
+/*
+ * Estimates the time (in milliseconds) for the flash operations in a plan,
+ * on a flash with given speed.
+ */
+uint32_t estimate_flash_write_ms(const struct flash_write_plan *plan,
+				 const struct flash_speed *speed)
+{
+	uint64_t erased = (uint64_t)plan->blocks_erased * plan->block_size;
+
+	assert(speed->erase_kbps && speed->write_kbps);
+	return erased * 1000 / (speed->erase_kbps * 1024ULL) +
+		plan->bytes_written * 1000ULL / (speed->write_kbps * 1024ULL);
+}
+
+/*
+ * Copies the ranges in a plan from image_to to image_from, for example to keep
+ * image_from in sync with the flash after the plan was written.
+ */
+void apply_flash_write_plan(const struct flash_write_plan *plan,
+			    struct firmware_image *image_from,
+			    const struct firmware_image *image_to)
+{
+	int i;
+
+	for (i = 0; i < plan->num_ranges; i++)
+		memcpy(image_from->data + plan->ranges[i].offset,
+		       image_to->data + plan->ranges[i].offset,
+		       plan->ranges[i].size);
+}
+
+/*
+ * Calculates the digest a chunk should have after writing a plan: image_to in
+ * the ranges of the plan, and image_from (what was on the flash) elsewhere.
+ * Returns 0 on success, otherwise -1.
+ */
+static int hash_verify_chunk(struct flash_verify_chunk *chunk,
+			     const struct flash_write_plan *plan,
+			     const uint8_t *from, const uint8_t *to)
+{
+	struct vb2_digest_context dc;
+	uint32_t offset = chunk->offset, end = chunk->offset + chunk->size;
+	int i;
+
+	if (vb2_digest_init(&dc, VB2_HASH_SHA256))
+		return -1;
+
+	for (i = 0; i < plan->num_ranges && offset < end; i++) {
+		const struct flash_range *r = &plan->ranges[i];
+		uint32_t r_start = VB2_MAX(r->offset, offset);
+		uint32_t r_end = VB2_MIN(r->offset + r->size, end);
+
+		if (r_start >= r_end)
+			continue;
+		if (vb2_digest_extend(&dc, from + offset, r_start - offset) ||
+		    vb2_digest_extend(&dc, to + r_start, r_end - r_start))
+			return -1;
+		offset = r_end;
+	}
+
+	chunk->digest.algo = VB2_HASH_SHA256;
+	if (vb2_digest_extend(&dc, from + offset, end - offset) ||
+	    vb2_digest_finalize(&dc, chunk->digest.sha256,
+				sizeof(chunk->digest.sha256)))
+		return -1;
+	return 0;
+}
+
+/*
+ * Splits the erase blocks written by a plan into chunks of at most chunk_size
+ * bytes (a multiple of the block size) to read back after writing, and
+ * calculates the digest each chunk should have, from image_from (what is on
+ * the flash) and image_to. Whole erase blocks are verified, since the flash
+ * erases and rewrites them even if the plan only changes a part.
+ * Returns the number of chunks (*chunks must be freed by caller), or -1 on
+ * failure.
+ */
+int plan_flash_verify(struct flash_verify_chunk **chunks,
+		      const struct flash_write_plan *plan,
+		      const struct firmware_image *image_from,
+		      const struct firmware_image *image_to,
+		      uint32_t chunk_size)
+{
+	const uint32_t block_size = plan->block_size;
+	struct flash_verify_chunk *c = NULL, *new_c;
+	uint64_t start, end;
+	uint32_t offset, size;
+	int i, j, count = 0;
+
+	assert(block_size && chunk_size && chunk_size % block_size == 0);
+	*chunks = NULL;
+	if (image_from->size != image_to->size)
+		return -1;
+
+	for (i = 0; i < plan->num_ranges; i = j) {
+		const struct flash_range *r = &plan->ranges[i];
+
+		start = r->offset / block_size * block_size;
+		end = ((uint64_t)r->offset + r->size + block_size - 1) /
+			block_size * block_size;
+		/* Merge the ranges in the same or adjacent blocks. */
+		for (j = i + 1; j < plan->num_ranges &&
+		     plan->ranges[j].offset <= end; j++) {
+			r = &plan->ranges[j];
+			end = ((uint64_t)r->offset + r->size + block_size -
+			       1) / block_size * block_size;
+		}
+		end = VB2_MIN(end, image_to->size);
+
+		for (offset = start; offset < end; offset += size) {
+			size = VB2_MIN(chunk_size, end - offset);
+			new_c = (struct flash_verify_chunk *)realloc(
+					c, (count + 1) * sizeof(*c));
+			if (!new_c)
+				goto fail;
+			c = new_c;
+			c[count].offset = offset;
+			c[count].size = size;
+			if (hash_verify_chunk(&c[count], plan,
+					      image_from->data,
+					      image_to->data))
+				goto fail;
+			count++;
+		}
+	}
+	*chunks = c;
+	return count;
+
+fail:
+	free(c);
+	return -1;
+}
+
+/*
+ * Verifies a chunk read back from the flash against its digest.
+ * Returns 0 if it matches, otherwise 1 (reported as an error).
+ */
+int verify_flash_chunk(const struct flash_verify_chunk *chunk,
+		       const uint8_t *data)
+{
+	struct vb2_hash hash;
+
+	if (vb2_hash_calculate(data, chunk->size, VB2_HASH_SHA256,
+			       &hash) == VB2_SUCCESS &&
+	    !memcmp(hash.sha256, chunk->digest.sha256, sizeof(hash.sha256)))
+		return 0;
+	ERROR("Mismatch in flash %#x+%#x.\n", chunk->offset, chunk->size);
+	return 1;
+}
+
+/*
+ * Frees the resources allocated by plan_flash_write.
+ */
+void free_flash_write_plan(struct flash_write_plan *plan)
+{
+	free(plan->ranges);
+	memset(plan, 0, sizeof(*plan));
+}
+
+static const char * const stage_names[STAGE_MAX] = {
+	[STAGE_ARCHIVE] = "archive",
+	[STAGE_MANIFEST] = "manifest",
+	[STAGE_LOAD_IMAGE] = "load_image",
+	[STAGE_FLASH_READ] = "flash_read",
+	[STAGE_PRESERVE] = "preserve",
+	[STAGE_COMPARE] = "compare",
+	[STAGE_FLASH_WRITE] = "flash_write",
+	[STAGE_VERIFY] = "verify",
+};
+
+/* Returns a monotonic time stamp in microseconds, for timing stages. */
+uint64_t updater_timing_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Records that a stage which began at start_us (from updater_timing_now) has
+ * finished after processing the given number of bytes.
+ */
+void updater_timing_record(struct updater_config *cfg,
+			   enum updater_stage stage, uint64_t start_us,
+			   uint64_t bytes)
+{
+	struct updater_stage_stats *s = &cfg->timing.stages[stage];
+
+	s->count++;
+	s->us += updater_timing_now() - start_us;
+	s->bytes += bytes;
+}
+
+/* Adds a flash write plan to the estimates in the timing report. */
+void updater_timing_add_plan(struct updater_config *cfg,
+			     const struct flash_write_plan *plan)
+{
+	struct updater_timing *t = &cfg->timing;
+
+	t->num_plans++;
+	t->bytes_changed += plan->bytes_changed;
+	t->blocks_erased += plan->blocks_erased;
+	t->bytes_written += plan->bytes_written;
+	t->estimated_ms += estimate_flash_write_ms(plan, &cfg->flash_speed);
+}
+
+/*
+ * Writes the timing report in JSON format to given file, or stdout if the
+ * file name is "-". Returns 0 on success, otherwise failure.
+ */
+int updater_write_json_timing(const struct updater_config *cfg,
+			      const char *file_name)
+{
+	const struct updater_timing *t = &cfg->timing;
+	int i, r;
+	FILE *fp;
+
+	if (strcmp(file_name, "-") == 0)
+		fp = stdout;
+	else
+		fp = fopen(file_name, "w");
+	if (!fp) {
+		ERROR("Cannot open %s: %s\n", file_name, strerror(errno));
+		return -1;
+	}
+
+	fprintf(fp, "{\n  \"dry_run\": %s,\n", cfg->dry_run ? "true" : "false");
+	fprintf(fp, "  \"total_ms\": %ju,\n",
+		(uintmax_t)(updater_timing_now() - t->start_us) / 1000);
+	fprintf(fp, "  \"stages\": {\n");
+	for (i = 0; i < STAGE_MAX; i++) {
+		const struct updater_stage_stats *s = &t->stages[i];
+
+		fprintf(fp, "    \"%s\": { \"count\": %d, \"ms\": %ju, "
+			"\"bytes\": %ju }%s\n", stage_names[i], s->count,
+			(uintmax_t)s->us / 1000, (uintmax_t)s->bytes,
+			i + 1 < STAGE_MAX ? "," : "");
+	}
+	fprintf(fp, "  },\n  \"flash\": {\n");
+	fprintf(fp, "    \"erase_kbps\": %u,\n    \"write_kbps\": %u,\n",
+		cfg->flash_speed.erase_kbps, cfg->flash_speed.write_kbps);
+	fprintf(fp, "    \"plans\": %d,\n", t->num_plans);
+	fprintf(fp, "    \"bytes_changed\": %ju,\n",
+		(uintmax_t)t->bytes_changed);
+	fprintf(fp, "    \"blocks_erased\": %ju,\n",
+		(uintmax_t)t->blocks_erased);
+	fprintf(fp, "    \"bytes_written\": %ju,\n",
+		(uintmax_t)t->bytes_written);
+	fprintf(fp, "    \"estimated_ms\": %ju\n  }\n}\n",
+		(uintmax_t)t->estimated_ms);
+
+	if (fp == stdout)
+		return fflush(fp) != 0;
+	r = ferror(fp);
+	return fclose(fp) || r;
+}
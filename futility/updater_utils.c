@@ -6,14 +6,14 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <string.h>
 #include <unistd.h>
-#if defined (__FreeBSD__) || defined(__OpenBSD__)
-#include <sys/wait.h>
-#endif
 
 #include "2common.h"
 #include "crossystem.h"
@@ -74,23 +74,218 @@ int save_file_from_stdin(const char *output)
 	return 0;
 }
 
+/* CBFS file header (big endian), followed by the file name. */
+#define CBFS_FILE_MAGIC "LARCHIVE"
+#define CBFS_FILE_HEADER_SIZE 24
+#define CBFS_ALIGNMENT 64
+#define CBFS_TYPE_DELETED 0x00000000
+#define CBFS_TYPE_NULL 0xffffffff
+#define CBFS_FILE_ATTR_TAG_COMPRESSION 0x42435a4c
+
+static uint32_t cbfs_get32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/* Returns the compression algorithm of a CBFS file, from its attributes. */
+static uint32_t cbfs_get_compression(const uint8_t *file, uint32_t attr,
+				     uint32_t end)
+{
+	uint32_t tag, len;
+
+	for (; attr && attr + 8 <= end; attr += len) {
+		tag = cbfs_get32(file + attr);
+		len = cbfs_get32(file + attr + 4);
+		if (len < 8 || len > end - attr)
+			break;
+		if (tag == CBFS_FILE_ATTR_TAG_COMPRESSION && len >= 12)
+			return cbfs_get32(file + attr + 8);
+	}
+	return 0;
+}
+
+/*
+ * Builds an index of the files in the CBFS of an FMAP section, by walking the
+ * file headers in the loaded image. Entries point into the image, so the
+ * index must not be used after the image is changed or freed.
+ * Returns 0 on success (index must be released by cbfs_free_index),
+ * otherwise non-zero.
+ */
+int cbfs_load_index(struct cbfs_index *index,
+		    const struct firmware_image *image,
+		    const char *section_name)
+{
+	struct firmware_section section;
+	struct cbfs_entry *entries, *e;
+	uint32_t pos, size, len, type, attr, offset, name_end;
+	const uint8_t *file;
+
+	memset(index, 0, sizeof(*index));
+	find_firmware_section(&section, image, section_name);
+	if (!section.data) {
+		VB2_DEBUG("Missing region: %s\n", section_name);
+		return -1;
+	}
+	size = section.size;
+
+	for (pos = 0; pos + CBFS_FILE_HEADER_SIZE <= size;
+	     pos = (pos + offset + len + CBFS_ALIGNMENT - 1) /
+		   CBFS_ALIGNMENT * CBFS_ALIGNMENT) {
+		file = section.data + pos;
+		/* Files are packed from the start; the rest is empty. */
+		if (memcmp(file, CBFS_FILE_MAGIC, strlen(CBFS_FILE_MAGIC)))
+			break;
+		len = cbfs_get32(file + 8);
+		type = cbfs_get32(file + 12);
+		attr = cbfs_get32(file + 16);
+		offset = cbfs_get32(file + 20);
+		name_end = attr ? attr : offset;
+		if (offset <= CBFS_FILE_HEADER_SIZE || offset > size - pos ||
+		    len > size - pos - offset ||
+		    name_end < CBFS_FILE_HEADER_SIZE || name_end > offset ||
+		    !memchr(file + CBFS_FILE_HEADER_SIZE, '\0',
+			    name_end - CBFS_FILE_HEADER_SIZE)) {
+			WARN("Corrupted CBFS file at %s+%#x.\n",
+			     section_name, pos);
+			break;
+		}
+		if (type == CBFS_TYPE_DELETED || type == CBFS_TYPE_NULL)
+			continue;
+
+		entries = (struct cbfs_entry *)realloc(
+				index->entries,
+				(index->num_entries + 1) * sizeof(*entries));
+		if (!entries) {
+			cbfs_free_index(index);
+			return -1;
+		}
+		index->entries = entries;
+		e = &entries[index->num_entries++];
+		e->name = (const char *)file + CBFS_FILE_HEADER_SIZE;
+		e->type = type;
+		e->compression = cbfs_get_compression(file, attr, offset);
+		e->data = section.data + pos + offset;
+		e->size = len;
+	}
+	return 0;
+}
+
+/*
+ * Returns the entry of a file with given name in a CBFS index,
+ * or NULL if not found.
+ */
+const struct cbfs_entry *cbfs_find_entry(const struct cbfs_index *index,
+					 const char *name)
+{
+	int i;
+
+	for (i = 0; i < index->num_entries; i++) {
+		if (strcmp(index->entries[i].name, name) == 0)
+			return &index->entries[i];
+	}
+	return NULL;
+}
+
+/* Frees the resources allocated by cbfs_load_index. */
+void cbfs_free_index(struct cbfs_index *index)
+{
+	free(index->entries);
+	memset(index, 0, sizeof(*index));
+}
+
+/* The index of one CBFS section, kept with the image. */
+struct cbfs_index_cache {
+	struct cbfs_index_cache *next;
+	char *section_name;
+	int status;  /* Result of cbfs_load_index. */
+	struct cbfs_index index;
+};
+
+/*
+ * Returns the index of the CBFS in an FMAP section, loading it on first use
+ * and keeping it with the image, or NULL if the section is missing.
+ */
+const struct cbfs_index *cbfs_get_index(const struct firmware_image *image,
+					const char *section_name)
+{
+	/* The cache doesn't change the image contents. */
+	struct firmware_image *cached = (struct firmware_image *)image;
+	struct cbfs_index_cache *c;
+
+	for (c = image->cbfs_indexes; c; c = c->next) {
+		if (!strcmp(c->section_name, section_name))
+			return c->status ? NULL : &c->index;
+	}
+
+	c = (struct cbfs_index_cache *)calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+	c->section_name = strdup(section_name);
+	if (!c->section_name) {
+		free(c);
+		return NULL;
+	}
+	c->status = cbfs_load_index(&c->index, image, section_name);
+	c->next = cached->cbfs_indexes;
+	cached->cbfs_indexes = c;
+	return c->status ? NULL : &c->index;
+}
+
+/*
+ * Frees the CBFS indexes kept with an image. Must be called when a CBFS
+ * section of the loaded image is changed.
+ */
+void cbfs_free_indexes(struct firmware_image *image)
+{
+	struct cbfs_index_cache *c;
+
+	while (image->cbfs_indexes) {
+		c = image->cbfs_indexes;
+		image->cbfs_indexes = c->next;
+		cbfs_free_index(&c->index);
+		free(c->section_name);
+		free(c);
+	}
+}
+
 /*
  * Returns 1 if a given file (cbfs_entry_name) exists inside a particular CBFS
- * section of an image file, otherwise 0.
+ * section of a loaded firmware image, otherwise 0.
  */
-int cbfs_file_exists(const char *image_file,
+int cbfs_file_exists(const struct firmware_image *image,
 		     const char *section_name,
 		     const char *cbfs_entry_name)
 {
-	char *cmd;
-	int r;
+	const struct cbfs_index *index = cbfs_get_index(image, section_name);
 
-	ASPRINTF(&cmd,
-		 "cbfstool '%s' print -r %s 2>/dev/null | grep -q '^%s '",
-		 image_file, section_name, cbfs_entry_name);
-	r = system(cmd);
-	free(cmd);
-	return !r;
+	return index && cbfs_find_entry(index, cbfs_entry_name);
+}
+
+/*
+ * Finds the contents of a file inside a particular CBFS section of a loaded
+ * firmware image, without copying. file->data points into the image.
+ * Returns 0 on success, -1 if the file does not exist, or 1 if the file is
+ * compressed (and must be extracted by cbfs_extract_file).
+ */
+int cbfs_find_file(const struct firmware_image *image,
+		   const char *section_name, const char *cbfs_entry_name,
+		   struct firmware_section *file)
+{
+	const struct cbfs_index *index = cbfs_get_index(image, section_name);
+	const struct cbfs_entry *e;
+
+	memset(file, 0, sizeof(*file));
+	e = index ? cbfs_find_entry(index, cbfs_entry_name) : NULL;
+	if (!e)
+		return -1;
+	if (e->compression) {
+		VB2_DEBUG("%s in %s is compressed (%u).\n", cbfs_entry_name,
+			  section_name, e->compression);
+		return 1;
+	}
+	file->data = e->data;
+	file->size = e->size;
+	return 0;
 }
 
 /*
@@ -122,6 +317,45 @@ const char *cbfs_extract_file(const char *image_file,
 	return output;
 }
 
+/*
+ * Reads a file inside a particular CBFS section of a loaded firmware image
+ * into a new NUL-terminated buffer (*data, to be freed by caller), like
+ * vb2_read_file. Only compressed files need cbfstool, with a temporary copy
+ * of the image.
+ * Returns 0 on success, otherwise non-zero.
+ */
+int cbfs_read_file(const struct firmware_image *image,
+		   const char *section_name, const char *cbfs_entry_name,
+		   uint8_t **data, uint32_t *size, struct tempfile *tempfiles)
+{
+	struct firmware_section file;
+	const char *path;
+	int r;
+
+	*data = NULL;
+	*size = 0;
+	r = cbfs_find_file(image, section_name, cbfs_entry_name, &file);
+	if (r < 0)
+		return r;
+	if (r == 0) {
+		*data = (uint8_t *)malloc(file.size + 1);
+		if (!*data)
+			return -1;
+		memcpy(*data, file.data, file.size);
+		(*data)[file.size] = '\0';
+		*size = file.size;
+		return 0;
+	}
+
+	path = get_firmware_image_temp_file(image, tempfiles);
+	if (path)
+		path = cbfs_extract_file(path, section_name, cbfs_entry_name,
+					 tempfiles);
+	if (!path || vb2_read_file(path, data, size) != VB2_SUCCESS)
+		return -1;
+	return 0;
+}
+
 /*
  * Loads the firmware information from an FMAP section in loaded firmware image.
  * The section should only contain ASCIIZ string as firmware version.
@@ -204,7 +438,8 @@ static int parse_firmware_image(struct firmware_image *image)
 /*
  * Loads a firmware image from file.
  * If archive is provided and file_name is a relative path, read the file from
- * archive.
+ * archive. Plain files are mapped (copy-on-write) instead of being copied into
+ * memory, so only the sections modified later will take extra memory.
  * Returns IMAGE_LOAD_SUCCESS on success, IMAGE_READ_FAILURE on file I/O
  * failure, or IMAGE_PARSE_FAILURE for non-vboot images.
  */
@@ -222,8 +457,11 @@ int load_firmware_image(struct firmware_image *image, const char *file_name,
 		ERROR("Does not exist: %s\n", file_name);
 		return IMAGE_READ_FAILURE;
 	}
-	if (archive_read_file(archive, file_name, &image->data, &image->size,
-			      NULL) != VB2_SUCCESS) {
+	if (archive_map_file(archive, file_name, &image->data,
+			     &image->size) == 0) {
+		image->is_mapped = 1;
+	} else if (archive_read_file(archive, file_name, &image->data,
+				     &image->size, NULL) != VB2_SUCCESS) {
 		ERROR("Failed to load %s\n", file_name);
 		return IMAGE_READ_FAILURE;
 	}
@@ -265,7 +503,11 @@ void free_firmware_image(struct firmware_image *image)
 	 */
 	const char *programmer = image->programmer;
 
-	free(image->data);
+	cbfs_free_indexes(image);
+	if (image->is_mapped)
+		archive_unmap_file(image->data, image->size);
+	else
+		free(image->data);
 	free(image->file_name);
 	free(image->ro_version);
 	free(image->rw_version_a);
@@ -274,6 +516,35 @@ void free_firmware_image(struct firmware_image *image)
 	image->programmer = programmer;
 }
 
+/*
+ * Copies the data of a mapped firmware image into memory, so the file it was
+ * mapped from can be rewritten. Returns 0 on success, otherwise non-zero.
+ */
+int unmap_firmware_image(struct firmware_image *image)
+{
+	uint8_t *data;
+
+	if (!image->is_mapped)
+		return 0;
+
+	data = (uint8_t *)malloc(image->size);
+	if (!data) {
+		ERROR("Failed to allocate %u bytes for %s.\n", image->size,
+		      image->file_name);
+		return -1;
+	}
+	memcpy(data, image->data, image->size);
+	/* The FMAP header and CBFS indexes point into the old data. */
+	cbfs_free_indexes(image);
+	if (image->fmap_header)
+		image->fmap_header = (FmapHeader *)(
+			data + ((uint8_t *)image->fmap_header - image->data));
+	archive_unmap_file(image->data, image->size);
+	image->data = data;
+	image->is_mapped = 0;
+	return 0;
+}
+
 /*
  * Finds a firmware section by given name in the firmware image.
  * If successful, return zero and *section argument contains the address and
@@ -336,6 +607,8 @@ int preserve_firmware_section(const struct firmware_image *image_from,
 	}
 	/* Use memmove in case if we need to deal with sections that overlap. */
 	memmove(to.data, from.data, VB2_MIN(from.size, to.size));
+	/* The section may be a CBFS. */
+	cbfs_free_indexes(image_to);
 	return 0;
 }
 
@@ -622,14 +895,17 @@ static int emulate_write_firmware(const char *filename,
 				  const struct firmware_image *image,
 				  const char * const sections[])
 {
-	int i, errorcnt = 0;
+	int i, fd, errorcnt = 0;
 	struct firmware_image to_image = {0};
 
 	INFO("Writing from %s to %s (emu=%s).\n",
 	     image->file_name, image->programmer, filename);
 
-	if (load_firmware_image(&to_image, filename, NULL)) {
+	/* The file is rewritten below, so it can't stay mapped. */
+	if (load_firmware_image(&to_image, filename, NULL) ||
+	    unmap_firmware_image(&to_image)) {
 		ERROR("Cannot load image from %s.\n", filename);
+		free_firmware_image(&to_image);
 		return -1;
 	}
 
@@ -658,10 +934,20 @@ static int emulate_write_firmware(const char *filename,
 		}
 	}
 
-	if (vb2_write_file(filename, to_image.data, to_image.size)) {
+	/*
+	 * Rewrite the file in place (the size is unchanged), like the flash,
+	 * keeping symbolic links and the file mode. Images of the file must
+	 * have been unmapped by unmap_firmware_image.
+	 */
+	fd = open(filename, O_WRONLY);
+	if (fd < 0 ||
+	    pwrite(fd, to_image.data, to_image.size, 0) != to_image.size) {
+		ERROR("Failed writing to file: %s\n", filename);
+		errorcnt++;
+	}
+	if (fd >= 0 && close(fd)) {
 		ERROR("Failed writing to file: %s\n", filename);
 		errorcnt++;
-		goto exit;
 	}
 
 exit:
@@ -720,6 +1006,14 @@ static int external_flashrom(enum flash_command flash_cmd,
 static int read_flash(struct flashrom_params *params,
 		      struct updater_config *cfg)
 {
+	if (cfg->emulation) {
+		if (vb2_read_file(cfg->emulation, &params->image->data,
+				  &params->image->size)) {
+			ERROR("Failed to read %s.\n", cfg->emulation);
+			return -1;
+		}
+		return 0;
+	}
 	if (get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg))
 		return external_flashrom(FLASH_READ, params, &cfg->tempfiles);
 
@@ -747,6 +1041,151 @@ static int write_flash(struct flashrom_params *params,
 	return r;
 }
 
+/* A read of the system firmware running in a child process. */
+struct system_firmware_prefetch {
+	pid_t pid;
+	const char *path;  /* Where the child saves the image. */
+	const char *log;  /* Where the child's stdout and stderr go. */
+	int external_flashrom;  /* QUIRK_EXTERNAL_FLASHROM used by the child. */
+	uint64_t start;
+	int done, success;
+};
+
+/*
+ * Starts reading the system (host) firmware in a child process, so the slow
+ * flash read overlaps with loading the archive, manifest and target images.
+ * The result is picked up by load_system_firmware for cfg->image_current,
+ * and anything the read prints is held until then. With cfg->emulation set,
+ * the emulation file is read instead of the flash.
+ * Returns 0 if started, otherwise non-zero (the image will be read when
+ * needed).
+ */
+int prefetch_system_firmware(struct updater_config *cfg)
+{
+	struct system_firmware_prefetch *p;
+	struct firmware_image image = {
+		.programmer = cfg->image_current.programmer,
+	};
+	struct flashrom_params params = {
+		.image = &image,
+		.verbose = cfg->verbosity + 1,
+	};
+	const char *path, *log;
+	char *cmd;
+	int r, fd;
+
+	assert(!cfg->prefetch && !cfg->image_current.data);
+	path = create_temp_file(&cfg->tempfiles);
+	log = create_temp_file(&cfg->tempfiles);
+	if (!path || !log)
+		return -1;
+	p = (struct system_firmware_prefetch *)calloc(1, sizeof(*p));
+	if (!p)
+		return -1;
+	p->path = path;
+	p->log = log;
+	p->external_flashrom = get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg);
+	p->start = updater_timing_now();
+
+	cmd = get_flashrom_command(FLASH_READ, &params, NULL, NULL);
+	INFO("%s &\n", cmd);
+	free(cmd);
+
+	/* Don't let the child flush what the parent has buffered. */
+	fflush(NULL);
+	p->pid = fork();
+	if (p->pid < 0) {
+		ERROR("Failed to start reading system firmware: %s\n",
+		      strerror(errno));
+		free(p);
+		return -1;
+	}
+	if (!p->pid) {
+		/*
+		 * Keep flashrom output from interleaving with the parent's;
+		 * it is replayed when the parent collects the image.
+		 */
+		fd = open(log, O_WRONLY | O_TRUNC);
+		if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0 ||
+		    dup2(fd, STDERR_FILENO) < 0)
+			_exit(1);
+		close(fd);
+		/* The temp files so far belong to the parent. */
+		cfg->tempfiles.next = NULL;
+		r = read_flash(&params, cfg);
+		if (!r)
+			r = vb2_write_file(path, image.data, image.size);
+		remove_all_temp_files(&cfg->tempfiles);
+		fflush(NULL);
+		_exit(r ? 1 : 0);
+	}
+
+	VB2_DEBUG("Reading system firmware in process %d.\n", (int)p->pid);
+	cfg->prefetch = p;
+	return 0;
+}
+
+/*
+ * Waits for the system firmware prefetch (if any) to finish. This must be done
+ * before using flashrom, which can't access the flash from two processes.
+ */
+void wait_system_firmware_prefetch(struct updater_config *cfg)
+{
+	struct system_firmware_prefetch *p = cfg->prefetch;
+	uint8_t *output;
+	uint32_t output_size;
+	int status;
+	pid_t r;
+
+	if (!p || p->done)
+		return;
+	do {
+		r = waitpid(p->pid, &status, 0);
+	} while (r < 0 && errno == EINTR);
+	p->done = 1;
+	p->success = (r == p->pid && WIFEXITED(status) &&
+		      WEXITSTATUS(status) == 0);
+
+	/* Replay what the child printed, now that it is in order. */
+	if (vb2_read_file(p->log, &output, &output_size) == VB2_SUCCESS) {
+		fflush(stdout);
+		fwrite(output, 1, output_size, stderr);
+		free(output);
+	}
+	VB2_DEBUG("Reading system firmware %s.\n",
+		  p->success ? "finished" : "failed");
+}
+
+/*
+ * Takes the result of system firmware prefetch into image.
+ * Returns IMAGE_LOAD_SUCCESS or IMAGE_PARSE_FAILURE if the image was loaded,
+ * otherwise IMAGE_READ_FAILURE and the image should be read again.
+ */
+static int take_system_firmware_prefetch(struct updater_config *cfg,
+					 struct firmware_image *image)
+{
+	struct system_firmware_prefetch *p = cfg->prefetch;
+	int r = IMAGE_READ_FAILURE;
+
+	wait_system_firmware_prefetch(cfg);
+	cfg->prefetch = NULL;
+
+	/* Quirks loaded from the target image may change how to read. */
+	if (p->success && p->external_flashrom ==
+	    get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg))
+		r = load_firmware_image(image, p->path, NULL);
+	if (r != IMAGE_READ_FAILURE) {
+		if (!p->external_flashrom) {
+			free(image->file_name);
+			image->file_name = strdup("<sys-flash>");
+		}
+		updater_timing_record(cfg, STAGE_FLASH_READ, p->start,
+				      image->size);
+	}
+	free(p);
+	return r;
+}
+
 /*
  * Loads the active system firmware image (usually from SPI flash chip).
  * Returns 0 if success, non-zero if error.
@@ -758,6 +1197,15 @@ int load_system_firmware(struct updater_config *cfg,
 	char *cmd;
 	const int tries = 1 + get_config_quirk(QUIRK_EXTRA_RETRIES, cfg);
 	struct flashrom_params params = {0};
+	uint64_t start;
+
+	if (cfg->prefetch && image == &cfg->image_current) {
+		r = take_system_firmware_prefetch(cfg, image);
+		if (r != IMAGE_READ_FAILURE)
+			return r;
+		free_firmware_image(image);
+	}
+	wait_system_firmware_prefetch(cfg);
 
 	params.image = image;
 	params.verbose = cfg->verbosity + 1; /* libflashrom verbose 1 = WARN. */
@@ -766,16 +1214,115 @@ int load_system_firmware(struct updater_config *cfg,
 	INFO("%s\n", cmd);
 	free(cmd);
 
+	start = updater_timing_now();
 	for (i = 1, r = -1; i <= tries && r != 0; i++, params.verbose++) {
 		if (i > 1)
 			WARN("Retry reading firmware (%d/%d)...\n", i, tries);
 		r = read_flash(&params, cfg);
 	}
+	updater_timing_record(cfg, STAGE_FLASH_READ, start, image->size);
 	if (!r)
 		r = parse_firmware_image(image);
 	return r;
 }
 
+/*
+ * Reads ranges of the emulation file one at a time, like
+ * flashrom_read_ranges does from the flash.
+ * Returns 0 on success, otherwise non-zero.
+ */
+static int emulate_read_ranges(const char *file_name,
+			       const struct flashrom_range *ranges, int count,
+			       flashrom_range_cb *cb, void *ctx)
+{
+	uint32_t max_size = 0;
+	uint8_t *buf;
+	int fd, i, r = 0;
+
+	for (i = 0; i < count; i++)
+		max_size = VB2_MAX(max_size, ranges[i].size);
+	buf = (uint8_t *)malloc(max_size);
+	if (!buf)
+		return -1;
+
+	fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		ERROR("Cannot open %s: %s\n", file_name, strerror(errno));
+		free(buf);
+		return -1;
+	}
+	for (i = 0; i < count && !r; i++) {
+		if (pread(fd, buf, ranges[i].size, ranges[i].offset) !=
+		    ranges[i].size) {
+			ERROR("Cannot read %#x+%#x from %s.\n",
+			      ranges[i].offset, ranges[i].size, file_name);
+			r = -1;
+			break;
+		}
+		r = cb(ctx, i, buf);
+	}
+	close(fd);
+	free(buf);
+	return r;
+}
+
+/* State of verify_written_chunks, for each chunk read back. */
+struct verify_context {
+	const struct flash_verify_chunk *chunks;
+	int errorcnt;
+};
+
+static int verify_chunk_cb(void *ctx, int index, const uint8_t *data)
+{
+	struct verify_context *v = (struct verify_context *)ctx;
+
+	v->errorcnt += verify_flash_chunk(&v->chunks[index], data);
+	return 0;
+}
+
+/*
+ * Reads back the written chunks from the system firmware (or the emulation
+ * file) one at a time, and verifies them by their digests.
+ * Returns 0 if all chunks match, otherwise non-zero.
+ */
+static int verify_written_chunks(struct updater_config *cfg,
+				 const struct firmware_image *image,
+				 const struct flash_verify_chunk *chunks,
+				 int count)
+{
+	struct verify_context v = {.chunks = chunks};
+	struct flashrom_range *ranges;
+	uint64_t start = updater_timing_now(), bytes = 0;
+	int i, r;
+
+	ranges = (struct flashrom_range *)calloc(count, sizeof(*ranges));
+	if (!ranges)
+		return -1;
+	for (i = 0; i < count; i++) {
+		ranges[i].offset = chunks[i].offset;
+		ranges[i].size = chunks[i].size;
+		bytes += chunks[i].size;
+	}
+
+	if (cfg->emulation)
+		r = emulate_read_ranges(cfg->emulation, ranges, count,
+					verify_chunk_cb, &v);
+	else
+		r = flashrom_read_ranges(image->programmer, ranges, count,
+					 verify_chunk_cb, &v,
+					 cfg->verbosity + 1);
+	free(ranges);
+	updater_timing_record(cfg, STAGE_VERIFY, start, bytes);
+
+	if (r) {
+		ERROR("Failed to read back the written data.\n");
+		return r;
+	}
+	if (!v.errorcnt)
+		INFO("Verified %ju bytes.\n", (uintmax_t)bytes);
+	return v.errorcnt;
+}
+
 /*
  * Writes sections from a given firmware image to the system firmware.
  * Regions should be NULL for writing the whole image, or a list of
@@ -791,9 +1338,76 @@ int write_system_firmware(struct updater_config *cfg,
 	const int tries = 1 + get_config_quirk(QUIRK_EXTRA_RETRIES, cfg);
 	struct flashrom_params params = {0};
 	struct firmware_image *flash_contents = NULL;
+	struct flash_write_plan plan;
+	struct flash_verify_chunk *chunks = NULL;
+	int has_plan = 0, num_chunks = 0;
+	uint32_t write_bytes = image->size;
+	uint64_t start;
 
-	if (cfg->emulation)
-		return emulate_write_firmware(cfg->emulation, image, sections);
+	/*
+	 * If we know what is on the flash, skip writing when nothing has
+	 * changed, and keep the known contents in sync after writing.
+	 */
+	start = updater_timing_now();
+	if (cfg->image_current.data &&
+	    is_the_same_programmer(&cfg->image_current, image) &&
+	    plan_flash_write(&plan, &cfg->image_current, image, sections,
+			     FLASH_ERASE_BLOCK_SIZE) == 0) {
+		has_plan = 1;
+		write_bytes = plan.bytes_changed;
+		updater_timing_record(cfg, STAGE_COMPARE, start,
+				      plan.bytes_total);
+		updater_timing_add_plan(cfg, &plan);
+		INFO("Changes: %d range(s), %u of %u bytes, erase %u blocks, "
+		     "write %u bytes (about %u ms).\n", plan.num_ranges,
+		     plan.bytes_changed, plan.bytes_total,
+		     plan.blocks_erased, plan.bytes_written,
+		     estimate_flash_write_ms(&plan, &cfg->flash_speed));
+		for (i = 0; i < plan.num_ranges; i++)
+			VB2_DEBUG(" - %s %#x+%#x\n",
+				  plan.ranges[i].erase ? "erase+write" : "write",
+				  plan.ranges[i].offset, plan.ranges[i].size);
+		if (!plan.num_ranges) {
+			INFO("No changes on flash, skip writing.\n");
+			free_flash_write_plan(&plan);
+			return 0;
+		}
+	}
+
+	/*
+	 * With a plan, only the erase blocks it writes need to be read back,
+	 * in chunks compared by digests calculated before writing, instead of
+	 * flashrom reading back whole sections.
+	 */
+	if (has_plan && cfg->verify_written && !cfg->dry_run &&
+	    !get_config_quirk(QUIRK_EXTERNAL_FLASHROM, cfg)) {
+		num_chunks = plan_flash_verify(&chunks, &plan,
+					       &cfg->image_current, image,
+					       FLASH_VERIFY_CHUNK_SIZE);
+		if (num_chunks <= 0) {
+			num_chunks = 0;
+			chunks = NULL;
+		}
+	}
+
+	start = updater_timing_now();
+	if (cfg->dry_run) {
+		INFO("(dry run) Skip writing %s.\n", image->programmer);
+		r = 0;
+		updater_timing_record(cfg, STAGE_FLASH_WRITE, start,
+				      write_bytes);
+		goto exit;
+	}
+	if (cfg->emulation) {
+		r = emulate_write_firmware(cfg->emulation, image, sections);
+		updater_timing_record(cfg, STAGE_FLASH_WRITE, start,
+				      write_bytes);
+		if (!r && chunks)
+			r = verify_written_chunks(cfg, image, chunks,
+						  num_chunks);
+		goto exit;
+	}
+	wait_system_firmware_prefetch(cfg);
 
 	if (cfg->use_diff_image && cfg->image_current.data &&
 	    is_the_same_programmer(&cfg->image_current, image))
@@ -802,7 +1416,8 @@ int write_system_firmware(struct updater_config *cfg,
 	params.image = (struct firmware_image *)image;
 	params.flash_contents = flash_contents;
 	params.regions = sections;
-	params.noverify = !cfg->do_verify;
+	/* The written blocks are verified by the updater. */
+	params.noverify = !cfg->do_verify || chunks;
 	params.noverify_all = true;
 	params.verbose = cfg->verbosity + 1; /* libflashrom verbose 1 = WARN. */
 
@@ -813,8 +1428,23 @@ int write_system_firmware(struct updater_config *cfg,
 	for (i = 1, r = -1; i <= tries && r != 0; i++, params.verbose++) {
 		if (i > 1)
 			WARN("Retry writing firmware (%d/%d)...\n", i, tries);
+		start = updater_timing_now();
 		r = write_flash(&params, cfg);
+		updater_timing_record(cfg, STAGE_FLASH_WRITE, start,
+				      write_bytes);
+		if (!r && chunks)
+			r = verify_written_chunks(cfg, image, chunks,
+						  num_chunks);
+	}
+
+exit:
+	if (has_plan) {
+		if (!r)
+			apply_flash_write_plan(&plan, &cfg->image_current,
+					       image);
+		free_flash_write_plan(&plan);
 	}
+	free(chunks);
 	return r;
 }
 
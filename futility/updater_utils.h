@@ -10,6 +10,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include "2sha.h"
 #include "fmap.h"
 
 #define ASPRINTF(strp, ...) do { if (asprintf(strp, __VA_ARGS__) >= 0) break; \
@@ -101,9 +102,32 @@ struct updater_config;
 int load_system_firmware(struct updater_config *cfg,
 			 struct firmware_image *image);
 
+/*
+ * Starts reading the system (host) firmware in a child process, so the slow
+ * flash read overlaps with loading the archive, manifest and target images.
+ * The result is picked up by load_system_firmware for cfg->image_current,
+ * and anything the read prints is held until then. With cfg->emulation set,
+ * the emulation file is read instead of the flash.
+ * Returns 0 if started, otherwise non-zero (the image will be read when
+ * needed).
+ */
+int prefetch_system_firmware(struct updater_config *cfg);
+
+/*
+ * Waits for the system firmware prefetch (if any) to finish. This must be done
+ * before using flashrom, which can't access the flash from two processes.
+ */
+void wait_system_firmware_prefetch(struct updater_config *cfg);
+
 /* Frees the allocated resource from a firmware image object. */
 void free_firmware_image(struct firmware_image *image);
 
+/*
+ * Copies the data of a mapped firmware image into memory, so the file it was
+ * mapped from can be rewritten. Returns 0 on success, otherwise non-zero.
+ */
+int unmap_firmware_image(struct firmware_image *image);
+
 /*
  * Generates a temporary file for snapshot of firmware image contents.
  *
@@ -122,6 +146,95 @@ int write_system_firmware(struct updater_config *cfg,
 			  const struct firmware_image *image,
 			  const char * const sections[]);
 
+/* Erase block size of SPI flash (sector erase) used for planning writes. */
+#define FLASH_ERASE_BLOCK_SIZE 0x1000
+/* Size of the flash read back at a time, to verify what was written. */
+#define FLASH_VERIFY_CHUNK_SIZE (16 * FLASH_ERASE_BLOCK_SIZE)
+/* Typical SPI flash speeds (KiB/s), for estimating the time to update. */
+#define FLASH_ERASE_KBPS 100
+#define FLASH_WRITE_KBPS 1024
+
+struct flash_speed {
+	uint32_t erase_kbps;
+	uint32_t write_kbps;
+};
+
+struct flash_range {
+	uint32_t offset;
+	uint32_t size;
+	int erase;  /* Erase blocks before writing. */
+};
+
+struct flash_write_plan {
+	uint32_t block_size;
+	struct flash_range *ranges;
+	int num_ranges;
+	uint32_t bytes_total;  /* Size of all sections to write. */
+	uint32_t bytes_changed;  /* Size of all ranges. */
+	uint32_t blocks_erased;
+	uint32_t bytes_written;
+};
+
+/* A part of the flash to read back after writing. */
+struct flash_verify_chunk {
+	uint32_t offset;
+	uint32_t size;
+	struct vb2_hash digest;  /* Of the contents it should have. */
+};
+
+/*
+ * Plans the erase and write operations needed to change the sections of
+ * image_from (usually what is on the flash) into the ones in image_to, in
+ * erase blocks of block_size bytes. Sections should be NULL for the whole
+ * image, or a NULL terminated list of FMAP section names.
+ * The ranges are ordered by offset and limited to the sections.
+ * Returns 0 on success (plan must be released by free_flash_write_plan),
+ * otherwise non-zero if the images can't be compared.
+ */
+int plan_flash_write(struct flash_write_plan *plan,
+		     const struct firmware_image *image_from,
+		     const struct firmware_image *image_to,
+		     const char * const sections[], uint32_t block_size);
+
+/*
+ * Estimates the time (in milliseconds) for the flash operations in a plan,
+ * on a flash with given speed.
+ */
+uint32_t estimate_flash_write_ms(const struct flash_write_plan *plan,
+				 const struct flash_speed *speed);
+
+/*
+ * Copies the ranges in a plan from image_to to image_from, for example to keep
+ * image_from in sync with the flash after the plan was written.
+ */
+void apply_flash_write_plan(const struct flash_write_plan *plan,
+			    struct firmware_image *image_from,
+			    const struct firmware_image *image_to);
+
+/*
+ * Splits the erase blocks written by a plan into chunks of at most chunk_size
+ * bytes (a multiple of the block size) to read back after writing, and
+ * calculates the digest each chunk should have, from image_from (what is on
+ * the flash) and image_to.
+ * Returns the number of chunks (*chunks must be freed by caller), or -1 on
+ * failure.
+ */
+int plan_flash_verify(struct flash_verify_chunk **chunks,
+		      const struct flash_write_plan *plan,
+		      const struct firmware_image *image_from,
+		      const struct firmware_image *image_to,
+		      uint32_t chunk_size);
+
+/*
+ * Verifies a chunk read back from the flash against its digest.
+ * Returns 0 if it matches, otherwise 1 (reported as an error).
+ */
+int verify_flash_chunk(const struct flash_verify_chunk *chunk,
+		       const uint8_t *data);
+
+/* Frees the resources allocated by plan_flash_write. */
+void free_flash_write_plan(struct flash_write_plan *plan);
+
 struct firmware_section {
 	uint8_t *data;
 	size_t size;
@@ -202,14 +315,72 @@ enum wp_state flashrom_get_wp(const char *programmer);
  */
 char *host_detect_servo(const char **prepare_ctrl_name);
 
+/* A file in CBFS, pointing into the loaded firmware image. */
+struct cbfs_entry {
+	const char *name;
+	uint32_t type;
+	uint32_t compression;  /* 0 if not compressed. */
+	uint8_t *data;
+	uint32_t size;
+};
+
+struct cbfs_index {
+	struct cbfs_entry *entries;
+	int num_entries;
+};
+
+/*
+ * Builds an index of the files in the CBFS of an FMAP section, by walking the
+ * file headers in the loaded image. Entries point into the image, so the
+ * index must not be used after the image is changed or freed.
+ * Returns 0 on success (index must be released by cbfs_free_index),
+ * otherwise non-zero.
+ */
+int cbfs_load_index(struct cbfs_index *index,
+		    const struct firmware_image *image,
+		    const char *section_name);
+
+/*
+ * Returns the entry of a file with given name in a CBFS index,
+ * or NULL if not found.
+ */
+const struct cbfs_entry *cbfs_find_entry(const struct cbfs_index *index,
+					 const char *name);
+
+/* Frees the resources allocated by cbfs_load_index. */
+void cbfs_free_index(struct cbfs_index *index);
+
+/*
+ * Returns the index of the CBFS in an FMAP section, loading it on first use
+ * and keeping it with the image, or NULL if the section is missing.
+ */
+const struct cbfs_index *cbfs_get_index(const struct firmware_image *image,
+					const char *section_name);
+
+/*
+ * Frees the CBFS indexes kept with an image. Must be called when a CBFS
+ * section of the loaded image is changed.
+ */
+void cbfs_free_indexes(struct firmware_image *image);
+
 /*
  * Returns 1 if a given file (cbfs_entry_name) exists inside a particular CBFS
- * section of an image file, otherwise 0.
+ * section of a loaded firmware image, otherwise 0.
  */
-int cbfs_file_exists(const char *image_file,
+int cbfs_file_exists(const struct firmware_image *image,
 		     const char *section_name,
 		     const char *cbfs_entry_name);
 
+/*
+ * Finds the contents of a file inside a particular CBFS section of a loaded
+ * firmware image, without copying. file->data points into the image.
+ * Returns 0 on success, -1 if the file does not exist, or 1 if the file is
+ * compressed (and must be extracted by cbfs_extract_file).
+ */
+int cbfs_find_file(const struct firmware_image *image,
+		   const char *section_name, const char *cbfs_entry_name,
+		   struct firmware_section *file);
+
 /*
  * Extracts files from a CBFS on given region (section) of image_file.
  * Returns the path to a temporary file on success, otherwise NULL.
@@ -219,6 +390,17 @@ const char *cbfs_extract_file(const char *image_file,
 			      const char *cbfs_name,
 			      struct tempfile *tempfiles);
 
+/*
+ * Reads a file inside a particular CBFS section of a loaded firmware image
+ * into a new NUL-terminated buffer (*data, to be freed by caller), like
+ * vb2_read_file. Only compressed files need cbfstool, with a temporary copy
+ * of the image.
+ * Returns 0 on success, otherwise non-zero.
+ */
+int cbfs_read_file(const struct firmware_image *image,
+		   const char *section_name, const char *cbfs_entry_name,
+		   uint8_t **data, uint32_t *size, struct tempfile *tempfiles);
+
 /* Utilities for accessing system properties */
 struct system_property {
 	int (*getter)(void);
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <netinet/in.h>
 
+#include "2common.h"
 #include "crossystem_arch.h"
 #include "crossystem.h"
 #include "crossystem_vbnv.h"
@@ -425,6 +426,7 @@ static int vb2_write_nv_storage_disk(struct vb2_context *ctx)
 	return rv;
 }
 
+test_mockable
 int vb2_read_nv_storage(struct vb2_context *ctx)
 {
 	/* Default to disk for older firmware which does not provide storage
@@ -440,6 +442,7 @@ int vb2_read_nv_storage(struct vb2_context *ctx)
 	return -1;
 }
 
+test_mockable
 int vb2_write_nv_storage(struct vb2_context *ctx)
 {
 	/* Default to disk for older firmware which does not provide storage
@@ -455,6 +458,7 @@ int vb2_write_nv_storage(struct vb2_context *ctx)
 	return -1;
 }
 
+test_mockable
 VbSharedDataHeader *VbSharedDataRead(void)
 {
 	void *block = NULL;
@@ -5,6 +5,7 @@
 
 #include <string.h>
 
+#include "2common.h"
 #include "crossystem_arch.h"
 #include "crossystem.h"
 #include "host_common.h"
@@ -13,16 +14,19 @@
  * wherever possible. They will need real implementation as part of of MIPS
  * firmware bringup. */
 
+test_mockable
 int vb2_read_nv_storage(struct vb2_context *ctx)
 {
 	return -1;
 }
 
+test_mockable
 int vb2_write_nv_storage(struct vb2_context *ctx)
 {
 	return -1;
 }
 
+test_mockable
 VbSharedDataHeader *VbSharedDataRead(void)
 {
 	return NULL;
@@ -3,23 +3,27 @@
  * found in the LICENSE file.
  */
 
+#include "2common.h"
 #include "crossystem_arch.h"
 #include "crossystem.h"
 #include "crossystem_vbnv.h"
 #include "host_common.h"
 #include "vboot_struct.h"
 
+test_mockable
 int vb2_read_nv_storage(struct vb2_context *ctx)
 {
 	return -1;
 }
 
 
+test_mockable
 int vb2_write_nv_storage(struct vb2_context *ctx)
 {
 	return -1;
 }
 
+test_mockable
 VbSharedDataHeader* VbSharedDataRead(void)
 {
 	return NULL;
@@ -21,6 +21,7 @@
 #include <sys/utsname.h>
 #include <unistd.h>
 
+#include "2common.h"
 #include "crossystem_arch.h"
 #include "crossystem.h"
 #include "crossystem_vbnv.h"
@@ -157,6 +158,7 @@ static int VbCmosWrite(unsigned offs, size_t size, const void *ptr)
 }
 
 
+test_mockable
 int vb2_read_nv_storage(struct vb2_context *ctx)
 {
 	unsigned offs, blksz;
@@ -177,6 +179,7 @@ int vb2_read_nv_storage(struct vb2_context *ctx)
 }
 
 
+test_mockable
 int vb2_write_nv_storage(struct vb2_context *ctx)
 {
 	unsigned offs, blksz;
@@ -318,6 +321,7 @@ static uint8_t* VbGetBuffer(const char* filename, int* buffer_size)
 }
 
 
+test_mockable
 VbSharedDataHeader* VbSharedDataRead(void)
 {
 	VbSharedDataHeader* sh;
@@ -45,6 +45,26 @@ int VbSetSystemPropertyInt(const char* name, int value);
  * Returns 0 if success, -1 if error. */
 int VbSetSystemPropertyString(const char* name, const char* value);
 
+/* Drops the snapshot of firmware shared data (VbSharedData) and NV storage
+ * read by this process, so the next property access reads them again.
+ * Setting a property (or committing a batch) does this already, so it is
+ * needed only if they may have been changed by another process.  In a batch,
+ * the NV storage changed so far is kept. */
+void VbInvalidateSystemPropertyCache(void);
+
+/* Starts a batch of property changes.  Until VbCommitSystemPropertyBatch(),
+ * the crossystem lock is held, the NV storage is read only once, and sets
+ * only change the copy in memory, which later gets will return.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbBeginSystemPropertyBatch(void);
+
+/* Ends a batch of property changes, writing the NV storage once if any
+ * value was changed.
+ *
+ * Returns 0 if success, -1 if error. */
+int VbCommitSystemPropertyBatch(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -134,22 +134,42 @@ static struct vb2_context *get_fake_context(void)
 
 static int vnc_read;
 
-int vb2_get_nv_storage(enum vb2_nv_param param)
+/* Lock held by VbBeginSystemPropertyBatch(), or -1 if not in a batch. */
+static int batch_lock_fd = -1;
+
+/* VbSharedData snapshot, read once until VbInvalidateSystemPropertyCache(). */
+static VbSharedDataHeader *vdat_cache;
+static int vdat_cache_read;
+
+/* Returns the cached VbSharedData (must not be freed), or NULL if error. */
+static VbSharedDataHeader *GetVdat(void)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
-	struct vb2_context *ctx = get_fake_context();
+	if (!vdat_cache_read) {
+		vdat_cache = VbSharedDataRead();
+		vdat_cache_read = 1;
+	}
+	return vdat_cache;
+}
 
-	if (!sh)
-		return -1;
+void VbInvalidateSystemPropertyCache(void)
+{
+	free(vdat_cache);
+	vdat_cache = NULL;
+	vdat_cache_read = 0;
+	/* NV data changed in a batch is kept until it is committed. */
+	if (batch_lock_fd < 0)
+		vnc_read = 0;
+}
 
+/* Reads the NV storage into the fake context, if not read yet. */
+static int ReadNvStorageOnce(VbSharedDataHeader *sh, struct vb2_context *ctx)
+{
 	/* TODO: locking around NV access */
 	if (!vnc_read) {
 		if (sh && sh->flags & VBSD_NVDATA_V2)
 			ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-		if (0 != vb2_read_nv_storage(ctx)) {
-			free(sh);
+		if (0 != vb2_read_nv_storage(ctx))
 			return -1;
-		}
 		vb2_nv_init(ctx);
 
 		/* TODO: If vnc.raw_changed, attempt to reopen NVRAM for write
@@ -157,39 +177,54 @@ int vb2_get_nv_storage(enum vb2_nv_param param)
 
 		vnc_read = 1;
 	}
+	return 0;
+}
+
+int vb2_get_nv_storage(enum vb2_nv_param param)
+{
+	VbSharedDataHeader* sh = GetVdat();
+	struct vb2_context *ctx = get_fake_context();
+
+	if (!sh)
+		return -1;
+
+	if (0 != ReadNvStorageOnce(sh, ctx))
+		return -1;
 
-	free(sh);
 	return (int)vb2_nv_get(ctx, param);
 }
 
 int vb2_set_nv_storage(enum vb2_nv_param param, int value)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader* sh = GetVdat();
 	struct vb2_context *ctx = get_fake_context();
 
 	if (!sh)
 		return -1;
 
+	/* In a batch, change the NV data read once and write it on commit. */
+	if (batch_lock_fd >= 0) {
+		if (0 != ReadNvStorageOnce(sh, ctx))
+			return -1;
+		vb2_nv_set(ctx, param, (uint32_t)value);
+		return 0;
+	}
+
 	/* TODO: locking around NV access */
 	if (sh && sh->flags & VBSD_NVDATA_V2)
 		ctx->flags |= VB2_CONTEXT_NVDATA_V2;
-	if (0 != vb2_read_nv_storage(ctx)) {
-		free(sh);
+	if (0 != vb2_read_nv_storage(ctx))
 		return -1;
-	}
 	vb2_nv_init(ctx);
 	vb2_nv_set(ctx, param, (uint32_t)value);
 
 	if (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED) {
 		vnc_read = 0;
-		if (0 != vb2_write_nv_storage(ctx)) {
-			free(sh);
+		if (0 != vb2_write_nv_storage(ctx))
 			return -1;
-		}
 	}
 
 	/* Success */
-	free(sh);
 	return 0;
 }
 
@@ -280,7 +315,7 @@ static char *GetVdatLoadFirmwareDebug(char *dest, int size,
 
 static char *GetVdatString(char *dest, int size, VdatStringField field)
 {
-	VbSharedDataHeader *sh = VbSharedDataRead();
+	VbSharedDataHeader *sh = GetVdat();
 	char *value = dest;
 
 	if (!sh)
@@ -312,13 +347,12 @@ static char *GetVdatString(char *dest, int size, VdatStringField field)
 			break;
 	}
 
-	free(sh);
 	return value;
 }
 
 static int GetVdatInt(VdatIntField field)
 {
-	VbSharedDataHeader* sh = VbSharedDataRead();
+	VbSharedDataHeader* sh = GetVdat();
 	int value = -1;
 
 	if (!sh)
@@ -374,7 +408,6 @@ static int GetVdatInt(VdatIntField field)
 		}
 	}
 
-	free(sh);
 	return value;
 }
 
@@ -696,11 +729,15 @@ int VbSetSystemPropertyInt(const char *name, int value)
 	int result = -1;
 	int lock_fd;
 
+	if (batch_lock_fd >= 0)
+		return VbSetSystemPropertyIntInternal(name, value);
+
 	lock_fd = AcquireCrossystemLock();
 	if (lock_fd < 0)
 		return -1;
 
 	result = VbSetSystemPropertyIntInternal(name, value);
+	VbInvalidateSystemPropertyCache();
 
 	if (ReleaseCrossystemLock(lock_fd) < 0)
 		return -1;
@@ -766,11 +803,15 @@ int VbSetSystemPropertyString(const char *name, const char *value)
 	int result = -1;
 	int lock_fd;
 
+	if (batch_lock_fd >= 0)
+		return VbSetSystemPropertyStringInternal(name, value);
+
 	lock_fd = AcquireCrossystemLock();
 	if (lock_fd < 0)
 		return -1;
 
 	result = VbSetSystemPropertyStringInternal(name, value);
+	VbInvalidateSystemPropertyCache();
 
 	if (ReleaseCrossystemLock(lock_fd) < 0)
 		return -1;
@@ -778,6 +819,46 @@ int VbSetSystemPropertyString(const char *name, const char *value)
 	return result;
 }
 
+int VbBeginSystemPropertyBatch(void)
+{
+	int lock_fd;
+
+	if (batch_lock_fd >= 0)
+		return -1;
+
+	lock_fd = AcquireCrossystemLock();
+	if (lock_fd < 0)
+		return -1;
+
+	/* Read everything again now that no one else can change it. */
+	VbInvalidateSystemPropertyCache();
+	get_fake_context()->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
+	batch_lock_fd = lock_fd;
+	return 0;
+}
+
+int VbCommitSystemPropertyBatch(void)
+{
+	struct vb2_context *ctx = get_fake_context();
+	int result = 0;
+
+	if (batch_lock_fd < 0)
+		return -1;
+
+	if (vnc_read && (ctx->flags & VB2_CONTEXT_NVDATA_CHANGED)) {
+		if (0 != vb2_write_nv_storage(ctx))
+			result = -1;
+		ctx->flags &= ~VB2_CONTEXT_NVDATA_CHANGED;
+	}
+
+	if (ReleaseCrossystemLock(batch_lock_fd) < 0)
+		result = -1;
+	batch_lock_fd = -1;
+	VbInvalidateSystemPropertyCache();
+
+	return result;
+}
+
 /**
  * Get index of the last valid VBNV entry in an EEPROM.
  *
@@ -6,6 +6,7 @@
  */
 
 #include <libflashrom.h>
+#include <sys/mman.h>
 
 #include "2common.h"
 #include "crossystem.h"
@@ -118,6 +119,96 @@ err_init:
 	return r;
 }
 
+int flashrom_read_ranges(const char *programmer_str,
+			 const struct flashrom_range *ranges, int count,
+			 flashrom_range_cb *cb, void *ctx, int verbosity)
+{
+	int r = 0, i;
+	size_t len = 0;
+	uint8_t *buf = MAP_FAILED;
+
+	g_verbose_screen = (verbosity == -1) ? FLASHROM_MSG_INFO : verbosity;
+
+	char *programmer, *params;
+	char *tmp = flashrom_extract_params(programmer_str, &programmer, &params);
+
+	struct flashrom_programmer *prog = NULL;
+	struct flashrom_flashctx *flashctx = NULL;
+
+	flashrom_set_log_callback((flashrom_log_callback *)&flashrom_print_cb);
+
+	if (flashrom_init(1)
+		|| flashrom_programmer_init(&prog, programmer, params)) {
+		r = -1;
+		goto err_init;
+	}
+	if (flashrom_flash_probe(&flashctx, prog, NULL)) {
+		r = -1;
+		goto err_probe;
+	}
+
+	len = flashrom_flash_getsize(flashctx);
+	if (len == 0) {
+		ERROR("zero sized flash detected\n");
+		r = -1;
+		goto err_cleanup;
+	}
+
+	/*
+	 * libflashrom only reads into a buffer of the whole chip, so map one
+	 * and drop the pages of each range once it was handled. Only one
+	 * range is in memory at a time.
+	 */
+	buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		ERROR("could not allocate %zu bytes\n", len);
+		r = -1;
+		goto err_cleanup;
+	}
+
+	for (i = 0; i < count && !r; i++) {
+		const struct flashrom_range *range = &ranges[i];
+		struct flashrom_layout *layout = NULL;
+
+		if (!range->size || range->offset + range->size > len) {
+			ERROR("invalid range %#x+%#x\n", range->offset,
+			      range->size);
+			r = -1;
+			break;
+		}
+		if (flashrom_layout_new(&layout) ||
+		    flashrom_layout_add_region(layout, range->offset,
+					       range->offset + range->size - 1,
+					       "range") ||
+		    flashrom_layout_include_region(layout, "range")) {
+			ERROR("could not add range %#x+%#x\n", range->offset,
+			      range->size);
+			flashrom_layout_release(layout);
+			r = -1;
+			break;
+		}
+		flashrom_layout_set(flashctx, layout);
+		r = flashrom_image_read(flashctx, buf, len);
+		flashrom_layout_set(flashctx, NULL);
+		flashrom_layout_release(layout);
+		if (!r)
+			r = cb(ctx, i, buf + range->offset);
+		madvise(buf, len, MADV_DONTNEED);
+	}
+	munmap(buf, len);
+
+err_cleanup:
+	flashrom_flash_release(flashctx);
+
+err_probe:
+	r |= flashrom_programmer_shutdown(prog);
+
+err_init:
+	free(tmp);
+	return r;
+}
+
 int flashrom_write_image(const struct firmware_image *image,
 			const char * const regions[],
 			const struct firmware_image *diff_image,
@@ -0,0 +1,161 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Cache of unpacked public keys for host utilities.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "2common.h"
+#include "2packed_key.h"
+#include "2rsa.h"
+#include "2sha.h"
+#include "2sysincludes.h"
+#include "host_key_cache.h"
+
+struct key_cache_entry {
+	struct key_cache_entry *next;
+	/* Unpacked key; points into packed_key */
+	struct vb2_public_key key;
+	/* Private copy of the packed key; also what lookups compare */
+	struct vb2_packed_key *packed_key;
+	/* SHA-256 of keyblocks this key has verified */
+	uint8_t (*verified)[VB2_SHA256_DIGEST_SIZE];
+	int num_verified;
+};
+
+static struct key_cache_entry *key_cache;
+
+static struct key_cache_entry *find_entry_by_key(
+	const struct vb2_public_key *key)
+{
+	struct key_cache_entry *e;
+
+	for (e = key_cache; e; e = e->next)
+		if (&e->key == key)
+			return e;
+	return NULL;
+}
+
+vb2_error_t vb2_key_cache_unpack_buffer(const struct vb2_public_key **key,
+					const uint8_t *buf, uint32_t size)
+{
+	const struct vb2_packed_key *packed_key =
+		(const struct vb2_packed_key *)buf;
+	struct key_cache_entry *e;
+	uint32_t packed_size;
+	vb2_error_t rv;
+
+	VB2_TRY(vb2_verify_packed_key_inside(buf, size, packed_key));
+
+	/*
+	 * Compare the whole key data, not a digest of it; a hit skips all
+	 * later checks of the key, so it must really be the same key.
+	 */
+	for (e = key_cache; e; e = e->next) {
+		if (e->packed_key->algorithm == packed_key->algorithm &&
+		    e->packed_key->key_size == packed_key->key_size &&
+		    !memcmp(e->packed_key + 1, vb2_packed_key_data(packed_key),
+			    packed_key->key_size)) {
+			*key = &e->key;
+			return VB2_SUCCESS;
+		}
+	}
+
+	/* Copy header and data together, so the key is aligned and owned */
+	packed_size = sizeof(*packed_key) + packed_key->key_size;
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return VB2_ERROR_UNKNOWN;
+	e->packed_key = malloc(packed_size);
+	if (!e->packed_key) {
+		free(e);
+		return VB2_ERROR_UNKNOWN;
+	}
+	memcpy(e->packed_key, packed_key, sizeof(*packed_key));
+	memcpy(e->packed_key + 1, vb2_packed_key_data(packed_key),
+	       packed_key->key_size);
+	e->packed_key->key_offset = sizeof(*packed_key);
+
+	rv = vb2_unpack_key_buffer(&e->key, (const uint8_t *)e->packed_key,
+				   packed_size);
+	if (rv) {
+		free(e->packed_key);
+		free(e);
+		return rv;
+	}
+
+	e->next = key_cache;
+	key_cache = e;
+
+	*key = &e->key;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2_key_cache_unpack(const struct vb2_public_key **key,
+				 const struct vb2_packed_key *packed_key)
+{
+	if (!packed_key)
+		return VB2_ERROR_UNPACK_KEY_BUFFER;
+
+	return vb2_key_cache_unpack_buffer(key, (const uint8_t *)packed_key,
+					   packed_key->key_offset +
+					   packed_key->key_size);
+}
+
+vb2_error_t vb2_key_cache_verify_keyblock(struct vb2_keyblock *block,
+					  uint32_t size,
+					  const struct vb2_public_key *key,
+					  const struct vb2_workbuf *wb)
+{
+	struct key_cache_entry *e = find_entry_by_key(key);
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+	void *verified;
+	int i;
+
+	if (!e)
+		return vb2_verify_keyblock(block, size, key, wb);
+
+	/*
+	 * After the structure checks, everything the signature check depends
+	 * on (signed data and signature) lies inside keyblock_size.
+	 */
+	VB2_TRY(vb2_check_keyblock(block, size, &block->keyblock_signature));
+	VB2_TRY(vb2_digest_buffer((const uint8_t *)block,
+				  block->keyblock_size, VB2_HASH_SHA256,
+				  digest, sizeof(digest)));
+
+	for (i = 0; i < e->num_verified; i++) {
+		if (!memcmp(e->verified[i], digest, sizeof(digest))) {
+			VB2_DEBUG("Keyblock already verified with this key\n");
+			return VB2_SUCCESS;
+		}
+	}
+
+	VB2_TRY(vb2_verify_keyblock(block, size, key, wb));
+
+	/* Failing to remember the result only costs time later */
+	verified = realloc(e->verified,
+			   (e->num_verified + 1) * sizeof(*e->verified));
+	if (verified) {
+		e->verified = verified;
+		memcpy(e->verified[e->num_verified++], digest, sizeof(digest));
+	}
+
+	return VB2_SUCCESS;
+}
+
+void vb2_key_cache_clear(void)
+{
+	struct key_cache_entry *e;
+
+	while (key_cache) {
+		e = key_cache;
+		key_cache = e->next;
+		free(e->verified);
+		free(e->packed_key);
+		free(e);
+	}
+}
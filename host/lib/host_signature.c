@@ -9,8 +9,13 @@
 
 #include <openssl/rsa.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -22,6 +27,111 @@
 #include "host_common.h"
 #include "host_signature21.h"
 
+/* Extra argument telling a signer to speak the co-process protocol */
+#define COPROCESS_ARG "--coprocess"
+
+/* Word a co-process writes as soon as it starts, before any request */
+#define COPROCESS_HELLO 1
+
+/* Time to wait for the hello. Signers which ignore COPROCESS_ARG send none. */
+#define COPROCESS_HELLO_MS 2000
+
+/* Default time to wait for each co-process response */
+#define COPROCESS_TIMEOUT_MS 30000
+
+/* Time a stopped co-process gets to exit before it is killed */
+#define COPROCESS_EXIT_MS 1000
+
+struct signer_coprocess {
+	struct signer_coprocess *next;
+	char *external_signer;
+	char *pem_file;
+	pid_t pid;		/* 0 if the signer doesn't speak the protocol */
+	pid_t owner;		/* process which started the signer */
+	int to_fd;		/* signer's stdin */
+	int from_fd;		/* signer's stdout */
+	int lock_fd;		/* lock shared with forked processes */
+};
+
+static struct signer_coprocess *coprocesses;
+static int coprocess_enabled;
+static int coprocess_timeout_ms = COPROCESS_TIMEOUT_MS;
+
+/* Start [external_signer] with [pem_file] as an argument, preceded by
+ * COPROCESS_ARG if [coprocess] is non-zero. Its stdin and stdout are
+ * connected to pipes returned in [to_fd] and [from_fd]. Returns the pid of
+ * the signer, or -1 on error.
+ */
+static pid_t spawn_signer(const char *external_signer, const char *pem_file,
+			  int coprocess, int *to_fd, int *from_fd)
+{
+	int p_to_c[2], c_to_p[2];  /* pipe descriptors */
+	pid_t pid;
+
+	/* Need two pipes since we want to invoke the external_signer as
+	 * a co-process writing to its stdin and reading from its stdout. */
+	if (pipe(p_to_c) < 0) {
+		VB2_DEBUG("pipe() error\n");
+		return -1;
+	}
+	if (pipe(c_to_p) < 0) {
+		VB2_DEBUG("pipe() error\n");
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		return -1;
+	}
+	if ((pid = fork()) < 0) {
+		VB2_DEBUG("fork() error\n");
+		close(p_to_c[0]);
+		close(p_to_c[1]);
+		close(c_to_p[0]);
+		close(c_to_p[1]);
+		return -1;
+	} else if (pid > 0) {  /* Parent. */
+		/* Don't leak our ends into signers started later, or they
+		 * would keep this one from seeing EOF. */
+		fcntl(p_to_c[STDOUT_FILENO], F_SETFD, FD_CLOEXEC);
+		fcntl(c_to_p[STDIN_FILENO], F_SETFD, FD_CLOEXEC);
+		close(p_to_c[STDIN_FILENO]);
+		close(c_to_p[STDOUT_FILENO]);
+		*to_fd = p_to_c[STDOUT_FILENO];
+		*from_fd = c_to_p[STDIN_FILENO];
+		return pid;
+	}
+
+	/* Child. */
+	close(p_to_c[STDOUT_FILENO]);
+	close(c_to_p[STDIN_FILENO]);
+	/* Map the stdin to the first pipe (this pipe gets input
+	 * from the parent) */
+	if (STDIN_FILENO != p_to_c[STDIN_FILENO]) {
+		if (dup2(p_to_c[STDIN_FILENO], STDIN_FILENO) !=
+		    STDIN_FILENO) {
+			VB2_DEBUG("stdin dup2() failed\n");
+			_exit(127);
+		}
+		close(p_to_c[STDIN_FILENO]);
+	}
+	/* Map the stdout to the second pipe (this pipe sends back
+	 * signer output to the parent) */
+	if (STDOUT_FILENO != c_to_p[STDOUT_FILENO]) {
+		if (dup2(c_to_p[STDOUT_FILENO], STDOUT_FILENO) !=
+		    STDOUT_FILENO) {
+			VB2_DEBUG("stdout dup2() failed\n");
+			_exit(127);
+		}
+		close(c_to_p[STDOUT_FILENO]);
+	}
+	/* External signer is invoked here. */
+	if (coprocess)
+		execl(external_signer, external_signer, COPROCESS_ARG,
+		      pem_file, (char *)0);
+	else
+		execl(external_signer, external_signer, pem_file, (char *)0);
+	VB2_DEBUG("execl() of external signer failed\n");
+	_exit(127);
+}
+
 /* Invoke [external_signer] command with [pem_file] as an argument, contents of
  * [inbuf] passed redirected to stdin, and the stdout of the command is put
  * back into [outbuf].  Returns -1 on error, 0 on success.
@@ -31,7 +141,7 @@ static int sign_external(uint32_t size, const uint8_t *inbuf, uint8_t *outbuf,
 			 const char *external_signer)
 {
 	int rv = 0, n;
-	int p_to_c[2], c_to_p[2];  /* pipe descriptors */
+	int to_fd, from_fd;
 	pid_t pid;
 
 	VB2_DEBUG("Will invoke \"%s %s\" to perform signing.\n"
@@ -39,130 +149,448 @@ static int sign_external(uint32_t size, const uint8_t *inbuf, uint8_t *outbuf,
 		 "Output of the signer will be read from standard out.\n",
 		  external_signer, pem_file);
 
-	/* Need two pipes since we want to invoke the external_signer as
-	 * a co-process writing to its stdin and reading from its stdout. */
-	if (pipe(p_to_c) < 0 || pipe(c_to_p) < 0) {
-		VB2_DEBUG("pipe() error\n");
-		return -1;
-	}
-	if ((pid = fork()) < 0) {
-		VB2_DEBUG("fork() error\n");
+	pid = spawn_signer(external_signer, pem_file, 0, &to_fd, &from_fd);
+	if (pid < 0)
 		return -1;
-	} else if (pid > 0) {  /* Parent. */
-		close(p_to_c[STDIN_FILENO]);
-		close(c_to_p[STDOUT_FILENO]);
 
-		/* We provide input to the child process (external signer). */
-		if (write(p_to_c[STDOUT_FILENO], inbuf, size) != size) {
-			VB2_DEBUG("write() error\n");
+	/* We provide input to the child process (external signer). */
+	if (write(to_fd, inbuf, size) != size) {
+		VB2_DEBUG("write() error\n");
+		rv = -1;
+	} else {
+		/* Send EOF to child (signer process). */
+		close(to_fd);
+		to_fd = -1;
+
+		do {
+			n = read(from_fd, outbuf, outbufsize);
+			outbuf += n;
+			outbufsize -= n;
+		} while (n > 0 && outbufsize);
+
+		if (n < 0) {
+			VB2_DEBUG("read() error\n");
 			rv = -1;
-		} else {
-			/* Send EOF to child (signer process). */
-			close(p_to_c[STDOUT_FILENO]);
-
-			do {
-				n = read(c_to_p[STDIN_FILENO], outbuf,
-					 outbufsize);
-				outbuf += n;
-				outbufsize -= n;
-			} while (n > 0 && outbufsize);
-
-			if (n < 0) {
-				VB2_DEBUG("read() error\n");
-				rv = -1;
-			}
-		}
-		if (waitpid(pid, NULL, 0) < 0) {
-			VB2_DEBUG("waitpid() error\n");
+		} else if (outbufsize) {
+			VB2_DEBUG("Signer output is too short\n");
 			rv = -1;
 		}
-	} else {  /* Child. */
-		close (p_to_c[STDOUT_FILENO]);
-		close (c_to_p[STDIN_FILENO]);
-		/* Map the stdin to the first pipe (this pipe gets input
-		 * from the parent) */
-		if (STDIN_FILENO != p_to_c[STDIN_FILENO]) {
-			if (dup2(p_to_c[STDIN_FILENO], STDIN_FILENO) !=
-			    STDIN_FILENO) {
-				VB2_DEBUG("stdin dup2() failed\n");
-				close(p_to_c[0]);
-				return -1;
-			}
+	}
+	if (to_fd >= 0)
+		close(to_fd);
+	close(from_fd);
+	if (waitpid(pid, NULL, 0) < 0) {
+		VB2_DEBUG("waitpid() error\n");
+		rv = -1;
+	}
+	return rv;
+}
+
+/* Write or read exactly [size] bytes. Returns 0 on success, -1 on error or
+ * end of file. */
+static int write_all(int fd, const void *buf, uint32_t size)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while (size) {
+		n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+static int read_all(int fd, void *buf, uint32_t size, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint8_t *p = buf;
+	ssize_t n;
+	int r;
+
+	while (size) {
+		/* Don't wait forever on a stuck signer */
+		r = poll(&pfd, 1, timeout_ms);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0) {
+			VB2_DEBUG("No response from co-process\n");
+			return -1;
 		}
-		/* Map the stdout to the second pipe (this pipe sends back
-		 * signer output to the parent) */
-		if (STDOUT_FILENO != c_to_p[STDOUT_FILENO]) {
-			if (dup2(c_to_p[STDOUT_FILENO], STDOUT_FILENO) !=
-			    STDOUT_FILENO) {
-				VB2_DEBUG("stdout dup2() failed\n");
-				close(c_to_p[STDOUT_FILENO]);
-				return -1;
-			}
+		n = read(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* Wait up to COPROCESS_EXIT_MS for [pid] to exit, then kill it. */
+static void reap_signer(pid_t pid)
+{
+	int waited;
+	pid_t r;
+
+	for (waited = 0; waited < COPROCESS_EXIT_MS; waited += 10) {
+		r = waitpid(pid, NULL, WNOHANG);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r) {
+			if (r < 0)
+				VB2_DEBUG("waitpid() error\n");
+			return;
 		}
-		/* External signer is invoked here. */
-		if (execl(external_signer, external_signer, pem_file,
-			  (char *) 0) < 0) {
-			VB2_DEBUG("execl() of external signer failed\n");
+		usleep(10 * 1000);
+	}
+
+	VB2_DEBUG("Co-process %d did not exit; killing it.\n", (int)pid);
+	kill(pid, SIGKILL);
+	while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+		;
+}
+
+static void stop_coprocess(struct signer_coprocess *cp)
+{
+	if (!cp->pid)
+		return;
+
+	/* EOF on stdin tells the signer to exit */
+	close(cp->to_fd);
+	close(cp->from_fd);
+	close(cp->lock_fd);
+	/* Processes forked after the start only drop their pipe ends */
+	if (cp->owner == getpid())
+		reap_signer(cp->pid);
+	cp->pid = 0;
+}
+
+/* Create the lock which lets processes forked after [cp] started take turns
+ * using it. The first byte of the lock file is non-zero while a request is
+ * in progress, so a user which died mid-request is noticed. Returns 0 on
+ * success, -1 on error.
+ */
+static int create_coprocess_lock(struct signer_coprocess *cp)
+{
+	char path[] = "/tmp/vb2_signer_lock.XXXXXX";
+	uint8_t busy = 0;
+
+	cp->lock_fd = mkstemp(path);
+	if (cp->lock_fd < 0) {
+		VB2_DEBUG("Unable to create co-process lock\n");
+		return -1;
+	}
+	unlink(path);
+	fcntl(cp->lock_fd, F_SETFD, FD_CLOEXEC);
+	if (pwrite(cp->lock_fd, &busy, 1, 0) != 1) {
+		close(cp->lock_fd);
+		return -1;
+	}
+	return 0;
+}
+
+static void unlock_coprocess(struct signer_coprocess *cp, int in_sync)
+{
+	struct flock fl = { .l_type = F_UNLCK, .l_whence = SEEK_SET };
+	uint8_t busy = 0;
+
+	/* Leave the busy mark if the request stream is out of step */
+	if (in_sync && pwrite(cp->lock_fd, &busy, 1, 0) != 1)
+		VB2_DEBUG("Unable to clear co-process busy mark\n");
+	fcntl(cp->lock_fd, F_SETLK, &fl);
+}
+
+/* Take [cp]'s lock. Returns 0 on success, or -1 if the lock can't be taken
+ * or an earlier user left the co-process in the middle of a request.
+ */
+static int lock_coprocess(struct signer_coprocess *cp)
+{
+	struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+	uint8_t busy = 1;
+
+	while (fcntl(cp->lock_fd, F_SETLKW, &fl) < 0) {
+		if (errno != EINTR) {
+			VB2_DEBUG("Unable to lock co-process\n");
+			return -1;
 		}
 	}
-	return rv;
+	if (pread(cp->lock_fd, &busy, 1, 0) != 1 || busy) {
+		VB2_DEBUG("Co-process was left mid-request\n");
+		unlock_coprocess(cp, 0);
+		return -1;
+	}
+	busy = 1;
+	if (pwrite(cp->lock_fd, &busy, 1, 0) != 1) {
+		unlock_coprocess(cp, 0);
+		return -1;
+	}
+	return 0;
 }
 
-struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
-					     const char *key_file,
-					     uint32_t key_algorithm,
-					     const char *external_signer)
+/* Read a 32-bit big-endian word from [cp]. Returns 0 on success, -1 on error.
+ */
+static int read_word(struct signer_coprocess *cp, uint32_t *word,
+		     int timeout_ms)
 {
-	int vb2_alg = vb2_crypto_to_hash(key_algorithm);
-	uint8_t digest[VB2_MAX_DIGEST_SIZE];
-	int digest_size = vb2_digest_size(vb2_alg);
+	uint8_t buf[4];
 
-	uint32_t digest_info_size = 0;
-	const uint8_t *digest_info = NULL;
-	if (VB2_SUCCESS != vb2_digest_info(vb2_alg,
-					   &digest_info, &digest_info_size))
-		return NULL;
+	if (read_all(cp->from_fd, buf, sizeof(buf), timeout_ms))
+		return -1;
+	*word = (uint32_t)buf[0] << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
+	return 0;
+}
+
+static int write_word(struct signer_coprocess *cp, uint32_t word)
+{
+	uint8_t buf[4] = { word >> 24, word >> 16, word >> 8, word };
+
+	return write_all(cp->to_fd, buf, sizeof(buf));
+}
 
+/* Find the running co-process for [external_signer] and [pem_file], starting
+ * it if needed. Returns NULL if the signer can't be used as a co-process.
+ */
+static struct signer_coprocess *get_coprocess(const char *external_signer,
+					      const char *pem_file)
+{
+	struct signer_coprocess *cp;
+	uint32_t hello;
 
-	uint8_t *signature_digest;
-	uint64_t signature_digest_len = digest_size + digest_info_size;
+	for (cp = coprocesses; cp; cp = cp->next) {
+		if (!strcmp(cp->external_signer, external_signer) &&
+		    !strcmp(cp->pem_file, pem_file))
+			return cp->pid ? cp : NULL;
+	}
 
-	int rv;
+	cp = calloc(1, sizeof(*cp));
+	if (!cp)
+		return NULL;
+	cp->external_signer = strdup(external_signer);
+	cp->pem_file = strdup(pem_file);
+	if (!cp->external_signer || !cp->pem_file) {
+		free(cp->external_signer);
+		free(cp->pem_file);
+		free(cp);
+		return NULL;
+	}
+	cp->next = coprocesses;
+	coprocesses = cp;
 
-	/* Calculate the digest */
-	if (VB2_SUCCESS != vb2_digest_buffer(data, size, vb2_alg,
-					     digest, sizeof(digest)))
+	if (create_coprocess_lock(cp))
 		return NULL;
 
-	/* Prepend the digest info to the digest */
-	signature_digest = calloc(signature_digest_len, 1);
-	if (!signature_digest)
+	VB2_DEBUG("Starting \"%s %s %s\" as a co-process.\n",
+		  external_signer, COPROCESS_ARG, pem_file);
+	cp->owner = getpid();
+	cp->pid = spawn_signer(external_signer, pem_file, 1,
+			       &cp->to_fd, &cp->from_fd);
+	if (cp->pid < 0) {
+		cp->pid = 0;
+		close(cp->lock_fd);
 		return NULL;
+	}
+
+	/* A signer which ignored COPROCESS_ARG is waiting for EOF */
+	if (read_word(cp, &hello, coprocess_timeout_ms < COPROCESS_HELLO_MS ?
+		      coprocess_timeout_ms : COPROCESS_HELLO_MS) ||
+	    hello != COPROCESS_HELLO) {
+		VB2_DEBUG("Signer did not start as a co-process.\n");
+		stop_coprocess(cp);
+	}
+
+	return cp->pid ? cp : NULL;
+}
+
+/* Sign [count] buffers using a signer co-process, one request at a time.
+ * Each request is a 32-bit big-endian length followed by that many bytes to
+ * sign; each response is a 32-bit big-endian length followed by the
+ * signature, or a length of zero if the signer failed to sign that request.
+ *
+ * Processes forked after the co-process started may share it; each takes
+ * the lock for its whole exchange.
+ *
+ * Returns 0 on success, -1 if the signer refused any request, or 1 if the
+ * co-process failed; in that case [*done] is the number of signatures which
+ * were received before the failure.
+ */
+static int sign_coprocess(struct signer_coprocess *cp, int count,
+			  uint8_t *const *inbufs, uint32_t insize,
+			  uint8_t *const *outbufs, uint32_t outsize,
+			  int *done)
+{
+	struct sigaction ignore = { .sa_handler = SIG_IGN }, old;
+	int i, rv = 0;
+	uint32_t n;
+
+	if (lock_coprocess(cp)) {
+		stop_coprocess(cp);
+		*done = 0;
+		return 1;
+	}
+
+	/* A signer which exits early must not kill us with SIGPIPE */
+	sigemptyset(&ignore.sa_mask);
+	sigaction(SIGPIPE, &ignore, &old);
+
+	for (i = 0; i < count; i++) {
+		if (write_word(cp, insize) ||
+		    write_all(cp->to_fd, inbufs[i], insize)) {
+			VB2_DEBUG("write() to co-process failed\n");
+			goto fail;
+		}
+		if (read_word(cp, &n, coprocess_timeout_ms)) {
+			VB2_DEBUG("read() from co-process failed\n");
+			goto fail;
+		}
+		if (!n) {
+			VB2_DEBUG("Co-process failed to sign request %d\n", i);
+			rv = -1;
+		} else if (n != outsize ||
+			   read_all(cp->from_fd, outbufs[i], n,
+				    coprocess_timeout_ms)) {
+			VB2_DEBUG("Bad response from co-process\n");
+			goto fail;
+		}
+	}
+
+	sigaction(SIGPIPE, &old, NULL);
+	unlock_coprocess(cp, 1);
+	*done = count;
+	return rv;
+
+fail:
+	sigaction(SIGPIPE, &old, NULL);
+	unlock_coprocess(cp, 0);
+	stop_coprocess(cp);
+	*done = i;
+	return 1;
+}
+
+void vb2_external_signer_persist(int enable)
+{
+	coprocess_enabled = enable;
+}
 
-	memcpy(signature_digest, digest_info, digest_info_size);
-	memcpy(signature_digest + digest_info_size, digest, digest_size);
+void vb2_external_signer_timeout(int timeout_ms)
+{
+	coprocess_timeout_ms = timeout_ms;
+}
+
+int vb2_external_signer_start(const char *key_file,
+			      const char *external_signer)
+{
+	return get_coprocess(external_signer, key_file) ? 0 : -1;
+}
 
-	/* Allocate output signature */
+void vb2_external_signer_close(void)
+{
+	struct signer_coprocess *cp;
+
+	while (coprocesses) {
+		cp = coprocesses;
+		coprocesses = cp->next;
+		stop_coprocess(cp);
+		free(cp->external_signer);
+		free(cp->pem_file);
+		free(cp);
+	}
+}
+
+int vb2_external_signatures(struct vb2_signature **sigs, int count,
+			    const uint8_t *const *data, const uint32_t *size,
+			    const char *key_file, uint32_t key_algorithm,
+			    const char *external_signer)
+{
+	enum vb2_hash_algorithm hash_alg = vb2_crypto_to_hash(key_algorithm);
+	uint32_t digest_size = vb2_digest_size(hash_alg);
 	uint32_t sig_size =
 		vb2_rsa_sig_size(vb2_crypto_to_signature(key_algorithm));
-	struct vb2_signature *sig = vb2_alloc_signature(sig_size, size);
-	if (!sig) {
-		free(signature_digest);
-		return NULL;
+	const uint8_t *digest_info = NULL;
+	uint32_t digest_info_size = 0;
+	uint32_t signature_digest_len;
+	uint8_t **inbufs = NULL, **outbufs = NULL;
+	struct signer_coprocess *cp = NULL;
+	int i, done = 0, rv = -1;
+
+	for (i = 0; i < count; i++)
+		sigs[i] = NULL;
+
+	if (VB2_SUCCESS != vb2_digest_info(hash_alg,
+					   &digest_info, &digest_info_size))
+		return -1;
+	signature_digest_len = digest_info_size + digest_size;
+
+	inbufs = calloc(count, sizeof(*inbufs));
+	outbufs = calloc(count, sizeof(*outbufs));
+	if (!inbufs || !outbufs)
+		goto done;
+
+	for (i = 0; i < count; i++) {
+		/* Prepend the digest info to the digest */
+		inbufs[i] = malloc(signature_digest_len);
+		if (!inbufs[i])
+			goto done;
+		memcpy(inbufs[i], digest_info, digest_info_size);
+		if (VB2_SUCCESS !=
+		    vb2_digest_buffer(data[i], size[i], hash_alg,
+				      inbufs[i] + digest_info_size,
+				      digest_size))
+			goto done;
+
+		/* Allocate output signature */
+		sigs[i] = vb2_alloc_signature(sig_size, size[i]);
+		if (!sigs[i])
+			goto done;
+		outbufs[i] = vb2_signature_data_mutable(sigs[i]);
+	}
+
+	if (coprocess_enabled)
+		cp = get_coprocess(external_signer, key_file);
+	if (cp) {
+		rv = sign_coprocess(cp, count, inbufs, signature_digest_len,
+				    outbufs, sig_size, &done);
+		if (rv <= 0)
+			goto done;
+		VB2_DEBUG("Falling back to one signer per signature.\n");
+	}
+
+	/* Sign whatever the co-process didn't, one process at a time */
+	rv = 0;
+	for (i = done; i < count && !rv; i++)
+		rv = sign_external(signature_digest_len, inbufs[i],
+				   outbufs[i], sig_size, key_file,
+				   external_signer);
+
+done:
+	for (i = 0; i < count; i++) {
+		if (inbufs)
+			free(inbufs[i]);
+		if (rv) {
+			free(sigs[i]);
+			sigs[i] = NULL;
+		}
 	}
+	free(inbufs);
+	free(outbufs);
+	return rv ? -1 : 0;
+}
 
-	/* Sign the signature_digest into our output buffer */
-	rv = sign_external(signature_digest_len,    /* Input length */
-			   signature_digest,        /* Input data */
-			   vb2_signature_data_mutable(sig),  /* Output sig */
-			   sig_size,                /* Max Output sig size */
-			   key_file,                /* Key file to use */
-			   external_signer);        /* External cmd to invoke */
-	free(signature_digest);
+struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
+					     const char *key_file,
+					     uint32_t key_algorithm,
+					     const char *external_signer)
+{
+	struct vb2_signature *sig;
 
-	if (-1 == rv) {
+	if (vb2_external_signatures(&sig, 1, &data, &size, key_file,
+				    key_algorithm, external_signer)) {
 		VB2_DEBUG("RSA_private_encrypt() failed.\n");
-		free(sig);
 		return NULL;
 	}
 
@@ -14,6 +14,8 @@
 #define FLASHROM_PROGRAMMER_INTERNAL_EC "ec"
 
 /* Utilities for firmware images and (FMAP) sections */
+struct cbfs_index_cache;
+
 struct firmware_image {
 	/**
 	 * programmer	The name of the programmer to use. Use either
@@ -24,9 +26,12 @@ struct firmware_image {
 	const char *programmer;
 	uint32_t size; /* buffer size. */
 	uint8_t *data; /* data allocated buffer to read/write with. */
+	int is_mapped; /* data is a private (copy-on-write) file mapping. */
 	char *file_name;
 	char *ro_version, *rw_version_a, *rw_version_b;
 	FmapHeader *fmap_header;
+	/* CBFS indexes built by the firmware updater, freed with the image. */
+	struct cbfs_index_cache *cbfs_indexes;
 };
 
 /**
@@ -59,3 +64,37 @@ int flashrom_write_image(const struct firmware_image *image,
 			const char * const regions[],
 			const struct firmware_image *diff_image,
 			int do_verify, int verbosity);
+
+/* A range of the flash chip to read. */
+struct flashrom_range {
+	uint32_t offset;
+	uint32_t size;
+};
+
+/**
+ * Callback for each range read by flashrom_read_ranges.
+ *
+ * @param ctx		The context given to flashrom_read_ranges.
+ * @param index		The index of the range.
+ * @param data		The contents of the range, valid only in the callback.
+ *
+ * @return 0 to continue, or non-zero to stop reading.
+ */
+typedef int flashrom_range_cb(void *ctx, int index, const uint8_t *data);
+
+/**
+ * Read ranges of the flash one at a time using flashrom, passing each to a
+ * callback, so the memory used does not depend on the size of the ranges.
+ *
+ * @param programmer	The programmer to use, as in struct firmware_image.
+ * @param ranges	The ranges to read.
+ * @param count		The number of ranges.
+ * @param cb		The callback for each range read.
+ * @param ctx		The context for the callback.
+ * @param verbosity	The verbosity of libflashrom messages.
+ *
+ * @return 0 on success, or non-zero on failure or if cb returned non-zero.
+ */
+int flashrom_read_ranges(const char *programmer,
+			 const struct flashrom_range *ranges, int count,
+			 flashrom_range_cb *cb, void *ctx, int verbosity);
@@ -0,0 +1,75 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Cache of unpacked public keys for host utilities which verify many blobs
+ * against a small set of keys.
+ */
+
+#ifndef VBOOT_REFERENCE_HOST_KEY_CACHE_H_
+#define VBOOT_REFERENCE_HOST_KEY_CACHE_H_
+
+#include "2common.h"
+#include "2return_codes.h"
+
+struct vb2_keyblock;
+struct vb2_packed_key;
+struct vb2_public_key;
+
+/**
+ * Unpack a key from a buffer, reusing an earlier unpack of the same key.
+ *
+ * Keys are identified by their algorithm and their complete key data. The
+ * first time a key is seen it is copied, unpacked and validated; later calls
+ * return the same key. The key does not reference |buf|, and stays valid until
+ * vb2_key_cache_clear().
+ *
+ * @param key		Destination for pointer to the cached key
+ * @param buf		Pointer to packed key header and data
+ * @param size		Size of buffer in bytes
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_key_cache_unpack_buffer(const struct vb2_public_key **key,
+					const uint8_t *buf, uint32_t size);
+
+/**
+ * Unpack a key, reusing an earlier unpack of the same key.
+ *
+ * Like vb2_key_cache_unpack_buffer(), for a packed key with its data right
+ * after it.
+ *
+ * @param key		Destination for pointer to the cached key
+ * @param packed_key	Packed key to unpack
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_key_cache_unpack(const struct vb2_public_key **key,
+				 const struct vb2_packed_key *packed_key);
+
+/**
+ * Verify a keyblock, remembering keyblocks this key has already verified.
+ *
+ * Same checks and results as vb2_verify_keyblock(). If |key| came from the
+ * key cache, the keyblock (header, data key and signature) is hashed, and a
+ * keyblock identical to one which already passed with this key is accepted
+ * without repeating the RSA operation. Unlike vb2_verify_keyblock(), the
+ * signature is then left intact.
+ *
+ * @param block		Keyblock to verify
+ * @param size		Size of keyblock buffer
+ * @param key		Key to use to verify block
+ * @param wb		Work buffer
+ * @return VB2_SUCCESS, or non-zero error code if error.
+ */
+vb2_error_t vb2_key_cache_verify_keyblock(struct vb2_keyblock *block,
+					  uint32_t size,
+					  const struct vb2_public_key *key,
+					  const struct vb2_workbuf *wb);
+
+/**
+ * Free all cached keys.
+ *
+ * Invalidates all keys returned by vb2_key_cache_unpack*().
+ */
+void vb2_key_cache_clear(void);
+
+#endif  /* VBOOT_REFERENCE_HOST_KEY_CACHE_H_ */
@@ -57,6 +57,19 @@ vb2_error_t vb2_copy_signature(struct vb2_signature *dest,
  */
 struct vb2_signature *vb2_sha512_signature(const uint8_t *data, uint32_t size);
 
+/**
+ * Calculate a signature for an already computed digest.
+ *
+ * @param digest	Digest of the data, using the hash algorithm of |key|
+ * @param data_size	Length of the data that was hashed, in bytes
+ * @param key		Private key to use to sign the digest
+ *
+ * @return The signature, or NULL if error.  Caller must free() it.
+ */
+struct vb2_signature *vb2_sign_digest(const uint8_t *digest,
+				      uint32_t data_size,
+				      const struct vb2_private_key *key);
+
 /**
  * Calculate a signature for the data using the specified key.
  *
@@ -85,4 +98,78 @@ struct vb2_signature *vb2_external_signature(const uint8_t *data, uint32_t size,
 					     uint32_t key_algorithm,
 					     const char *external_signer);
 
+/**
+ * Calculate signatures for several buffers using an external signer.
+ *
+ * Like vb2_external_signature(), for [count] buffers signed with the same
+ * key. If vb2_external_signer_persist() has been enabled, the requests are
+ * sent in turn to a single long-lived signer process; otherwise, or if the
+ * signer can't run that way, one signer process is run per signature.
+ *
+ * @param sigs			Destination for the [count] signatures.
+ *				Caller must free() each of them.
+ * @param count			Number of buffers to sign
+ * @param data			Pointers to data to sign
+ * @param size			Length of each buffer in bytes
+ * @param key_file		Name of file containing private key
+ * @param key_algorithm		Key algorithm
+ * @param external_signer	Path to external signer program
+ *
+ * @return 0 on success, non-zero if error (all [sigs] are NULL).
+ */
+int vb2_external_signatures(struct vb2_signature **sigs, int count,
+			    const uint8_t *const *data, const uint32_t *size,
+			    const char *key_file, uint32_t key_algorithm,
+			    const char *external_signer);
+
+/**
+ * Choose whether external signers are kept running between signatures.
+ *
+ * When enabled, the first signature for a signer and key file starts
+ * "[external_signer] --coprocess [key_file]". Instead of signing one input
+ * until EOF, the signer then writes the 32-bit big-endian word 1 to stdout
+ * at once, and reads requests from stdin until EOF, each a 32-bit big-endian
+ * length followed by the bytes to sign. It answers each one on stdout with
+ * a 32-bit big-endian length followed by the signature, or a zero length if
+ * it could not sign that request. Signers which don't send the word 1 within
+ * two seconds, exit, break the protocol or don't answer a request in time
+ * (see vb2_external_signer_timeout()) are run once per signature instead.
+ *
+ * Processes forked after a signer was started share it, taking turns, but
+ * only the process which started it waits for it to exit.
+ *
+ * @param enable	Non-zero to keep signers running
+ */
+void vb2_external_signer_persist(int enable);
+
+/**
+ * Set how long to wait for each response from a kept-running signer.
+ *
+ * A signer which doesn't answer in time is stopped, and assumed not to
+ * support the co-process protocol. The default is 30 seconds.
+ *
+ * @param timeout_ms	Timeout in milliseconds
+ */
+void vb2_external_signer_timeout(int timeout_ms);
+
+/**
+ * Start the kept-running signer for a key file now.
+ *
+ * Used before forking workers, so they all send their signatures to one
+ * signer instead of each starting their own. Has no effect on signing unless
+ * vb2_external_signer_persist() is enabled.
+ *
+ * @param key_file		Name of file containing private key
+ * @param external_signer	Path to external signer program
+ *
+ * @return 0 if the signer is running, non-zero if it could not be started.
+ */
+int vb2_external_signer_start(const char *key_file,
+			      const char *external_signer);
+
+/**
+ * Stop all external signers kept running by vb2_external_signer_persist().
+ */
+void vb2_external_signer_close(void);
+
 #endif  /* VBOOT_REFERENCE_HOST_SIGNATURE_H_ */
@@ -0,0 +1,46 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Multi-buffer message digest functions for host utilities.
+ */
+
+#ifndef VBOOT_REFERENCE_SHA_MULTIBUF_H_
+#define VBOOT_REFERENCE_SHA_MULTIBUF_H_
+
+#include "2sha.h"
+
+/* Number of independent messages hashed side by side per algorithm. */
+#define VB2_SHA256_MB_LANES 8
+#define VB2_SHA512_MB_LANES 4
+
+/* One message to be hashed by vb2_digest_buffers(). */
+struct vb2_digest_job {
+	/* Data to hash */
+	const uint8_t *buf;
+	/* Length of data in bytes */
+	uint32_t size;
+	/* Destination for digest */
+	uint8_t *digest;
+	/* Length of digest buffer in bytes */
+	uint32_t digest_size;
+};
+
+/**
+ * Calculate the digests of several independent buffers.
+ *
+ * SHA-224/256 and SHA-384/512 messages are interleaved across vector lanes
+ * (VB2_SHA256_MB_LANES / VB2_SHA512_MB_LANES at a time), so hashing a batch
+ * of similarly-sized buffers costs about as much as hashing the largest one.
+ * Other algorithms fall back to vb2_digest_buffer() per job.
+ *
+ * @param jobs		Array of messages and their digest destinations
+ * @param count		Number of entries in |jobs|
+ * @param hash_alg	Hash algorithm used for all messages
+ * @return VB2_SUCCESS, or non-zero on error.  On error the contents of all
+ * digest buffers are undefined.
+ */
+vb2_error_t vb2_digest_buffers(struct vb2_digest_job *jobs, int count,
+			       enum vb2_hash_algorithm hash_alg);
+
+#endif  /* VBOOT_REFERENCE_SHA_MULTIBUF_H_ */
@@ -0,0 +1,332 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Multi-buffer SHA-256 and SHA-512 for host utilities.
+ *
+ * Several independent messages are hashed at once by keeping one message per
+ * lane of a vector register. Lanes run in lock step one block at a time; when
+ * a lane runs out of full blocks its state is handed back to the scalar code
+ * in firmware/2lib for padding and finalization, and the lane is refilled
+ * with the next message.
+ */
+
+#include "2common.h"
+#include "2sha.h"
+#include "2sha_private.h"
+#include "2sysincludes.h"
+#include "sha_multibuf.h"
+
+/*
+ * The lane transforms only use generic vector operations, so the compiler can
+ * emit them for any ISA. On x86-64 also build an AVX2 version and let the
+ * dynamic loader pick the best one for the running CPU.
+ */
+#if defined(__x86_64__) && defined(__GLIBC__)
+#define MB_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define MB_TARGET_CLONES
+#endif
+
+typedef uint32_t vb2_sha256_lanes
+	__attribute__((vector_size(sizeof(uint32_t) * VB2_SHA256_MB_LANES)));
+typedef uint64_t vb2_sha512_lanes
+	__attribute__((vector_size(sizeof(uint64_t) * VB2_SHA512_MB_LANES)));
+
+#define SHFR(x, n)	((x) >> (n))
+#define ROTR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+#define CH(x, y, z)	(((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define SHA256_F1(x) (ROTR32(x,  2) ^ ROTR32(x, 13) ^ ROTR32(x, 22))
+#define SHA256_F2(x) (ROTR32(x,  6) ^ ROTR32(x, 11) ^ ROTR32(x, 25))
+#define SHA256_F3(x) (ROTR32(x,  7) ^ ROTR32(x, 18) ^ SHFR(x,  3))
+#define SHA256_F4(x) (ROTR32(x, 17) ^ ROTR32(x, 19) ^ SHFR(x, 10))
+
+#define SHA512_F1(x) (ROTR64(x, 28) ^ ROTR64(x, 34) ^ ROTR64(x, 39))
+#define SHA512_F2(x) (ROTR64(x, 14) ^ ROTR64(x, 18) ^ ROTR64(x, 41))
+#define SHA512_F3(x) (ROTR64(x,  1) ^ ROTR64(x,  8) ^ SHFR(x,  7))
+#define SHA512_F4(x) (ROTR64(x, 19) ^ ROTR64(x, 61) ^ SHFR(x,  6))
+
+/* Idle lanes hash this block; their results are never used. */
+static const uint8_t idle_block[VB2_MAX_BLOCK_SIZE];
+
+/* Per-lane bookkeeping */
+struct mb_lane {
+	/* Message being hashed in this lane, or NULL if the lane is idle */
+	struct vb2_digest_job *job;
+	/* Next unprocessed byte of the message */
+	const uint8_t *data;
+	/* Number of full blocks left at |data| */
+	uint32_t blocks;
+	/* Set when a new message was loaded and the lane state needs init */
+	int fresh;
+};
+
+MB_TARGET_CLONES
+static void sha256_mb_transform(vb2_sha256_lanes *h,
+				const uint8_t *const *data)
+{
+	vb2_sha256_lanes w[64];
+	vb2_sha256_lanes wv[8];
+	vb2_sha256_lanes t1, t2;
+	uint32_t word;
+	int i, j;
+
+	for (j = 0; j < 16; j++) {
+		for (i = 0; i < VB2_SHA256_MB_LANES; i++) {
+			PACK32(&data[i][j << 2], &word);
+			w[j][i] = word;
+		}
+	}
+
+	for (j = 16; j < 64; j++)
+		w[j] = SHA256_F4(w[j - 2]) + w[j - 7] +
+			SHA256_F3(w[j - 15]) + w[j - 16];
+
+	for (j = 0; j < 8; j++)
+		wv[j] = h[j];
+
+	for (j = 0; j < 64; j++) {
+		t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
+			+ vb2_sha256_k[j] + w[j];
+		t2 = SHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
+		wv[7] = wv[6];
+		wv[6] = wv[5];
+		wv[5] = wv[4];
+		wv[4] = wv[3] + t1;
+		wv[3] = wv[2];
+		wv[2] = wv[1];
+		wv[1] = wv[0];
+		wv[0] = t1 + t2;
+	}
+
+	for (j = 0; j < 8; j++)
+		h[j] += wv[j];
+}
+
+MB_TARGET_CLONES
+static void sha512_mb_transform(vb2_sha512_lanes *h,
+				const uint8_t *const *data)
+{
+	vb2_sha512_lanes w[80];
+	vb2_sha512_lanes wv[8];
+	vb2_sha512_lanes t1, t2;
+	uint64_t word;
+	int i, j;
+
+	for (j = 0; j < 16; j++) {
+		for (i = 0; i < VB2_SHA512_MB_LANES; i++) {
+			PACK64(&data[i][j << 3], &word);
+			w[j][i] = word;
+		}
+	}
+
+	for (j = 16; j < 80; j++)
+		w[j] = SHA512_F4(w[j - 2]) + w[j - 7] +
+			SHA512_F3(w[j - 15]) + w[j - 16];
+
+	for (j = 0; j < 8; j++)
+		wv[j] = h[j];
+
+	for (j = 0; j < 80; j++) {
+		t1 = wv[7] + SHA512_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
+			+ vb2_sha512_k[j] + w[j];
+		t2 = SHA512_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
+		wv[7] = wv[6];
+		wv[6] = wv[5];
+		wv[5] = wv[4];
+		wv[4] = wv[3] + t1;
+		wv[3] = wv[2];
+		wv[2] = wv[1];
+		wv[1] = wv[0];
+		wv[0] = t1 + t2;
+	}
+
+	for (j = 0; j < 8; j++)
+		h[j] += wv[j];
+}
+
+/*
+ * Refill idle lanes from the job list. Returns the number of busy lanes and
+ * the smallest number of full blocks left in any of them.
+ */
+static int mb_fill_lanes(struct mb_lane *lane, int lanes,
+			 struct vb2_digest_job *jobs, int count, int *next,
+			 uint32_t block_size, uint32_t *min_blocks)
+{
+	int busy = 0;
+	int i;
+
+	*min_blocks = UINT32_MAX;
+	for (i = 0; i < lanes; i++) {
+		if (!lane[i].job && *next < count) {
+			lane[i].job = &jobs[(*next)++];
+			lane[i].data = lane[i].job->buf;
+			lane[i].blocks = lane[i].job->size / block_size;
+			lane[i].fresh = 1;
+		}
+		if (!lane[i].job)
+			continue;
+		busy++;
+		if (lane[i].blocks < *min_blocks)
+			*min_blocks = lane[i].blocks;
+	}
+	return busy;
+}
+
+static uint32_t mb_bytes_left(const struct mb_lane *lane)
+{
+	return lane->job->size - (uint32_t)(lane->data - lane->job->buf);
+}
+
+static void sha256_mb(struct vb2_digest_job *jobs, int count,
+		      enum vb2_hash_algorithm hash_alg)
+{
+	struct mb_lane lane[VB2_SHA256_MB_LANES] = {{0}};
+	const uint8_t *data[VB2_SHA256_MB_LANES];
+	vb2_sha256_lanes h[8];
+	struct vb2_sha256_context ctx;
+	uint32_t n;
+	int next = 0;
+	int busy, last, i, j;
+
+	while ((busy = mb_fill_lanes(lane, VB2_SHA256_MB_LANES, jobs, count,
+				     &next, VB2_SHA256_BLOCK_SIZE, &n))) {
+		for (i = 0; i < VB2_SHA256_MB_LANES; i++) {
+			if (!lane[i].fresh)
+				continue;
+			lane[i].fresh = 0;
+			vb2_sha256_init(&ctx, hash_alg);
+			for (j = 0; j < 8; j++)
+				h[j][i] = ctx.h[j];
+		}
+
+		/*
+		 * With a single message left, vector lanes would be mostly
+		 * wasted; let the scalar transform finish it.
+		 */
+		last = busy == 1 && next == count;
+		if (last)
+			n = 0;
+
+		for (; n > 0; n--) {
+			for (i = 0; i < VB2_SHA256_MB_LANES; i++)
+				data[i] = lane[i].job ? lane[i].data :
+					idle_block;
+			sha256_mb_transform(h, data);
+			for (i = 0; i < VB2_SHA256_MB_LANES; i++) {
+				if (!lane[i].job)
+					continue;
+				lane[i].data += VB2_SHA256_BLOCK_SIZE;
+				lane[i].blocks--;
+			}
+		}
+
+		for (i = 0; i < VB2_SHA256_MB_LANES; i++) {
+			if (!lane[i].job || (lane[i].blocks && !last))
+				continue;
+			for (j = 0; j < 8; j++)
+				ctx.h[j] = h[j][i];
+			ctx.size = 0;
+			ctx.total_size = lane[i].data - lane[i].job->buf;
+			vb2_sha256_update(&ctx, lane[i].data,
+					  mb_bytes_left(&lane[i]));
+			vb2_sha256_finalize(&ctx, lane[i].job->digest,
+					    hash_alg);
+			lane[i].job = NULL;
+		}
+	}
+}
+
+static void sha512_mb(struct vb2_digest_job *jobs, int count,
+		      enum vb2_hash_algorithm hash_alg)
+{
+	struct mb_lane lane[VB2_SHA512_MB_LANES] = {{0}};
+	const uint8_t *data[VB2_SHA512_MB_LANES];
+	vb2_sha512_lanes h[8];
+	struct vb2_sha512_context ctx;
+	uint32_t n;
+	int next = 0;
+	int busy, last, i, j;
+
+	while ((busy = mb_fill_lanes(lane, VB2_SHA512_MB_LANES, jobs, count,
+				     &next, VB2_SHA512_BLOCK_SIZE, &n))) {
+		for (i = 0; i < VB2_SHA512_MB_LANES; i++) {
+			if (!lane[i].fresh)
+				continue;
+			lane[i].fresh = 0;
+			vb2_sha512_init(&ctx, hash_alg);
+			for (j = 0; j < 8; j++)
+				h[j][i] = ctx.h[j];
+		}
+
+		last = busy == 1 && next == count;
+		if (last)
+			n = 0;
+
+		for (; n > 0; n--) {
+			for (i = 0; i < VB2_SHA512_MB_LANES; i++)
+				data[i] = lane[i].job ? lane[i].data :
+					idle_block;
+			sha512_mb_transform(h, data);
+			for (i = 0; i < VB2_SHA512_MB_LANES; i++) {
+				if (!lane[i].job)
+					continue;
+				lane[i].data += VB2_SHA512_BLOCK_SIZE;
+				lane[i].blocks--;
+			}
+		}
+
+		for (i = 0; i < VB2_SHA512_MB_LANES; i++) {
+			if (!lane[i].job || (lane[i].blocks && !last))
+				continue;
+			for (j = 0; j < 8; j++)
+				ctx.h[j] = h[j][i];
+			ctx.size = 0;
+			ctx.total_size = lane[i].data - lane[i].job->buf;
+			vb2_sha512_update(&ctx, lane[i].data,
+					  mb_bytes_left(&lane[i]));
+			vb2_sha512_finalize(&ctx, lane[i].job->digest,
+					    hash_alg);
+			lane[i].job = NULL;
+		}
+	}
+}
+
+vb2_error_t vb2_digest_buffers(struct vb2_digest_job *jobs, int count,
+			       enum vb2_hash_algorithm hash_alg)
+{
+	size_t digest_size = vb2_digest_size(hash_alg);
+	int i;
+
+	if (!digest_size)
+		return VB2_ERROR_SHA_INIT_ALGORITHM;
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].digest_size < digest_size)
+			return VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE;
+	}
+
+	switch (hash_alg) {
+#if VB2_SUPPORT_SHA256
+	case VB2_HASH_SHA224:
+	case VB2_HASH_SHA256:
+		sha256_mb(jobs, count, hash_alg);
+		return VB2_SUCCESS;
+#endif
+#if VB2_SUPPORT_SHA512
+	case VB2_HASH_SHA384:
+	case VB2_HASH_SHA512:
+		sha512_mb(jobs, count, hash_alg);
+		return VB2_SUCCESS;
+#endif
+	default:
+		for (i = 0; i < count; i++)
+			VB2_TRY(vb2_digest_buffer(jobs[i].buf, jobs[i].size,
+						  hash_alg, jobs[i].digest,
+						  jobs[i].digest_size));
+		return VB2_SUCCESS;
+	}
+}
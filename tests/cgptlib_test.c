@@ -1333,6 +1333,48 @@ static int GetNextTriesTest(void)
 	return TEST_OK;
 }
 
+static int GetNextIndexTest(void)
+{
+	GptData *gpt = GetEmptyGptData();
+	GptEntry *e1 = (GptEntry *)(gpt->primary_entries);
+	uint64_t start, size;
+
+	/* Kernels are indexed by priority, then by partition index */
+	BuildTestGptData(gpt);
+	FillEntry(e1 + KERNEL_A, 1, 3, 1, 0);
+	FillEntry(e1 + KERNEL_B, 1, 4, 1, 0);
+	FillEntry(e1 + KERNEL_X, 1, 0, 1, 0);
+	FillEntry(e1 + KERNEL_Y, 1, 4, 1, 0);
+	RefreshCrc32(gpt);
+	GptInit(gpt);
+	EXPECT(4 == gpt->num_kernel_entries);
+	EXPECT(KERNEL_B == gpt->kernel_index[0]);
+	EXPECT(KERNEL_Y == gpt->kernel_index[1]);
+	EXPECT(KERNEL_A == gpt->kernel_index[2]);
+	EXPECT(KERNEL_X == gpt->kernel_index[3]);
+
+	/* Updating the priority of a kernel moves it in the index */
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_B == gpt->current_kernel);
+	EXPECT(GPT_SUCCESS ==
+	       GptUpdateKernelEntry(gpt, GPT_UPDATE_ENTRY_ACTIVE));
+	EXPECT(KERNEL_Y == gpt->kernel_index[0]);
+	EXPECT(KERNEL_A == gpt->kernel_index[1]);
+	EXPECT(KERNEL_B == gpt->kernel_index[2]);
+
+	/* And it is tried again at its new priority */
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_Y == gpt->current_kernel);
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_A == gpt->current_kernel);
+	EXPECT(GPT_SUCCESS == GptNextKernelEntry(gpt, &start, &size));
+	EXPECT(KERNEL_B == gpt->current_kernel);
+	EXPECT(GPT_ERROR_NO_VALID_KERNEL ==
+	       GptNextKernelEntry(gpt, &start, &size));
+
+	return TEST_OK;
+}
+
 static int GptUpdateTest(void)
 {
 	GptData *gpt = GetEmptyGptData();
@@ -1627,10 +1669,14 @@ int main(int argc, char *argv[])
 		{ TEST_CASE(GetNextNormalTest), },
 		{ TEST_CASE(GetNextPrioTest), },
 		{ TEST_CASE(GetNextTriesTest), },
+		{ TEST_CASE(GetNextIndexTest), },
 		{ TEST_CASE(GptUpdateTest), },
 		{ TEST_CASE(UpdateInvalidKernelTypeTest), },
 		{ TEST_CASE(DuplicateUniqueGuidTest), },
 		{ TEST_CASE(TestCrc32TestVectors), },
+#ifdef CRC32_RUNTIME_DISPATCH
+		{ TEST_CASE(TestCrc32Fast), },
+#endif
 		{ TEST_CASE(GetKernelGuidTest), },
 		{ TEST_CASE(ErrorTextTest), },
 		{ TEST_CASE(CheckHeaderOffDevice), },
@@ -42,6 +42,39 @@ int TestCrc32TestVectors(void) {
 
 		crc32 = Crc32(cases[i].vector, cases[i].len);
 		EXPECT(crc32 == cases[i].crc32);
+		crc32 = Crc32Reference(cases[i].vector, cases[i].len);
+		EXPECT(crc32 == cases[i].crc32);
+	}
+	return TEST_OK;
+}
+
+#ifdef CRC32_RUNTIME_DISPATCH
+/* Compare Crc32Fast() with the reference for many lengths and alignments. */
+int TestCrc32Fast(void) {
+	/* Large enough for a full 128-entry GPT entry array, plus slack */
+	const uint32_t buf_size = 16384 + 64;
+	uint8_t *buf = malloc(buf_size);
+	uint32_t len, offset;
+	int hw;
+
+	for (len = 0; len < buf_size; len++)
+		buf[len] = (uint8_t)(len * 31 + (len >> 8));
+
+	for (hw = 0; hw < 2; hw++) {
+		Crc32AllowHw(hw);
+		for (offset = 0; offset < 16; offset += 3) {
+			for (len = 0; len < 300; len++)
+				EXPECT(Crc32Fast(buf + offset, len) ==
+				       Crc32Reference(buf + offset, len));
+			EXPECT(Crc32Fast(buf + offset, 16384) ==
+			       Crc32Reference(buf + offset, 16384));
+			EXPECT(Crc32Fast(buf + offset, 16384 + 47) ==
+			       Crc32Reference(buf + offset, 16384 + 47));
+		}
 	}
+	Crc32AllowHw(1);
+
+	free(buf);
 	return TEST_OK;
 }
+#endif
@@ -7,5 +7,8 @@
 #define VBOOT_REFERENCE_CRC32_TEST_H_
 
 int TestCrc32TestVectors(void);
+#ifdef CRC32_RUNTIME_DISPATCH
+int TestCrc32Fast(void);
+#endif
 
 #endif  /* VBOOT_REFERENCE_CRC32_TEST_H_ */
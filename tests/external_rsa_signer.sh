@@ -1,7 +1,30 @@
 #!/bin/bash
 
+if [ $# -eq 2 ] && [ "$1" = "--coprocess" ]; then
+  # Sign framed requests until EOF; see vb2_external_signer_persist().
+  pem=$2
+  tmp=$(mktemp -d)
+  trap 'rm -rf "${tmp}"' EXIT
+  printf '\000\000\000\001'
+  while hdr=$(head -c 4 | od -An -tu1) && [ -n "${hdr}" ]; do
+    set -- ${hdr}
+    head -c $(( ($1 << 24) | ($2 << 16) | ($3 << 8) | $4 )) > "${tmp}/in"
+    if openssl rsautl -sign -inkey "${pem}" -in "${tmp}/in" \
+         -out "${tmp}/sig"; then
+      len=$(stat -c %s "${tmp}/sig")
+    else
+      len=0
+      : > "${tmp}/sig"
+    fi
+    printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $(( (len >> 24) & 255 )) \
+      $(( (len >> 16) & 255 )) $(( (len >> 8) & 255 )) $(( len & 255 )))"
+    cat "${tmp}/sig"
+  done
+  exit 0
+fi
+
 if [ $# -ne 1 ]; then
-  echo "Usage: $0 <private_key_pem_file>"
+  echo "Usage: $0 [--coprocess] <private_key_pem_file>"
   echo "Reads data to sign from stdin, encrypted data is output to stdout"
   exit 1
 fi
@@ -29,6 +29,7 @@ ${SCRIPT_DIR}/futility/test_show_contents.sh
 ${SCRIPT_DIR}/futility/test_show_kernel.sh
 ${SCRIPT_DIR}/futility/test_show_vs_verify.sh
 ${SCRIPT_DIR}/futility/test_show_usbpd1.sh
+${SCRIPT_DIR}/futility/test_sign_batch.sh
 ${SCRIPT_DIR}/futility/test_sign_firmware.sh
 ${SCRIPT_DIR}/futility/test_sign_fw_main.sh
 ${SCRIPT_DIR}/futility/test_sign_kernel.sh
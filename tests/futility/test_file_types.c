@@ -37,6 +37,7 @@ static struct {
 	{FILE_TYPE_PEM,             "tests/testkeys/key_rsa2048.pem"},
 	{FILE_TYPE_USBPD1,          "tests/futility/data/zinger_mp_image.bin"},
 	{FILE_TYPE_RWSIG,           },		/* need a test for this */
+	{FILE_TYPE_BOOT_TIMING,     "tests/futility/data/boot_timing.bin"},
 };
 _Static_assert(ARRAY_SIZE(test_case) == NUM_FILE_TYPES,
 	       "Need a test case for each file type (total NUM_FILE_TYPES)");
@@ -22,6 +22,7 @@ SHOW_FILES="
   tests/futility/data/sample.vbprik2
   tests/testkeys/key_rsa2048.pem
   tests/testkeys/key_rsa8192.pub.pem
+  tests/futility/data/boot_timing.bin
 "
 
 for file in $SHOW_FILES; do
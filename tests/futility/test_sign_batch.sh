@@ -0,0 +1,127 @@
+#!/bin/bash -eux
+# Copyright 2022 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+DEVKEYS=${SRCDIR}/tests/devkeys
+
+# Sign a few keyblocks one at a time
+for key in firmware_data_key kernel_data_key recovery_kernel_data_key; do
+  ${FUTILITY} sign \
+    --signprivate ${DEVKEYS}/root_key.vbprivk \
+    --flags 7 \
+    ${DEVKEYS}/${key}.vbpubk \
+    ${TMP}.${key}.single
+done
+
+# Now all at once
+cat > ${TMP}.manifest <<EOF
+# Comments and blank lines are ignored
+
+${DEVKEYS}/firmware_data_key.vbpubk ${TMP}.firmware_data_key.batch
+  ${DEVKEYS}/kernel_data_key.vbpubk	${TMP}.kernel_data_key.batch
+${DEVKEYS}/recovery_kernel_data_key.vbpubk ${TMP}.recovery_kernel_data_key.batch
+EOF
+
+${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/root_key.vbprivk \
+  --flags 7 \
+  --jobs 2 \
+  --batch ${TMP}.manifest > ${TMP}.out
+
+grep -q "^Signed 3 of 3 files$" ${TMP}.out
+for key in firmware_data_key kernel_data_key recovery_kernel_data_key; do
+  cmp ${TMP}.${key}.single ${TMP}.${key}.batch
+done
+
+# One bad entry fails the batch, but the others are still signed
+rm -f ${TMP}.*.batch
+echo "${TMP}.missing ${TMP}.missing.batch" >> ${TMP}.manifest
+if ${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/root_key.vbprivk \
+  --flags 7 \
+  --batch ${TMP}.manifest > ${TMP}.out; then
+  false
+fi
+grep -q "^${TMP}.missing: FAILED$" ${TMP}.out
+grep -q "^Signed 3 of 4 files$" ${TMP}.out
+for key in firmware_data_key kernel_data_key recovery_kernel_data_key; do
+  cmp ${TMP}.${key}.single ${TMP}.${key}.batch
+done
+
+# With --pem_coprocess, one external signer serves every child
+SIGNER="${SRCDIR}/tests/external_rsa_signer.sh"
+PEM_KEY="${SRCDIR}/tests/testkeys/key_rsa4096.pem"
+cat > ${TMP}.signer <<EOF
+#!/bin/sh
+echo "\$*" >> $(pwd)/${TMP}.signer.log
+exec ${SIGNER} "\$@"
+EOF
+chmod +x ${TMP}.signer
+
+${FUTILITY} sign \
+  --pem_signpriv ${PEM_KEY} \
+  --pem_algo 8 \
+  --pem_external ${SIGNER} \
+  --flags 7 \
+  ${DEVKEYS}/firmware_data_key.vbpubk \
+  ${TMP}.pem.single
+
+: > ${TMP}.manifest
+for i in 1 2 3 4 5 6; do
+  echo "${DEVKEYS}/firmware_data_key.vbpubk ${TMP}.pem.${i}.batch" \
+    >> ${TMP}.manifest
+done
+
+rm -f ${TMP}.signer.log
+${FUTILITY} sign \
+  --pem_signpriv ${PEM_KEY} \
+  --pem_algo 8 \
+  --pem_external $(pwd)/${TMP}.signer \
+  --pem_coprocess \
+  --flags 7 \
+  --jobs 3 \
+  --batch ${TMP}.manifest > ${TMP}.out
+
+grep -q "^Signed 6 of 6 files$" ${TMP}.out
+for i in 1 2 3 4 5 6; do
+  cmp ${TMP}.pem.single ${TMP}.pem.${i}.batch
+done
+# Only one signer process was started, as a co-process
+[ "$(wc -l < ${TMP}.signer.log)" -eq 1 ]
+grep -q "^--coprocess " ${TMP}.signer.log
+
+# A PEM key is read by the parent and shared with every child
+rm -f ${TMP}.pem.*.batch
+${FUTILITY} sign \
+  --pem_signpriv ${PEM_KEY} \
+  --pem_algo 8 \
+  --flags 7 \
+  --jobs 3 \
+  --batch ${TMP}.manifest > ${TMP}.out
+
+grep -q "^Signed 6 of 6 files$" ${TMP}.out
+for i in 1 2 3 4 5 6; do
+  cmp ${TMP}.pem.single ${TMP}.pem.${i}.batch
+done
+
+# Input files can't be given both ways
+if ${FUTILITY} sign --batch ${TMP}.manifest ${TMP}.manifest; then false; fi
+
+# --jobs only applies to --batch
+if ${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/root_key.vbprivk \
+  --jobs 2 \
+  ${DEVKEYS}/firmware_data_key.vbpubk ${TMP}.jobs; then
+  false
+fi
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
@@ -104,6 +104,18 @@ ${FUTILITY} --debug sign \
 
 cmp ${TMP}.keyblock4 ${TMP}.keyblock5
 
+# And with the external signer kept running as a co-process
+${FUTILITY} --debug sign \
+  --pem_signpriv ${TESTKEYS}/key_rsa4096.pem \
+  --pem_algo 8 \
+  --pem_external ${SIGNER} \
+  --pem_coprocess \
+  --flags 19 \
+  ${DEVKEYS}/firmware_data_key.vbpubk \
+  ${TMP}.keyblock6
+
+cmp ${TMP}.keyblock4 ${TMP}.keyblock6
+
 
 # cleanup
 rm -rf ${TMP}*
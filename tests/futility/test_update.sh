@@ -232,6 +232,53 @@ test_update "Full update (Preserve VPD using FMAP_AREA_PRESERVE)" \
 	"${FROM_IMAGE}" "${TMP}.expected.full.empty_rw_vpd" \
 	-i "${TO_IMAGE_WIPE_RW_VPD}" --wp=0 --sys_props 0,0x10001,1
 
+test_update "Full update (--verify_written)" \
+	"${FROM_IMAGE}" "${TMP}.expected.full" \
+	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1 --verify_written
+cp -f "${FROM_IMAGE}" "${TMP}.emu"
+msg="$("${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --verify_written 2>&1)"
+grep -q "^INFO: .*: Verified" <<<"${msg}"
+
+test_update "Full update (no changes)" \
+	"${TMP}.expected.full" "${TMP}.expected.full" \
+	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1
+cp -f "${TMP}.expected.full" "${TMP}.emu"
+msg="$("${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 2>&1)"
+grep -qF "No changes on flash, skip writing" <<<"${msg}"
+
+# --plan estimates the update without writing, and only prints JSON to stdout.
+cp -f "${FROM_IMAGE}" "${TMP}.emu"
+"${FUTILITY}" update --emulate "${TMP}.emu" -i "${TO_IMAGE}" --wp=0 \
+	--sys_props 0,0x10001,1 --plan --flash_kbps=64,16 >"${TMP}.plan"
+cmp "${TMP}.emu" "${FROM_IMAGE}"
+[ "$(head -n 1 "${TMP}.plan")" = "{" ]
+[ "$(tail -n 1 "${TMP}.plan")" = "}" ]
+grep -q '"dry_run": true,' "${TMP}.plan"
+grep -q '"erase_kbps": 64,' "${TMP}.plan"
+grep -q '"write_kbps": 16,' "${TMP}.plan"
+grep -q '"plans": 1,' "${TMP}.plan"
+
+test_update "Full update (--flash_kbps invalid)" \
+	"${FROM_IMAGE}" "!Invalid flash speed: 64" \
+	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1 --flash_kbps=64
+
+# --timing writes the report to a file, also when the update fails.
+test_update "Full update (--timing)" \
+	"${FROM_IMAGE}" "${TMP}.expected.full" \
+	-i "${TO_IMAGE}" --wp=0 --sys_props 0,0x10001,1 \
+	--timing="${TMP}.timing"
+grep -q '"dry_run": false,' "${TMP}.timing"
+grep -q '"plans": 1,' "${TMP}.timing"
+
+rm -f "${TMP}.timing"
+test_update "Full update (--timing, incompatible platform)" \
+	"${FROM_IMAGE}" "!platform is not compatible" \
+	-i "${LINK_BIOS}" --wp=0 --sys_props 0,0x10001,1 \
+	--timing="${TMP}.timing"
+grep -q '"total_ms": ' "${TMP}.timing"
+
 
 # Test RW-only update.
 test_update "RW update" \
@@ -482,6 +529,29 @@ test_update "Full update (-a, model=customtip, no VPD, default keys)" \
 	"${FROM_IMAGE}.al" "${LINK_BIOS}" \
 	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=customtip
 
+# Test a compressed tar archive, with entries stored in a different order than
+# the updater reads them, and images larger than --archive_mem.
+test_update "Full update (--archive_mem negative)" \
+	"${FROM_IMAGE}.al" "!Invalid size: -1" \
+	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=link \
+	--archive_mem=-1
+test_update "Full update (--archive_mem overflow)" \
+	"${FROM_IMAGE}.al" "!Invalid size: 0xffffffffffffffff" \
+	-a "${A}" --wp=0 --sys_props 0,0x10001,1,3 --model=link \
+	--archive_mem=0xffffffffffffffff
+tar -czf "${TMP}.archive.tar.gz" -C "${A}" images keyset bin models
+if "${FUTILITY}" update -a "${TMP}.archive.tar.gz" --manifest \
+	>/dev/null 2>&1; then
+	test_update "Full update (--archive tar.gz, model=link)" \
+		"${FROM_IMAGE}.al" "${LINK_BIOS}" \
+		-a "${TMP}.archive.tar.gz" --archive_mem=1 \
+		--wp=0 --sys_props 0,0x10001,1,3 --model=link
+	test_update "Full update (--archive tar.gz, model=peppy)" \
+		"${FROM_IMAGE}.ap" "${PEPPY_BIOS}" \
+		-a "${TMP}.archive.tar.gz" --archive_mem=1 \
+		--wp=0 --sys_props 0,0x10001,1,3 --model=peppy
+fi
+
 # Test special programmer
 if type flashrom >/dev/null 2>&1; then
 	echo "TEST: Full update (dummy programmer)"
@@ -0,0 +1,196 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the firmware updater archive drivers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "test_common.h"
+#include "updater.h"
+
+/* More than the initial 64 hash buckets, so they have to grow. */
+#define NUM_MODELS 300
+
+static char root[] = "/tmp/test_updater_archive.XXXXXX";
+
+/* Names visited by a walk, in order. */
+struct walk_result {
+	char names[NUM_MODELS + 8][64];
+	int count;
+	int stop_after;
+};
+
+static int record_name(const char *path, void *arg)
+{
+	struct walk_result *w = (struct walk_result *)arg;
+
+	if (w->count < ARRAY_SIZE(w->names))
+		snprintf(w->names[w->count], sizeof(w->names[0]), "%s", path);
+	w->count++;
+	return w->stop_after && w->count >= w->stop_after;
+}
+
+/* Returns non-zero if the walk visited names in strcmp order. */
+static int is_sorted(const struct walk_result *w)
+{
+	int i;
+
+	for (i = 1; i < w->count; i++) {
+		if (strcmp(w->names[i - 1], w->names[i]) >= 0)
+			return 0;
+	}
+	return 1;
+}
+
+static int create_file(const char *name)
+{
+	char path[256];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s", root, name);
+	fp = fopen(path, "w");
+	if (!fp)
+		return -1;
+	fputs(name, fp);
+	fclose(fp);
+	return 0;
+}
+
+/* Builds the test archive as a directory. Returns 0 on success. */
+static int create_archive(void)
+{
+	static const char * const names[] = {
+		"image.bin", "keyset.txt", "keyset/rootkey.b",
+		"keyset/rootkey.a", "keyset/vblock_A.b", "models/a/setvars.sh",
+	};
+	char path[256];
+	int i;
+
+	if (!mkdtemp(root))
+		return -1;
+	snprintf(path, sizeof(path), "%s/keyset", root);
+	if (mkdir(path, 0700))
+		return -1;
+	snprintf(path, sizeof(path), "%s/models", root);
+	if (mkdir(path, 0700))
+		return -1;
+	for (i = 0; i < NUM_MODELS; i++) {
+		snprintf(path, sizeof(path), "%s/models/m%d", root, i);
+		if (mkdir(path, 0700))
+			return -1;
+		snprintf(path, sizeof(path), "models/m%d/setvars.sh", i);
+		if (create_file(path))
+			return -1;
+	}
+	snprintf(path, sizeof(path), "%s/models/a", root);
+	if (mkdir(path, 0700))
+		return -1;
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (create_file(names[i]))
+			return -1;
+	}
+	return 0;
+}
+
+static void walk_prefix_tests(struct u_archive *ar, const char *type)
+{
+	struct walk_result *w = calloc(1, sizeof(*w));
+	char name[64];
+	int i, found;
+
+	if (!w)
+		return;
+
+	printf("Testing %s archive.\n", type);
+
+	/* Only names with the prefix, in sorted order. */
+	TEST_SUCC(archive_walk_prefix(ar, "keyset/", w, record_name),
+		  "walk keyset/");
+	TEST_EQ(w->count, 3, "  count");
+	TEST_TRUE(is_sorted(w), "  sorted");
+	TEST_EQ(strcmp(w->names[0], "keyset/rootkey.a"), 0, "  first");
+	TEST_EQ(strcmp(w->names[2], "keyset/vblock_A.b"), 0, "  last");
+
+	/* A prefix which is not a whole directory name. */
+	memset(w, 0, sizeof(*w));
+	TEST_SUCC(archive_walk_prefix(ar, "keyset/rootkey.", w, record_name),
+		  "walk keyset/rootkey.");
+	TEST_EQ(w->count, 2, "  count");
+	TEST_TRUE(is_sorted(w), "  sorted");
+
+	/* Enough names to grow the cache's hash buckets. */
+	memset(w, 0, sizeof(*w));
+	TEST_SUCC(archive_walk_prefix(ar, "models/", w, record_name),
+		  "walk models/");
+	TEST_EQ(w->count, NUM_MODELS + 1, "  count");
+	TEST_TRUE(is_sorted(w), "  sorted");
+	TEST_EQ(strcmp(w->names[0], "models/a/setvars.sh"), 0, "  first");
+	for (i = found = 0; i < NUM_MODELS; i++) {
+		snprintf(name, sizeof(name), "models/m%d/setvars.sh", i);
+		found += archive_has_entry(ar, name);
+	}
+	TEST_EQ(found, NUM_MODELS, "  all entries found");
+	TEST_EQ(archive_has_entry(ar, "models/m/setvars.sh"), 0,
+		"  missing entry");
+
+	/* The callback can stop the walk. */
+	memset(w, 0, sizeof(*w));
+	w->stop_after = 5;
+	TEST_SUCC(archive_walk_prefix(ar, "models/", w, record_name),
+		  "walk models/ stopped");
+	TEST_EQ(w->count, 5, "  count");
+
+	/* Nothing matches. */
+	memset(w, 0, sizeof(*w));
+	TEST_SUCC(archive_walk_prefix(ar, "nothing/", w, record_name),
+		  "walk nothing/");
+	TEST_EQ(w->count, 0, "  count");
+
+	free(w);
+}
+
+int main(int argc, char *argv[])
+{
+	struct u_archive *ar;
+	char cmd[512];
+
+	if (create_archive()) {
+		fprintf(stderr, "Error creating test archive in %s\n", root);
+		return 1;
+	}
+
+	ar = archive_open(root);
+	TEST_PTR_NEQ(ar, NULL, "open directory");
+	if (ar) {
+		walk_prefix_tests(ar, "directory");
+		archive_close(ar);
+	}
+
+#ifdef HAVE_LIBARCHIVE
+	/* The same entries, out of order, in a compressed tar file. */
+	snprintf(cmd, sizeof(cmd), "tar -czf %s.tar.gz -C %s models keyset "
+		 "keyset.txt image.bin", root, root);
+	if (system(cmd) == 0) {
+		snprintf(cmd, sizeof(cmd), "%s.tar.gz", root);
+		ar = archive_open(cmd);
+		TEST_PTR_NEQ(ar, NULL, "open tar.gz");
+		if (ar) {
+			walk_prefix_tests(ar, "tar.gz");
+			archive_close(ar);
+		}
+		unlink(cmd);
+	}
+#endif
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd))
+		fprintf(stderr, "Error removing %s\n", root);
+
+	return !gTestSuccess;
+}
@@ -0,0 +1,221 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the firmware updater's CBFS parser, on crafted CBFS regions.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_common.h"
+#include "updater.h"
+
+#define IMAGE_SIZE 0x2000
+#define CBFS_OFFSET 0x1000
+#define CBFS_SIZE 0x1000
+#define SECTION "COREBOOT"
+
+#define TYPE_RAW 0x50
+#define TYPE_DELETED 0
+#define TAG_COMPRESSION 0x42435a4c
+#define TAG_OTHER 0x4e414d45
+#define LZMA 1
+
+static uint8_t image_data[IMAGE_SIZE];
+static struct firmware_image image = {
+	.data = image_data,
+	.size = IMAGE_SIZE,
+	.fmap_header = (FmapHeader *)image_data,
+};
+static uint8_t *const cbfs = image_data + CBFS_OFFSET;
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* Resets the image to an FMAP with one empty (erased) CBFS section. */
+static void reset_image(void)
+{
+	FmapHeader *fmap = image.fmap_header;
+	FmapAreaHeader *area = (FmapAreaHeader *)(fmap + 1);
+
+	cbfs_free_indexes(&image);
+	memset(image_data, 0xff, sizeof(image_data));
+	memset(fmap, 0, sizeof(*fmap) + sizeof(*area));
+	memcpy(fmap->fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+	fmap->fmap_ver_major = FMAP_VER_MAJOR;
+	fmap->fmap_size = IMAGE_SIZE;
+	fmap->fmap_nareas = 1;
+	area->area_offset = CBFS_OFFSET;
+	area->area_size = CBFS_SIZE;
+	strcpy(area->area_name, SECTION);
+}
+
+/*
+ * Writes a CBFS file header at pos: the name is padded to 16 bytes, followed
+ * by attribute (tag, len) pairs with a 4 byte value each, and the data.
+ * Returns the data offset from the header.
+ */
+static uint32_t add_file(uint32_t pos, const char *name, uint32_t type,
+			 uint32_t len, const uint32_t *attrs, int num_attrs)
+{
+	uint8_t *file = cbfs + pos;
+	uint32_t offset = 24 + 16 + num_attrs * 12;
+	int i;
+
+	memcpy(file, "LARCHIVE", 8);
+	put32(file + 8, len);
+	put32(file + 12, type);
+	put32(file + 16, num_attrs ? 24 + 16 : 0);
+	put32(file + 20, offset);
+	memset(file + 24, 0, 16);
+	strcpy((char *)file + 24, name);
+	for (i = 0; i < num_attrs; i++) {
+		put32(file + 40 + i * 12, attrs[2 * i]);
+		put32(file + 44 + i * 12, attrs[2 * i + 1]);
+		put32(file + 48 + i * 12, LZMA);
+	}
+	memset(file + offset, 0x5a, len);
+	return offset;
+}
+
+static void index_tests(void)
+{
+	const uint32_t compressed[] = {TAG_COMPRESSION, 12};
+	const uint32_t other_first[] = {TAG_OTHER, 12, TAG_COMPRESSION, 12};
+	FmapAreaHeader *area = (FmapAreaHeader *)(image.fmap_header + 1);
+	struct cbfs_index index;
+	const struct cbfs_entry *e;
+	uint32_t offset;
+
+	/* Well-formed files, with a deleted one. */
+	reset_image();
+	offset = add_file(0, "raw", TYPE_RAW, 10, NULL, 0);
+	add_file(64, "gone", TYPE_DELETED, 10, NULL, 0);
+	add_file(128, "lzma", TYPE_RAW, 100, compressed, 1);
+	add_file(320, "second_attr", TYPE_RAW, 4, other_first, 2);
+	TEST_SUCC(cbfs_load_index(&index, &image, SECTION), "load index");
+	TEST_EQ(index.num_entries, 3, "  deleted file skipped");
+	e = cbfs_find_entry(&index, "raw");
+	TEST_PTR_NEQ(e, NULL, "  raw file");
+	if (e) {
+		TEST_PTR_EQ(e->data, cbfs + offset, "  raw data");
+		TEST_EQ(e->size, 10, "  raw size");
+		TEST_EQ(e->type, TYPE_RAW, "  raw type");
+		TEST_EQ(e->compression, 0, "  raw not compressed");
+	}
+	TEST_PTR_EQ(cbfs_find_entry(&index, "gone"), NULL, "  deleted file");
+	e = cbfs_find_entry(&index, "lzma");
+	TEST_TRUE(e && e->compression == LZMA, "  compressed file");
+	e = cbfs_find_entry(&index, "second_attr");
+	TEST_TRUE(e && e->compression == LZMA, "  compression attr second");
+	cbfs_free_index(&index);
+
+	/* Missing section. */
+	TEST_NEQ(cbfs_load_index(&index, &image, "NOTHING"), 0,
+		 "missing section");
+
+	/* A header that doesn't fit in the region ends the walk. */
+	reset_image();
+	area->area_size = CBFS_SIZE - 48;
+	add_file(0, "raw", TYPE_RAW, CBFS_SIZE - 64 - 40, NULL, 0);
+	memcpy(cbfs + CBFS_SIZE - 64, "LARCHIVE", 8);
+	TEST_SUCC(cbfs_load_index(&index, &image, SECTION),
+		  "truncated header");
+	TEST_EQ(index.num_entries, 1, "  files before it kept");
+	cbfs_free_index(&index);
+
+	/* Offsets or lengths past the region end the walk. */
+	reset_image();
+	add_file(0, "raw", TYPE_RAW, 10, NULL, 0);
+	add_file(64, "huge", TYPE_RAW, 10, NULL, 0);
+	put32(cbfs + 64 + 8, 0xfffffff0);
+	TEST_SUCC(cbfs_load_index(&index, &image, SECTION), "length overflow");
+	TEST_EQ(index.num_entries, 1, "  files before it kept");
+	cbfs_free_index(&index);
+
+	reset_image();
+	add_file(0, "far", TYPE_RAW, 10, NULL, 0);
+	put32(cbfs + 20, 0xffffffe0);
+	TEST_SUCC(cbfs_load_index(&index, &image, SECTION), "offset overflow");
+	TEST_EQ(index.num_entries, 0, "  file dropped");
+	cbfs_free_index(&index);
+
+	reset_image();
+	add_file(0, "noname", TYPE_RAW, 10, NULL, 0);
+	memset(cbfs + 24, 'x', 16);
+	TEST_SUCC(cbfs_load_index(&index, &image, SECTION),
+		  "unterminated name");
+	TEST_EQ(index.num_entries, 0, "  file dropped");
+	cbfs_free_index(&index);
+
+	/* Attribute chains which loop or overrun are ignored. */
+	reset_image();
+	add_file(0, "loop", TYPE_RAW, 10, compressed, 1);
+	put32(cbfs + 44, 0);
+	add_file(64, "oversized", TYPE_RAW, 10, compressed, 1);
+	put32(cbfs + 64 + 44, 0x1000);
+	TEST_SUCC(cbfs_load_index(&index, &image, SECTION), "bad attributes");
+	TEST_EQ(index.num_entries, 2, "  files kept");
+	e = cbfs_find_entry(&index, "loop");
+	TEST_TRUE(e && !e->compression, "  looping chain");
+	e = cbfs_find_entry(&index, "oversized");
+	TEST_TRUE(e && !e->compression, "  oversized attribute");
+	cbfs_free_index(&index);
+}
+
+static void find_file_tests(void)
+{
+	const uint32_t compressed[] = {TAG_COMPRESSION, 12};
+	const struct cbfs_index *index;
+	struct firmware_section file;
+	uint32_t offset;
+
+	reset_image();
+	offset = add_file(0, "raw", TYPE_RAW, 10, NULL, 0);
+	add_file(64, "gone", TYPE_DELETED, 10, NULL, 0);
+	add_file(128, "lzma", TYPE_RAW, 100, compressed, 1);
+
+	TEST_EQ(cbfs_find_file(&image, SECTION, "raw", &file), 0,
+		"find raw file");
+	TEST_PTR_EQ(file.data, cbfs + offset, "  data");
+	TEST_EQ(file.size, 10, "  size");
+	TEST_EQ(cbfs_find_file(&image, SECTION, "lzma", &file), 1,
+		"find compressed file");
+	TEST_PTR_EQ(file.data, NULL, "  no data");
+	TEST_EQ(cbfs_find_file(&image, SECTION, "gone", &file), -1,
+		"find deleted file");
+	TEST_EQ(cbfs_find_file(&image, "NOTHING", "raw", &file), -1,
+		"find in missing section");
+	TEST_EQ(cbfs_file_exists(&image, SECTION, "lzma"), 1, "exists");
+	TEST_EQ(cbfs_file_exists(&image, SECTION, "gone"), 0, "not exists");
+
+	/* The index is kept with the image until it is freed. */
+	index = cbfs_get_index(&image, SECTION);
+	TEST_PTR_NEQ(index, NULL, "index kept");
+	TEST_PTR_EQ(cbfs_get_index(&image, SECTION), index, "  reused");
+	TEST_PTR_EQ(cbfs_get_index(&image, "NOTHING"), NULL,
+		    "  missing section");
+	add_file(320, "new", TYPE_RAW, 10, NULL, 0);
+	TEST_EQ(cbfs_file_exists(&image, SECTION, "new"), 0,
+		"  not walked again");
+	cbfs_free_indexes(&image);
+	TEST_PTR_EQ(image.cbfs_indexes, NULL, "  freed");
+	TEST_EQ(cbfs_file_exists(&image, SECTION, "new"), 1,
+		"  walked again once freed");
+	cbfs_free_indexes(&image);
+}
+
+int main(int argc, char *argv[])
+{
+	index_tests();
+	find_file_tests();
+
+	return !gTestSuccess;
+}
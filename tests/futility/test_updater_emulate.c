@@ -0,0 +1,141 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for writing the system firmware in the firmware updater, using an
+ * emulation file behind a symbolic link.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_misc.h"
+#include "test_common.h"
+#include "updater.h"
+
+#define IMAGE_SIZE 0x1000
+#define ID_SIZE 0x40
+
+static char root[] = "/tmp/test_updater_emulate.XXXXXX";
+static char flash[64], link_path[64], new_path[64];
+
+/* Writes an image with RO_FRID, RW_FWID_A and RW_FWID_B set to id. */
+static int create_image(const char *path, const char *id, mode_t mode)
+{
+	static const char * const names[] = {
+		"RO_FRID", "RW_FWID_A", "RW_FWID_B",
+	};
+	uint8_t data[IMAGE_SIZE];
+	FmapHeader *fmap = (FmapHeader *)data;
+	FmapAreaHeader *area = (FmapAreaHeader *)(fmap + 1);
+	int i;
+
+	memset(data, 0xff, sizeof(data));
+	memset(fmap, 0, sizeof(*fmap) + ARRAY_SIZE(names) * sizeof(*area));
+	memcpy(fmap->fmap_signature, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE);
+	fmap->fmap_ver_major = FMAP_VER_MAJOR;
+	fmap->fmap_size = IMAGE_SIZE;
+	fmap->fmap_nareas = ARRAY_SIZE(names);
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		area[i].area_offset = 0x100 * (i + 1);
+		area[i].area_size = ID_SIZE;
+		strcpy(area[i].area_name, names[i]);
+		memset(data + area[i].area_offset, 0, ID_SIZE);
+		strcpy((char *)data + area[i].area_offset, id);
+	}
+	if (vb2_write_file(path, data, sizeof(data)) != VB2_SUCCESS)
+		return -1;
+	return chmod(path, mode);
+}
+
+/* Returns non-zero if the file at path has the same data as image. */
+static int has_data(const char *path, const struct firmware_image *image)
+{
+	uint8_t *data;
+	uint32_t size;
+	int same;
+
+	if (vb2_read_file(path, &data, &size) != VB2_SUCCESS)
+		return 0;
+	same = size == image->size && !memcmp(data, image->data, size);
+	free(data);
+	return same;
+}
+
+static void write_tests(void)
+{
+	const char * const sections[] = {"RW_FWID_A", NULL};
+	struct updater_config *cfg;
+	struct stat st;
+
+	cfg = updater_new_config();
+	cfg->emulation = link_path;
+
+	/* The emulated flash is mapped, and unmapped by the updater. */
+	TEST_SUCC(load_firmware_image(&cfg->image_current, link_path, NULL),
+		  "load emulated flash");
+	TEST_EQ(cfg->image_current.is_mapped, 1, "  mapped");
+	TEST_SUCC(unmap_firmware_image(&cfg->image_current), "unmap");
+	TEST_EQ(cfg->image_current.is_mapped, 0, "  not mapped");
+	TEST_TRUE(firmware_section_exists(&cfg->image_current, "RW_FWID_B"),
+		  "  FMAP moved");
+	TEST_EQ(strcmp(cfg->image_current.rw_version_a, "old"), 0,
+		"  version kept");
+
+	/* Writing a section changes only that section. */
+	TEST_SUCC(load_firmware_image(&cfg->image, new_path, NULL),
+		  "load new image");
+	TEST_SUCC(write_system_firmware(cfg, &cfg->image, sections),
+		  "write a section");
+	TEST_EQ(lstat(link_path, &st), 0, "  lstat");
+	TEST_TRUE(S_ISLNK(st.st_mode), "  link kept");
+	TEST_EQ(stat(flash, &st), 0, "  stat");
+	TEST_EQ(st.st_mode & 0777, 0640, "  mode kept");
+	TEST_TRUE(has_data(flash, &cfg->image_current), "  flash written");
+	TEST_EQ(memcmp(cfg->image_current.data + 0x200,
+		       cfg->image.data + 0x200, ID_SIZE), 0, "  section new");
+	TEST_NEQ(memcmp(cfg->image_current.data + 0x300,
+			cfg->image.data + 0x300, ID_SIZE), 0, "  others old");
+
+	/* Writing the whole image. */
+	TEST_SUCC(write_system_firmware(cfg, &cfg->image, NULL),
+		  "write whole image");
+	TEST_TRUE(has_data(flash, &cfg->image), "  flash written");
+	TEST_EQ(lstat(link_path, &st), 0, "  lstat");
+	TEST_TRUE(S_ISLNK(st.st_mode), "  link kept");
+
+	updater_delete_config(cfg);
+}
+
+int main(int argc, char *argv[])
+{
+	char cmd[128];
+
+	if (!mkdtemp(root)) {
+		fprintf(stderr, "Error creating %s\n", root);
+		return 1;
+	}
+	snprintf(flash, sizeof(flash), "%s/flash.bin", root);
+	snprintf(link_path, sizeof(link_path), "%s/emu.bin", root);
+	snprintf(new_path, sizeof(new_path), "%s/new.bin", root);
+	/* The flash is written in place, so the directory can be read-only. */
+	if (create_image(flash, "old", 0640) ||
+	    create_image(new_path, "new", 0644) ||
+	    symlink("flash.bin", link_path) || chmod(root, 0555)) {
+		fprintf(stderr, "Error creating test files in %s\n", root);
+		return 1;
+	}
+
+	write_tests();
+
+	if (chmod(root, 0700))
+		fprintf(stderr, "Error restoring mode of %s\n", root);
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd))
+		fprintf(stderr, "Error removing %s\n", root);
+
+	return !gTestSuccess;
+}
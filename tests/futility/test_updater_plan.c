@@ -0,0 +1,285 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for planning and verifying firmware updater flash writes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_common.h"
+#include "updater.h"
+
+#define BLOCK_SIZE 16
+#define IMAGE_SIZE (8 * BLOCK_SIZE)
+
+static uint8_t from_data[IMAGE_SIZE], to_data[IMAGE_SIZE];
+static struct firmware_image image_from = {
+	.data = from_data,
+	.size = IMAGE_SIZE,
+};
+static struct firmware_image image_to = {
+	.data = to_data,
+	.size = IMAGE_SIZE,
+};
+
+/* Sections of the test images; A and B overlap. */
+static const struct {
+	const char *name;
+	uint32_t offset, size;
+} test_sections[] = {
+	{"A", 8, 32},
+	{"B", 32, 40},
+	{"C", 96, 32},
+};
+
+/* Mock of the FMAP lookup, so only updater_plan.c is tested. */
+int find_firmware_section(struct firmware_section *section,
+			  const struct firmware_image *image,
+			  const char *section_name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(test_sections); i++) {
+		if (strcmp(section_name, test_sections[i].name))
+			continue;
+		section->data = image->data + test_sections[i].offset;
+		section->size = test_sections[i].size;
+		return 0;
+	}
+	return -1;
+}
+
+static void reset_images(void)
+{
+	memset(from_data, 0xa5, sizeof(from_data));
+	memset(to_data, 0xa5, sizeof(to_data));
+}
+
+static void plan_tests(void)
+{
+	const char * const ab[] = {"A", "B", NULL};
+	const char * const bad[] = {"A", "Z", NULL};
+	struct firmware_image small = image_to;
+	struct flash_write_plan plan;
+
+	reset_images();
+	TEST_SUCC(plan_flash_write(&plan, &image_from, &image_to, NULL,
+				   BLOCK_SIZE), "No changes");
+	TEST_EQ(plan.num_ranges, 0, "  no ranges");
+	TEST_EQ(plan.bytes_total, IMAGE_SIZE, "  bytes total");
+	TEST_EQ(plan.bytes_changed, 0, "  bytes changed");
+	TEST_EQ(plan.bytes_written, 0, "  bytes written");
+	free_flash_write_plan(&plan);
+
+	/* Only clearing bits: adjacent blocks merge, nothing is erased. */
+	reset_images();
+	to_data[BLOCK_SIZE + 1] = 0x21;
+	to_data[2 * BLOCK_SIZE + 3] = 0x00;
+	TEST_SUCC(plan_flash_write(&plan, &image_from, &image_to, NULL,
+				   BLOCK_SIZE), "Clear bits");
+	TEST_EQ(plan.num_ranges, 1, "  ranges merged");
+	TEST_EQ(plan.ranges[0].offset, BLOCK_SIZE, "  offset");
+	TEST_EQ(plan.ranges[0].size, 2 * BLOCK_SIZE, "  size");
+	TEST_EQ(plan.ranges[0].erase, 0, "  no erase");
+	TEST_EQ(plan.blocks_erased, 0, "  blocks erased");
+	TEST_EQ(plan.bytes_changed, 2 * BLOCK_SIZE, "  bytes changed");
+	TEST_EQ(plan.bytes_written, 2, "  bytes written");
+	free_flash_write_plan(&plan);
+
+	/* Setting a bit needs an erase, and is not merged with a write. */
+	reset_images();
+	to_data[BLOCK_SIZE] = 0x00;
+	to_data[2 * BLOCK_SIZE] = 0xa7;
+	to_data[2 * BLOCK_SIZE + 1] = 0xff;
+	TEST_SUCC(plan_flash_write(&plan, &image_from, &image_to, NULL,
+				   BLOCK_SIZE), "Set bits");
+	TEST_EQ(plan.num_ranges, 2, "  ranges");
+	TEST_EQ(plan.ranges[0].erase, 0, "  first range writes");
+	TEST_EQ(plan.ranges[1].offset, 2 * BLOCK_SIZE, "  second offset");
+	TEST_EQ(plan.ranges[1].size, BLOCK_SIZE, "  second size");
+	TEST_EQ(plan.ranges[1].erase, 1, "  second range erases");
+	TEST_EQ(plan.blocks_erased, 1, "  blocks erased");
+	/* The erased block is written again, except the 0xff bytes. */
+	TEST_EQ(plan.bytes_written, 1 + BLOCK_SIZE - 1, "  bytes written");
+	free_flash_write_plan(&plan);
+
+	/* Overlapping sections merge; changes outside them are ignored. */
+	reset_images();
+	to_data[0] = 0x00;
+	to_data[8] = 0x00;
+	to_data[70] = 0x00;
+	to_data[100] = 0x00;
+	TEST_SUCC(plan_flash_write(&plan, &image_from, &image_to, ab,
+				   BLOCK_SIZE), "Sections");
+	TEST_EQ(plan.bytes_total, 72 - 8, "  bytes total");
+	TEST_EQ(plan.num_ranges, 2, "  ranges");
+	TEST_EQ(plan.ranges[0].offset, 8, "  starts at section");
+	TEST_EQ(plan.ranges[0].size, BLOCK_SIZE - 8, "  partial block");
+	TEST_EQ(plan.ranges[1].offset, 4 * BLOCK_SIZE, "  second offset");
+	TEST_EQ(plan.ranges[1].size, 72 - 4 * BLOCK_SIZE,
+		"  ends at section");
+
+	/* Applying the plan makes the sections the same. */
+	apply_flash_write_plan(&plan, &image_from, &image_to);
+	TEST_EQ(memcmp(from_data + 8, to_data + 8, 72 - 8), 0,
+		"Apply plan");
+	TEST_NEQ(from_data[0], to_data[0], "  outside sections untouched");
+	free_flash_write_plan(&plan);
+
+	TEST_NEQ(plan_flash_write(&plan, &image_from, &image_to, bad,
+				  BLOCK_SIZE), 0, "Unknown section");
+	small.size = IMAGE_SIZE - 1;
+	TEST_NEQ(plan_flash_write(&plan, &image_from, &small, NULL,
+				  BLOCK_SIZE), 0, "Different sizes");
+}
+
+static void estimate_tests(void)
+{
+	struct flash_write_plan plan = {
+		.block_size = 4096,
+		.blocks_erased = 2,
+		.bytes_written = 2048,
+	};
+	struct flash_speed speed = {
+		.erase_kbps = 8,
+		.write_kbps = 2,
+	};
+
+	TEST_EQ(estimate_flash_write_ms(&plan, &speed), 1000 + 1000,
+		"Estimate erase and write");
+	plan.blocks_erased = 0;
+	plan.bytes_written = 0;
+	TEST_EQ(estimate_flash_write_ms(&plan, &speed), 0, "Estimate nothing");
+}
+
+static void verify_tests(void)
+{
+	const char * const ab[] = {"A", "B", NULL};
+	struct firmware_image small = image_to;
+	struct flash_write_plan plan;
+	struct flash_verify_chunk *chunks;
+	uint8_t flash[IMAGE_SIZE];
+	int i, count;
+
+	/* Only the changed blocks are read back, split into chunks. */
+	reset_images();
+	to_data[0] = 0x00;
+	to_data[8] = 0x00;
+	to_data[20] = 0x00;
+	to_data[70] = 0x00;
+	TEST_SUCC(plan_flash_write(&plan, &image_from, &image_to, ab,
+				   BLOCK_SIZE), "Plan to verify");
+	count = plan_flash_verify(&chunks, &plan, &image_from, &image_to,
+				  BLOCK_SIZE);
+	TEST_EQ(count, 3, "Verify chunks");
+	TEST_EQ(chunks[0].offset, 0, "  whole first block");
+	TEST_EQ(chunks[0].size, BLOCK_SIZE, "  chunk size");
+	TEST_EQ(chunks[1].offset, BLOCK_SIZE, "  second chunk");
+	TEST_EQ(chunks[2].offset, 4 * BLOCK_SIZE, "  last block");
+	TEST_EQ(chunks[2].size, BLOCK_SIZE, "  last block size");
+
+	/* The flash after writing: image_to in the plan, image_from out. */
+	memcpy(flash, from_data, sizeof(flash));
+	for (i = 0; i < plan.num_ranges; i++)
+		memcpy(flash + plan.ranges[i].offset,
+		       to_data + plan.ranges[i].offset, plan.ranges[i].size);
+	for (i = 0; i < count; i++)
+		TEST_SUCC(verify_flash_chunk(&chunks[i],
+					     flash + chunks[i].offset),
+			  "  chunk verified");
+
+	/* Bytes of the written blocks outside the plan are checked too. */
+	flash[4 * BLOCK_SIZE + 11] ^= 0x01;
+	TEST_NEQ(verify_flash_chunk(&chunks[2], flash + chunks[2].offset), 0,
+		 "  mismatch outside the plan");
+	flash[BLOCK_SIZE + 4] ^= 0x10;
+	TEST_NEQ(verify_flash_chunk(&chunks[1], flash + chunks[1].offset), 0,
+		 "  mismatch in the plan");
+	free(chunks);
+
+	/* Blocks next to each other are read in larger chunks. */
+	count = plan_flash_verify(&chunks, &plan, &image_from, &image_to,
+				  4 * BLOCK_SIZE);
+	TEST_EQ(count, 2, "Larger chunks");
+	TEST_EQ(chunks[0].size, 2 * BLOCK_SIZE, "  blocks merged");
+	free(chunks);
+
+	small.size = IMAGE_SIZE - 1;
+	TEST_EQ(plan_flash_verify(&chunks, &plan, &image_from, &small,
+				  BLOCK_SIZE), -1, "Different sizes");
+	free_flash_write_plan(&plan);
+}
+
+static void json_tests(void)
+{
+	char file_name[] = "/tmp/test_updater_plan.XXXXXX";
+	struct updater_config cfg = {0};
+	struct flash_write_plan plan = {
+		.block_size = 4096,
+		.bytes_changed = 8192,
+		.blocks_erased = 1,
+		.bytes_written = 100,
+	};
+	char buf[4096];
+	size_t len;
+	FILE *fp;
+	int fd;
+
+	fd = mkstemp(file_name);
+	TEST_TRUE(fd >= 0, "Create JSON file");
+	if (fd < 0)
+		return;
+	close(fd);
+
+	cfg.dry_run = 1;
+	cfg.flash_speed.erase_kbps = 4;
+	cfg.flash_speed.write_kbps = 1;
+	cfg.timing.start_us = updater_timing_now();
+	updater_timing_add_plan(&cfg, &plan);
+	updater_timing_record(&cfg, STAGE_COMPARE, updater_timing_now(), 123);
+	TEST_SUCC(updater_write_json_timing(&cfg, file_name),
+		  "Write JSON timing");
+
+	fp = fopen(file_name, "r");
+	len = fp ? fread(buf, 1, sizeof(buf) - 1, fp) : 0;
+	buf[len] = '\0';
+	if (fp)
+		fclose(fp);
+	unlink(file_name);
+
+	TEST_TRUE(len > 2 && buf[0] == '{' && !strcmp(buf + len - 2, "}\n"),
+		  "  one object");
+	TEST_PTR_NEQ(strstr(buf, "\"dry_run\": true,"), NULL, "  dry_run");
+	TEST_PTR_NEQ(strstr(buf, "\"total_ms\": "), NULL, "  total_ms");
+	TEST_PTR_NEQ(strstr(buf, "\"archive\": { \"count\": 0, "), NULL,
+		     "  first stage");
+	TEST_PTR_NEQ(strstr(buf, "\"compare\": { \"count\": 1, \"ms\": 0, "
+			    "\"bytes\": 123 },"), NULL, "  compare stage");
+	TEST_PTR_NEQ(strstr(buf, "\"verify\": { \"count\": 0, \"ms\": 0, "
+			    "\"bytes\": 0 }\n  },"), NULL, "  last stage");
+	TEST_PTR_NEQ(strstr(buf, "\"erase_kbps\": 4,"), NULL, "  erase_kbps");
+	TEST_PTR_NEQ(strstr(buf, "\"plans\": 1,"), NULL, "  plans");
+	TEST_PTR_NEQ(strstr(buf, "\"bytes_changed\": 8192,"), NULL,
+		     "  bytes_changed");
+	TEST_PTR_NEQ(strstr(buf, "\"blocks_erased\": 1,"), NULL,
+		     "  blocks_erased");
+	TEST_PTR_NEQ(strstr(buf, "\"bytes_written\": 100,"), NULL,
+		     "  bytes_written");
+	/* 4 KiB erased at 4 KiB/s, and 100 bytes written at 1 KiB/s */
+	TEST_PTR_NEQ(strstr(buf, "\"estimated_ms\": 1097\n  }\n}\n"), NULL,
+		     "  estimated_ms");
+}
+
+int main(int argc, char *argv[])
+{
+	plan_tests();
+	estimate_tests();
+	verify_tests();
+	json_tests();
+
+	return !gTestSuccess;
+}
@@ -0,0 +1,124 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for prefetching the system firmware in the firmware updater, using
+ * an emulated flash read.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_misc.h"
+#include "test_common.h"
+#include "updater.h"
+
+#define IMAGE_SIZE 4096
+
+static uint8_t flash_data[IMAGE_SIZE];
+static char emulation[] = "/tmp/test_updater_prefetch.XXXXXX";
+static char output[] = "/tmp/test_updater_prefetch.XXXXXX";
+static int output_fd = -1, saved_stderr = -1;
+
+/* Sends stderr to the output file, so it can be checked. */
+static void capture_stderr(void)
+{
+	fflush(stderr);
+	saved_stderr = dup(STDERR_FILENO);
+	if (!ftruncate(output_fd, 0) && !lseek(output_fd, 0, SEEK_SET))
+		dup2(output_fd, STDERR_FILENO);
+}
+
+static void restore_stderr(void)
+{
+	fflush(stderr);
+	dup2(saved_stderr, STDERR_FILENO);
+	close(saved_stderr);
+}
+
+/* Returns non-zero if the captured stderr contains text. */
+static int captured(const char *text)
+{
+	uint8_t *data;
+	uint32_t size;
+	int found;
+
+	fflush(stderr);
+	if (vb2_read_file(output, &data, &size) != VB2_SUCCESS)
+		return 0;
+	found = strstr((char *)data, text) != NULL;
+	free(data);
+	return found;
+}
+
+static void prefetch_tests(void)
+{
+	struct updater_config *cfg;
+	int r, found_early, found_late;
+
+	/* The prefetched image is what the flash (emulation file) holds. */
+	cfg = updater_new_config();
+	cfg->emulation = emulation;
+	TEST_SUCC(prefetch_system_firmware(cfg), "prefetch started");
+	TEST_PTR_NEQ(cfg->prefetch, NULL, "  in progress");
+	load_system_firmware(cfg, &cfg->image_current);
+	TEST_PTR_EQ(cfg->prefetch, NULL, "  taken");
+	TEST_EQ(cfg->image_current.size, IMAGE_SIZE, "  image size");
+	TEST_TRUE(cfg->image_current.data &&
+		  !memcmp(cfg->image_current.data, flash_data, IMAGE_SIZE),
+		  "  image data");
+	updater_delete_config(cfg);
+
+	/* What the reader prints only shows up once it is collected. */
+	cfg = updater_new_config();
+	cfg->emulation = "/nonexistent/flash";
+	capture_stderr();
+	r = prefetch_system_firmware(cfg);
+	/* Give the child time to fail, to show its output was held. */
+	sleep(1);
+	found_early = captured("Failed to read /nonexistent/flash");
+	wait_system_firmware_prefetch(cfg);
+	found_late = captured("Failed to read /nonexistent/flash");
+	restore_stderr();
+	TEST_SUCC(r, "failing prefetch started");
+	TEST_EQ(found_early, 0, "  output held by the reader");
+	TEST_EQ(found_late, 1, "  output replayed when collected");
+
+	/* A failed prefetch is read again when needed. */
+	capture_stderr();
+	r = load_system_firmware(cfg, &cfg->image_current);
+	restore_stderr();
+	TEST_NEQ(r, 0, "  read again, and failed");
+	TEST_PTR_EQ(cfg->prefetch, NULL, "  prefetch taken");
+	updater_delete_config(cfg);
+}
+
+int main(int argc, char *argv[])
+{
+	int fd, i;
+
+	for (i = 0; i < IMAGE_SIZE; i++)
+		flash_data[i] = i * 7;
+	fd = mkstemp(emulation);
+	if (fd < 0 || write(fd, flash_data, IMAGE_SIZE) != IMAGE_SIZE) {
+		fprintf(stderr, "Error creating %s\n", emulation);
+		return 1;
+	}
+	close(fd);
+	output_fd = mkstemp(output);
+	if (output_fd < 0) {
+		fprintf(stderr, "Error creating %s\n", output);
+		return 1;
+	}
+
+	prefetch_tests();
+
+	close(output_fd);
+	unlink(output);
+	unlink(emulation);
+
+	return !gTestSuccess;
+}
@@ -316,6 +316,31 @@ $CGPT show $MTD ${DEV} | grep -q INVALID
 $CGPT repair $MTD ${DEV}
 ($CGPT show $MTD ${DEV} | grep -q INVALID) && error
 
+echo "Test cgpt batch command..."
+$CGPT batch $MTD ${DEV} <<EOF
+# Comments and empty lines are skipped.
+
+add -i 1 -P 9
+add -i 1 -l "batch label"
+EOF
+X=$($CGPT show $MTD -P -i 1 ${DEV})
+Y=$($CGPT show $MTD -l -i 1 ${DEV})
+[ "$X $Y" = "9 batch label" ] || error
+# Nothing is written if any command fails.
+printf 'add -i 1 -P 3\nadd -i 1 -s 7\n' > batch.txt
+assert_fail $CGPT batch $MTD -f batch.txt ${DEV}
+X=$($CGPT show $MTD -P -i 1 ${DEV})
+[ "$X" = "9" ] || error
+assert_fail $CGPT batch $MTD ${DEV} <<< "batch"
+# Option parsing starts over after a command stops in the middle of its
+# options.
+$CGPT batch $MTD ${DEV} >/dev/null <<EOF
+show -hq
+add -i 1 -P 5
+EOF
+X=$($CGPT show $MTD -P -i 1 ${DEV})
+[ "$X" = "5" ] || error
+
 echo "Test with IGNOREME primary GPT..."
 $CGPT create $MTD ${DEV}
 $CGPT legacy $MTD -p ${DEV}
@@ -336,6 +361,20 @@ $CGPT create $MTD ${DEV}
 $CGPT legacy $MTD -p ${DEV}
 run_prioritize_tests 2>/dev/null
 
+echo "Test that sparse images stay sparse..."
+SPARSE_DEV=sparse_dev.bin
+rm -f ${SPARSE_DEV}
+truncate -s 8G ${SPARSE_DEV}
+# Only the blocks holding the PMBR and GPT headers should be allocated, far
+# less than writing the zeroed partition tables would take (40 KiB).
+$CGPT create ${SPARSE_DEV}
+X=$(($(stat -c "%b * %B" ${SPARSE_DEV})))
+[ "${X}" -le $((24 * 1024)) ] || error "${X} bytes allocated"
+$CGPT create -z ${SPARSE_DEV}
+X=$(($(stat -c "%b * %B" ${SPARSE_DEV})))
+[ "${X}" -le $((24 * 1024)) ] || error "${X} bytes allocated"
+rm -f ${SPARSE_DEV}
+
 # Now make sure that we don't need write access if we're just looking.
 echo "Test read vs read-write access..."
 chmod 0444 ${DEV}
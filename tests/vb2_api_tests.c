@@ -662,6 +662,7 @@ static void init_hash_tests(void)
 	wb_used_before = sd->workbuf_used;
 	TEST_SUCC(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY),
 		  "init hash good");
+	TEST_EQ(sd->timing_count, 1, "hash timing started");
 	TEST_EQ(sd->hash_offset, wb_used_before, "hash context offset");
 	TEST_EQ(sd->hash_size, sizeof(struct vb2_digest_context),
 		"hash context size");
@@ -679,15 +680,18 @@ static void init_hash_tests(void)
 	reset_common_data(FOR_MISC);
 	TEST_EQ(vb2api_init_hash(ctx, VB2_HASH_TAG_INVALID),
 		VB2_ERROR_API_INIT_HASH_TAG, "init hash invalid tag");
+	TEST_EQ(sd->timing_count, 0, "  no timing event");
 
 	reset_common_data(FOR_MISC);
 	sd->preamble_size = 0;
 	TEST_EQ(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY),
 		VB2_ERROR_API_INIT_HASH_PREAMBLE, "init hash preamble");
+	TEST_EQ(sd->timing_count, 0, "  no timing event");
 
 	reset_common_data(FOR_MISC);
 	TEST_EQ(vb2api_init_hash(ctx, VB2_HASH_TAG_FW_BODY + 1),
 		VB2_ERROR_API_INIT_HASH_TAG, "init hash unknown tag");
+	TEST_EQ(sd->timing_count, 0, "  no timing event");
 
 	reset_common_data(FOR_MISC);
 	sd->workbuf_used = sd->workbuf_size + VB2_WORKBUF_ALIGN -
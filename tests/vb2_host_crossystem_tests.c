@@ -0,0 +1,119 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for the crossystem snapshot of VbSharedData and NV storage.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "2api.h"
+#include "2common.h"
+#include "2nvstorage.h"
+#include "crossystem.h"
+#include "crossystem_arch.h"
+#include "test_common.h"
+#include "vboot_struct.h"
+
+/* Mock data */
+static uint32_t mock_fw_version_tpm;
+static int mock_vdat_reads;
+static uint8_t mock_nvdata[VB2_NVDATA_SIZE];
+static int mock_nv_reads;
+static int mock_nv_writes;
+
+/* Mocked functions */
+
+VbSharedDataHeader *VbSharedDataRead(void)
+{
+	VbSharedDataHeader *sh = calloc(1, sizeof(*sh));
+
+	mock_vdat_reads++;
+	if (sh) {
+		sh->magic = VB_SHARED_DATA_MAGIC;
+		sh->struct_version = VB_SHARED_DATA_VERSION;
+		sh->fw_version_tpm = mock_fw_version_tpm;
+	}
+	return sh;
+}
+
+int vb2_read_nv_storage(struct vb2_context *ctx)
+{
+	mock_nv_reads++;
+	memcpy(ctx->nvdata, mock_nvdata, sizeof(mock_nvdata));
+	return 0;
+}
+
+int vb2_write_nv_storage(struct vb2_context *ctx)
+{
+	mock_nv_writes++;
+	memcpy(mock_nvdata, ctx->nvdata, sizeof(mock_nvdata));
+	return 0;
+}
+
+/* Tests */
+
+static void vdat_tests(void)
+{
+	VbInvalidateSystemPropertyCache();
+	mock_vdat_reads = 0;
+
+	mock_fw_version_tpm = 0x10001;
+	TEST_EQ(VbGetSystemPropertyInt("tpm_fwver"), 0x10001, "tpm_fwver");
+	mock_fw_version_tpm = 0x20002;
+	TEST_EQ(VbGetSystemPropertyInt("tpm_fwver"), 0x10001,
+		"  snapshot kept");
+	TEST_EQ(mock_vdat_reads, 1, "  read once");
+
+	VbInvalidateSystemPropertyCache();
+	TEST_EQ(VbGetSystemPropertyInt("tpm_fwver"), 0x20002,
+		"  read again after invalidation");
+	TEST_EQ(mock_vdat_reads, 2, "  read twice");
+
+	/* Setting a property drops the snapshot. */
+	mock_fw_version_tpm = 0x30003;
+	TEST_SUCC(VbSetSystemPropertyInt("fw_try_count", 1), "set property");
+	TEST_EQ(VbGetSystemPropertyInt("tpm_fwver"), 0x30003,
+		"  read again after set");
+}
+
+static void nv_tests(void)
+{
+	VbInvalidateSystemPropertyCache();
+	memset(mock_nvdata, 0, sizeof(mock_nvdata));
+	TEST_SUCC(VbSetSystemPropertyInt("fw_try_count", 2), "set NV");
+	mock_nv_reads = mock_nv_writes = 0;
+
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 2, "get NV");
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 2, "  again");
+	TEST_EQ(mock_nv_reads, 1, "  read once");
+
+	TEST_SUCC(VbSetSystemPropertyInt("fw_try_count", 3), "set NV");
+	TEST_EQ(mock_nv_writes, 1, "  written");
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 3,
+		"  read again after set");
+	TEST_EQ(mock_nv_reads, 3, "  read for set and get");
+
+	/* Changes in a batch are kept until committed. */
+	TEST_SUCC(VbBeginSystemPropertyBatch(), "begin batch");
+	TEST_SUCC(VbSetSystemPropertyInt("fw_try_count", 4), "  set NV");
+	VbInvalidateSystemPropertyCache();
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 4,
+		"  kept after invalidation");
+	TEST_EQ(mock_nv_writes, 1, "  not written");
+	TEST_SUCC(VbCommitSystemPropertyBatch(), "commit batch");
+	TEST_EQ(mock_nv_writes, 2, "  written");
+	mock_nv_reads = 0;
+	TEST_EQ(VbGetSystemPropertyInt("fw_try_count"), 4,
+		"  read again after commit");
+	TEST_EQ(mock_nv_reads, 1, "  read");
+}
+
+int main(int argc, char *argv[])
+{
+	vdat_tests();
+	nv_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -0,0 +1,201 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host library key cache
+ */
+
+#include <stdio.h>
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2sysincludes.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_key_cache.h"
+#include "host_keyblock.h"
+#include "test_common.h"
+
+static void unpack_tests(struct vb2_packed_key *packed,
+			 struct vb2_packed_key *other)
+{
+	const struct vb2_public_key *key1, *key2, *key3;
+	struct vb2_public_key plain;
+	uint32_t size = packed->key_offset + packed->key_size;
+	struct vb2_packed_key *copy = malloc(size);
+
+	TEST_SUCC(vb2_key_cache_unpack(&key1, packed),
+		  "vb2_key_cache_unpack()");
+	TEST_SUCC(vb2_unpack_key(&plain, packed), "  vb2_unpack_key()");
+	TEST_EQ(key1->sig_alg, plain.sig_alg, "  sig_alg");
+	TEST_EQ(key1->hash_alg, plain.hash_alg, "  hash_alg");
+	TEST_EQ(key1->arrsize, plain.arrsize, "  arrsize");
+	TEST_EQ(key1->n0inv, plain.n0inv, "  n0inv");
+	TEST_EQ(memcmp(key1->n, plain.n, plain.arrsize * sizeof(uint32_t)),
+		0, "  n");
+	TEST_EQ(memcmp(key1->rr, plain.rr, plain.arrsize * sizeof(uint32_t)),
+		0, "  rr");
+	TEST_TRUE((uint8_t *)key1->n < (uint8_t *)packed ||
+		  (uint8_t *)key1->n >= (uint8_t *)packed + size,
+		  "  key does not point into packed key");
+
+	/* Same key from a different buffer is found in the cache */
+	memcpy(copy, packed, size);
+	TEST_SUCC(vb2_key_cache_unpack_buffer(&key2, (uint8_t *)copy, size),
+		  "vb2_key_cache_unpack_buffer() again");
+	TEST_PTR_EQ(key1, key2, "  same key");
+
+	/* Same key data with a different algorithm is a different key */
+	copy->algorithm = (packed->algorithm / 3) * 3 +
+		(packed->algorithm + 1) % 3;
+	TEST_SUCC(vb2_key_cache_unpack_buffer(&key3, (uint8_t *)copy, size),
+		  "vb2_key_cache_unpack_buffer() other hash");
+	TEST_PTR_NEQ(key1, key3, "  different key");
+	TEST_NEQ(key1->hash_alg, key3->hash_alg, "  different hash_alg");
+
+	/* Same size and algorithm, but different key data */
+	memcpy(copy, packed, size);
+	((uint8_t *)copy)[copy->key_offset + copy->key_size - 1] ^= 0x01;
+	TEST_SUCC(vb2_key_cache_unpack_buffer(&key3, (uint8_t *)copy, size),
+		  "vb2_key_cache_unpack_buffer() other key data");
+	TEST_PTR_NEQ(key1, key3, "  different key");
+	TEST_NEQ(memcmp(key1->rr, key3->rr, plain.arrsize * sizeof(uint32_t)),
+		 0, "  different rr");
+
+	TEST_SUCC(vb2_key_cache_unpack(&key3, other),
+		  "vb2_key_cache_unpack() other key");
+	TEST_PTR_NEQ(key1, key3, "  different key");
+
+	/* Bad keys are not cached */
+	memcpy(copy, packed, size);
+	copy->algorithm = VB2_ALG_COUNT;
+	TEST_EQ(vb2_key_cache_unpack_buffer(&key3, (uint8_t *)copy, size),
+		VB2_ERROR_UNPACK_KEY_SIG_ALGORITHM,
+		"vb2_key_cache_unpack_buffer() bad algorithm");
+	TEST_EQ(vb2_key_cache_unpack_buffer(&key3, (uint8_t *)copy, size),
+		VB2_ERROR_UNPACK_KEY_SIG_ALGORITHM,
+		"  still bad");
+	TEST_EQ(vb2_key_cache_unpack_buffer(&key3, (uint8_t *)copy, size - 1),
+		VB2_ERROR_INSIDE_DATA_OUTSIDE,
+		"vb2_key_cache_unpack_buffer() too small");
+	TEST_EQ(vb2_key_cache_unpack(&key3, NULL),
+		VB2_ERROR_UNPACK_KEY_BUFFER, "vb2_key_cache_unpack() NULL");
+
+	free(copy);
+}
+
+static void verify_tests(struct vb2_packed_key *signing_key,
+			 struct vb2_private_key *private_key,
+			 struct vb2_packed_key *data_key)
+{
+	uint8_t workbuf[VB2_KEYBLOCK_VERIFY_WORKBUF_BYTES]
+		__attribute__((aligned(VB2_WORKBUF_ALIGN)));
+	const struct vb2_public_key *key;
+	struct vb2_public_key plain;
+	struct vb2_keyblock *orig, *block;
+	struct vb2_workbuf wb;
+	uint32_t size;
+
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+
+	orig = vb2_create_keyblock(data_key, private_key, 0x1234);
+	TEST_PTR_NEQ(orig, NULL, "vb2_create_keyblock()");
+	if (!orig)
+		return;
+	size = orig->keyblock_size;
+	block = malloc(size);
+
+	TEST_SUCC(vb2_key_cache_unpack(&key, signing_key), "Unpack key");
+
+	memcpy(block, orig, size);
+	TEST_SUCC(vb2_key_cache_verify_keyblock(block, size, key, &wb),
+		  "vb2_key_cache_verify_keyblock()");
+
+	/* The second check is answered from the cache */
+	memcpy(block, orig, size);
+	TEST_SUCC(vb2_key_cache_verify_keyblock(block, size, key, &wb),
+		  "vb2_key_cache_verify_keyblock() again");
+	TEST_EQ(memcmp(block, orig, size), 0, "  signature untouched");
+
+	/* Any change must still be caught */
+	memcpy(block, orig, size);
+	block->keyblock_flags ^= 1;
+	TEST_EQ(vb2_key_cache_verify_keyblock(block, size, key, &wb),
+		VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"vb2_key_cache_verify_keyblock() changed flags");
+
+	memcpy(block, orig, size);
+	vb2_signature_data_mutable(&block->keyblock_signature)[0] ^= 0x10;
+	TEST_EQ(vb2_key_cache_verify_keyblock(block, size, key, &wb),
+		VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"vb2_key_cache_verify_keyblock() changed signature");
+
+	memcpy(block, orig, size);
+	TEST_EQ(vb2_key_cache_verify_keyblock(block, size - 1, key, &wb),
+		VB2_ERROR_KEYBLOCK_SIZE,
+		"vb2_key_cache_verify_keyblock() size--");
+
+	/* Keys from outside the cache still work */
+	TEST_SUCC(vb2_unpack_key(&plain, signing_key), "Unpack plain key");
+	memcpy(block, orig, size);
+	TEST_SUCC(vb2_key_cache_verify_keyblock(block, size, &plain, &wb),
+		  "vb2_key_cache_verify_keyblock() uncached key");
+	memcpy(block, orig, size);
+	block->keyblock_flags ^= 1;
+	TEST_EQ(vb2_key_cache_verify_keyblock(block, size, &plain, &wb),
+		VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"vb2_key_cache_verify_keyblock() uncached key bad");
+
+	/* Keyblock signed by a different key */
+	TEST_SUCC(vb2_key_cache_unpack(&key, data_key), "Unpack data key");
+	memcpy(block, orig, size);
+	TEST_EQ(vb2_key_cache_verify_keyblock(block, size, key, &wb),
+		VB2_ERROR_KEYBLOCK_SIG_INVALID,
+		"vb2_key_cache_verify_keyblock() wrong key");
+
+	free(block);
+	free(orig);
+}
+
+static struct vb2_packed_key *read_key(const char *keys_dir,
+				       enum vb2_crypto_algorithm alg)
+{
+	char filename[1024];
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.keyb", keys_dir,
+		 vb2_get_crypto_algorithm_file(alg));
+	return vb2_read_packed_keyb(filename, alg, 1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct vb2_private_key *private_key;
+	struct vb2_packed_key *signing_key, *data_key;
+	char filename[1024];
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <keys_dir>\n", argv[0]);
+		return -1;
+	}
+
+	snprintf(filename, sizeof(filename), "%s/key_%s.pem", argv[1],
+		 vb2_get_crypto_algorithm_file(VB2_ALG_RSA4096_SHA256));
+	private_key = vb2_read_private_key_pem(filename,
+					       VB2_ALG_RSA4096_SHA256);
+	signing_key = read_key(argv[1], VB2_ALG_RSA4096_SHA256);
+	data_key = read_key(argv[1], VB2_ALG_RSA2048_SHA256);
+	if (!private_key || !signing_key || !data_key) {
+		fprintf(stderr, "Error reading test keys from %s\n", argv[1]);
+		return 1;
+	}
+
+	unpack_tests(signing_key, data_key);
+	verify_tests(signing_key, private_key, data_key);
+
+	vb2_key_cache_clear();
+	vb2_free_private_key(private_key);
+	free(signing_key);
+	free(data_key);
+
+	return gTestSuccess ? 0 : 255;
+}
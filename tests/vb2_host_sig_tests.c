@@ -0,0 +1,245 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host library external signer support
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "2common.h"
+#include "2rsa.h"
+#include "2sysincludes.h"
+#include "host_common.h"
+#include "host_key.h"
+#include "host_signature.h"
+#include "test_common.h"
+
+#define NUM_BUFS 20
+#define BUF_SIZE 100
+#define NUM_CHILDREN 3
+
+static const enum vb2_crypto_algorithm alg = VB2_ALG_RSA2048_SHA256;
+
+static uint8_t bufs[NUM_BUFS][BUF_SIZE];
+static const uint8_t *data[NUM_BUFS];
+static uint32_t sizes[NUM_BUFS];
+static struct vb2_signature *expect[NUM_BUFS];
+
+/* Check that [count] signatures match the ones calculated in-process */
+static int sigs_match(struct vb2_signature **sigs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!sigs[i] || sigs[i]->sig_size != expect[i]->sig_size ||
+		    sigs[i]->data_size != expect[i]->data_size ||
+		    memcmp(vb2_signature_data(sigs[i]),
+			   vb2_signature_data(expect[i]),
+			   expect[i]->sig_size))
+			return 0;
+	}
+	return 1;
+}
+
+static void free_sigs(struct vb2_signature **sigs, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		free(sigs[i]);
+}
+
+/* Sign all buffers in several forked children at once. Returns the number of
+ * children which failed. */
+static int fork_signers(const char *pem_file, const char *signer)
+{
+	struct vb2_signature *sigs[NUM_BUFS];
+	int i, status, failed = 0;
+	pid_t pid;
+
+	fflush(NULL);
+	for (i = 0; i < NUM_CHILDREN; i++) {
+		pid = fork();
+		if (pid < 0)
+			return NUM_CHILDREN;
+		if (pid)
+			continue;
+		status = vb2_external_signatures(sigs, NUM_BUFS, data, sizes,
+						 pem_file, alg, signer) ||
+			!sigs_match(sigs, NUM_BUFS);
+		vb2_external_signer_close();
+		_exit(status);
+	}
+	for (i = 0; i < NUM_CHILDREN; i++) {
+		if (wait(&status) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status))
+			failed++;
+	}
+	return failed;
+}
+
+static void external_tests(const char *pem_file, const char *signer,
+			   const char *oneshot_signer,
+			   const char *eof_signer, const char *stuck_signer)
+{
+	struct vb2_signature *sigs[NUM_BUFS];
+	struct vb2_signature *sig;
+	time_t start;
+
+	/* One signer process per signature */
+	vb2_external_signer_persist(0);
+	sig = vb2_external_signature(data[0], sizes[0], pem_file, alg, signer);
+	TEST_TRUE(sig && sigs_match(&sig, 1), "vb2_external_signature()");
+	free(sig);
+
+	TEST_SUCC(vb2_external_signatures(sigs, 3, data, sizes, pem_file,
+					  alg, signer),
+		  "vb2_external_signatures()");
+	TEST_TRUE(sigs_match(sigs, 3), "  signatures match");
+	free_sigs(sigs, 3);
+
+	/* One co-process for many requests */
+	vb2_external_signer_persist(1);
+	TEST_SUCC(vb2_external_signatures(sigs, NUM_BUFS, data, sizes,
+					  pem_file, alg, signer),
+		  "vb2_external_signatures() co-process");
+	TEST_TRUE(sigs_match(sigs, NUM_BUFS), "  signatures match");
+	free_sigs(sigs, NUM_BUFS);
+
+	sig = vb2_external_signature(data[0], sizes[0], pem_file, alg, signer);
+	TEST_TRUE(sig && sigs_match(&sig, 1),
+		  "vb2_external_signature() co-process again");
+	free(sig);
+
+	/* A signer which can't run as a co-process is run once per sig */
+	TEST_SUCC(vb2_external_signatures(sigs, 3, data, sizes, pem_file,
+					  alg, oneshot_signer),
+		  "vb2_external_signatures() fallback");
+	TEST_TRUE(sigs_match(sigs, 3), "  signatures match");
+	free_sigs(sigs, 3);
+
+	/*
+	 * A signer which ignores --coprocess and reads its input until EOF
+	 * never says hello, so it is given up on without waiting out the
+	 * response timeout.
+	 */
+	start = time(NULL);
+	TEST_SUCC(vb2_external_signatures(sigs, 3, data, sizes, pem_file,
+					  alg, eof_signer),
+		  "vb2_external_signatures() signer reads until EOF");
+	TEST_TRUE(sigs_match(sigs, 3), "  signatures match");
+	TEST_TRUE(time(NULL) - start < 10, "  without waiting for timeout");
+	free_sigs(sigs, 3);
+
+	/* One which says hello but never answers, nor exits, is killed */
+	vb2_external_signer_timeout(200);
+	TEST_SUCC(vb2_external_signatures(sigs, 3, data, sizes, pem_file,
+					  alg, stuck_signer),
+		  "vb2_external_signatures() signer never answers");
+	TEST_TRUE(sigs_match(sigs, 3), "  signatures match");
+	free_sigs(sigs, 3);
+	vb2_external_signer_close();
+	vb2_external_signer_timeout(30000);
+
+	/* Children forked after the start share the parent's co-process */
+	TEST_SUCC(vb2_external_signer_start(pem_file, signer),
+		  "vb2_external_signer_start()");
+	TEST_EQ(fork_signers(pem_file, signer), 0, "  forked children sign");
+
+	/* Signing failures are reported */
+	TEST_NEQ(vb2_external_signatures(sigs, 3, data, sizes,
+					 "/nonexistent.pem", alg, signer), 0,
+		 "vb2_external_signatures() bad key");
+	TEST_PTR_EQ(sigs[0], NULL, "  no signatures");
+	TEST_NEQ(vb2_external_signatures(sigs, 3, data, sizes, pem_file,
+					 alg, "/nonexistent/signer"), 0,
+		 "vb2_external_signatures() bad signer");
+
+	vb2_external_signer_close();
+	vb2_external_signer_persist(0);
+}
+
+/* Write a shell script to a new temporary file named by [path]. Returns 0 on
+ * success, -1 on error. */
+static int write_signer(char *path, const char *script, const char *signer)
+{
+	FILE *fp;
+	int fd;
+
+	fd = mkstemp(path);
+	fp = fd < 0 ? NULL : fdopen(fd, "w");
+	if (!fp) {
+		fprintf(stderr, "Error creating %s\n", path);
+		return -1;
+	}
+	fprintf(fp, script, signer);
+	fclose(fp);
+	chmod(path, 0700);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char oneshot_signer[] = "/tmp/vb2_host_sig_tests.XXXXXX";
+	char eof_signer[] = "/tmp/vb2_host_sig_tests.XXXXXX";
+	char stuck_signer[] = "/tmp/vb2_host_sig_tests.XXXXXX";
+	struct vb2_private_key *private_key;
+	char pem_file[1024];
+	int i;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <keys_dir> <external_signer>\n",
+			argv[0]);
+		return -1;
+	}
+
+	snprintf(pem_file, sizeof(pem_file), "%s/key_%s.pem", argv[1],
+		 vb2_get_crypto_algorithm_file(alg));
+	private_key = vb2_read_private_key_pem(pem_file, alg);
+	if (!private_key) {
+		fprintf(stderr, "Error reading test key %s\n", pem_file);
+		return 1;
+	}
+
+	for (i = 0; i < NUM_BUFS; i++) {
+		memset(bufs[i], i, BUF_SIZE);
+		data[i] = bufs[i];
+		sizes[i] = BUF_SIZE - i;
+		expect[i] = vb2_calculate_signature(data[i], sizes[i],
+						    private_key);
+	}
+
+	/* A signer which only knows how to sign a single input */
+	if (write_signer(oneshot_signer,
+			 "#!/bin/sh\n[ $# -eq 1 ] && exec %s \"$1\"\n",
+			 argv[2]))
+		return 1;
+	/* One which ignores --coprocess and signs its input at EOF */
+	if (write_signer(eof_signer,
+			 "#!/bin/sh\nfor pem; do :; done\nexec %s \"$pem\"\n",
+			 argv[2]))
+		return 1;
+	/* And one which never answers a co-process request, nor exits */
+	if (write_signer(stuck_signer,
+			 "#!/bin/sh\n[ $# -eq 2 ] &&"
+			 " printf '\\000\\000\\000\\001' && exec sleep 1000\n"
+			 "exec %s \"$1\"\n", argv[2]))
+		return 1;
+
+	external_tests(pem_file, argv[2], oneshot_signer, eof_signer,
+		       stuck_signer);
+
+	unlink(oneshot_signer);
+	unlink(eof_signer);
+	unlink(stuck_signer);
+	for (i = 0; i < NUM_BUFS; i++)
+		free(expect[i]);
+	vb2_free_private_key(private_key);
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -10,6 +10,7 @@
 #include "2misc.h"
 #include "2nvstorage.h"
 #include "2secdata.h"
+#include "2struct.h"
 #include "2sysincludes.h"
 #include "test_common.h"
 
@@ -30,6 +31,7 @@ static void *mock_resource_ptr;
 static uint32_t mock_resource_size;
 static int mock_tpm_clear_called;
 static int mock_tpm_clear_retval;
+static uint32_t mock_time_ms;
 
 static void reset_common_data(void)
 {
@@ -53,6 +55,7 @@ static void reset_common_data(void)
 
 	mock_tpm_clear_called = 0;
 	mock_tpm_clear_retval = VB2_SUCCESS;
+	mock_time_ms = 0;
 
 	boot_mode = (enum vb2_boot_mode *)&ctx->boot_mode;
 	*boot_mode = VB2_BOOT_MODE_NORMAL;
@@ -86,6 +89,11 @@ vb2_error_t vb2ex_tpm_clear_owner(struct vb2_context *c)
 	return mock_tpm_clear_retval;
 }
 
+uint32_t vb2ex_mtime(void)
+{
+	return mock_time_ms;
+}
+
 /* Tests */
 static void init_workbuf_tests(void)
 {
@@ -706,6 +714,66 @@ static void tpm_clear_tests(void)
 		0, "done not set");
 }
 
+static void timing_tests(void)
+{
+	uint8_t buf[VB2_TIMING_EXPORT_SIZE];
+	struct vb2_timing_export *timing = (void *)buf;
+	int i;
+
+	/* Start and end of a step */
+	reset_common_data();
+	TEST_EQ(sd->timing_count, 0, "no timing events");
+	mock_time_ms = 100;
+	vb2_timing_start(ctx, VB2_TIMING_FW_PHASE1);
+	mock_time_ms = 105;
+	TEST_EQ(vb2_timing_end(ctx, VB2_TIMING_FW_PHASE1, VB2_SUCCESS),
+		VB2_SUCCESS, "vb2_timing_end() returns result");
+	TEST_EQ(sd->timing_count, 2, "  event count");
+	TEST_EQ(sd->timing_events[0].time_ms, 100, "  start time");
+	TEST_EQ(sd->timing_events[0].tag, VB2_TIMING_FW_PHASE1, "  start tag");
+	TEST_EQ(sd->timing_events[1].time_ms, 105, "  end time");
+	TEST_EQ(sd->timing_events[1].tag,
+		VB2_TIMING_FW_PHASE1 | VB2_TIMING_END, "  end tag");
+	TEST_EQ(sd->timing_events[1].flags, 0, "  end flags");
+
+	/* Failed steps are flagged */
+	reset_common_data();
+	mock_tpm_clear_retval = VB2_ERROR_EX_TPM_CLEAR_OWNER;
+	vb2_nv_set(ctx, VB2_NV_CLEAR_TPM_OWNER_REQUEST, 1);
+	vb2_check_tpm_clear(ctx);
+	TEST_EQ(sd->timing_count, 2, "tpm clear timed");
+	TEST_EQ(sd->timing_events[1].tag,
+		VB2_TIMING_TPM_CLEAR_OWNER | VB2_TIMING_END, "  end tag");
+	TEST_EQ(sd->timing_events[1].flags, VB2_TIMING_FLAG_FAILED,
+		"  failure flagged");
+
+	/* Export */
+	memset(buf, 0xaa, sizeof(buf));
+	vb2api_export_timing(ctx, buf);
+	TEST_EQ(timing->magic, VB2_TIMING_EXPORT_MAGIC, "export magic");
+	TEST_EQ(timing->struct_version_major, VB2_TIMING_EXPORT_VERSION_MAJOR,
+		"  version");
+	TEST_EQ(timing->event_count, 2, "  event count");
+	TEST_EQ(timing->dropped_count, 0, "  dropped count");
+	TEST_EQ(memcmp(timing->events, sd->timing_events,
+		       2 * sizeof(struct vb2_timing_event)), 0, "  events");
+	TEST_EQ(timing->events[2].tag, 0, "  unused events cleared");
+
+	/* Only the most recent events are kept */
+	reset_common_data();
+	for (i = 0; i < VB2_TIMING_MAX_EVENTS + 3; i++) {
+		mock_time_ms = i;
+		vb2_timing_start(ctx, VB2_TIMING_KERNEL_BODY);
+	}
+	vb2api_export_timing(ctx, buf);
+	TEST_EQ(timing->event_count, VB2_TIMING_MAX_EVENTS,
+		"export after wrap");
+	TEST_EQ(timing->dropped_count, 3, "  dropped count");
+	TEST_EQ(timing->events[0].time_ms, 3, "  oldest first");
+	TEST_EQ(timing->events[VB2_TIMING_MAX_EVENTS - 1].time_ms,
+		VB2_TIMING_MAX_EVENTS + 2, "  newest last");
+}
+
 static void select_slot_tests(void)
 {
 	/* Slot A */
@@ -1094,6 +1162,7 @@ int main(int argc, char* argv[])
 	dev_switch_tests();
 	enable_dev_tests();
 	tpm_clear_tests();
+	timing_tests();
 	select_slot_tests();
 	need_reboot_for_display_tests();
 	clear_recovery_tests();
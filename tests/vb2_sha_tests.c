@@ -7,10 +7,13 @@
 
 #include <stdio.h>
 
+#include "2common.h"
 #include "2return_codes.h"
 #include "2rsa.h"
 #include "2sha.h"
+#include "2sha_private.h"
 #include "2sysincludes.h"
+#include "sha_multibuf.h"
 #include "sha_test_vectors.h"
 #include "test_common.h"
 
@@ -169,6 +172,113 @@ static void misc_tests(void)
 		"vb2_digest_finalize() invalid alg");
 }
 
+static void multibuf_tests(void)
+{
+	/* Enough messages to refill every lane at least twice */
+	enum { NUM_JOBS = 2 * VB2_SHA256_MB_LANES + 3 };
+	const enum vb2_hash_algorithm algs[] = {
+		VB2_HASH_SHA1, VB2_HASH_SHA224, VB2_HASH_SHA256,
+		VB2_HASH_SHA384, VB2_HASH_SHA512,
+	};
+	struct vb2_digest_job jobs[NUM_JOBS];
+	uint8_t digests[NUM_JOBS][VB2_MAX_DIGEST_SIZE];
+	uint8_t expect[VB2_MAX_DIGEST_SIZE];
+	uint8_t *buf;
+	uint32_t size;
+	int a, i, ok;
+
+	buf = malloc(NUM_JOBS * 300);
+	for (i = 0; i < NUM_JOBS * 300; i++)
+		buf[i] = (uint8_t)(i * 7 + 3);
+
+	for (a = 0; a < ARRAY_SIZE(algs); a++) {
+		/* Mix of empty, sub-block, block-aligned and long messages */
+		for (i = 0; i < NUM_JOBS; i++) {
+			size = (i * 61) % 300;
+			if (i % 5 == 0)
+				size = 128 * (i % 3);
+			jobs[i].buf = buf + i * 7;
+			jobs[i].size = size;
+			jobs[i].digest = digests[i];
+			jobs[i].digest_size = sizeof(digests[i]);
+		}
+		jobs[NUM_JOBS - 1].size = NUM_JOBS * 300 - (NUM_JOBS - 1) * 7;
+
+		TEST_SUCC(vb2_digest_buffers(jobs, NUM_JOBS, algs[a]),
+			  "vb2_digest_buffers()");
+		ok = 1;
+		for (i = 0; i < NUM_JOBS; i++) {
+			vb2_digest_buffer(jobs[i].buf, jobs[i].size, algs[a],
+					  expect, sizeof(expect));
+			if (memcmp(expect, digests[i],
+				   vb2_digest_size(algs[a])))
+				ok = 0;
+		}
+		TEST_TRUE(ok, "  digests match vb2_digest_buffer()");
+
+		TEST_SUCC(vb2_digest_buffers(jobs, 1, algs[a]),
+			  "vb2_digest_buffers() single job");
+		vb2_digest_buffer(jobs[0].buf, jobs[0].size, algs[a],
+				  expect, sizeof(expect));
+		TEST_EQ(memcmp(expect, digests[0], vb2_digest_size(algs[a])),
+			0, "  digest matches");
+	}
+
+	TEST_SUCC(vb2_digest_buffers(jobs, 0, VB2_HASH_SHA256),
+		  "vb2_digest_buffers() no jobs");
+
+	jobs[3].digest_size = VB2_SHA256_DIGEST_SIZE - 1;
+	TEST_EQ(vb2_digest_buffers(jobs, NUM_JOBS, VB2_HASH_SHA256),
+		VB2_ERROR_SHA_FINALIZE_DIGEST_SIZE,
+		"vb2_digest_buffers() digest too small");
+
+	TEST_EQ(vb2_digest_buffers(jobs, NUM_JOBS, VB2_HASH_INVALID),
+		VB2_ERROR_SHA_INIT_ALGORITHM,
+		"vb2_digest_buffers() invalid alg");
+
+	free(buf);
+}
+
+#ifdef SHA_RUNTIME_DISPATCH
+static void hw_dispatch_tests(void)
+{
+	const enum vb2_hash_algorithm algs[] = {
+		VB2_HASH_SHA224, VB2_HASH_SHA256,
+	};
+	uint8_t hw[VB2_SHA256_DIGEST_SIZE];
+	uint8_t sw[VB2_SHA256_DIGEST_SIZE];
+	uint32_t h[8] = {0};
+	uint8_t *buf;
+	uint32_t size;
+	int a, ok;
+
+	buf = malloc(1000);
+	for (size = 0; size < 1000; size++)
+		buf[size] = (uint8_t)(size * 13 + 5);
+
+	for (a = 0; a < ARRAY_SIZE(algs); a++) {
+		ok = 1;
+		/* Sizes around block boundaries, and multi-block updates */
+		for (size = 0; size < 1000; size += 31) {
+			vb2_sha_hw_allow(1);
+			vb2_digest_buffer(buf, size, algs[a], hw, sizeof(hw));
+			vb2_sha_hw_allow(0);
+			vb2_digest_buffer(buf, size, algs[a], sw, sizeof(sw));
+			if (memcmp(hw, sw, vb2_digest_size(algs[a])))
+				ok = 0;
+		}
+		TEST_TRUE(ok, "SHA extensions match C transform");
+	}
+
+	vb2_sha_hw_allow(0);
+	TEST_EQ(vb2_sha256_transform_hw(h, buf, 1), 0,
+		"vb2_sha256_transform_hw() not allowed");
+	vb2_sha_hw_allow(1);
+
+	free(buf);
+}
+#endif
+
 static void known_value_tests(void)
 {
 	const char sentinel[] = "keepme";
@@ -256,6 +366,10 @@ int main(int argc, char *argv[])
 	sha256_tests();
 	sha512_tests();
 	misc_tests();
+	multibuf_tests();
+#ifdef SHA_RUNTIME_DISPATCH
+	hw_dispatch_tests();
+#endif
 	known_value_tests();
 
 	free(long_msg);
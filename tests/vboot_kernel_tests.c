@@ -32,10 +32,13 @@ static int mock_part_next;
 /* Mock data */
 static uint8_t kernel_buffer[80000];
 static int disk_read_to_fail;
+static uint64_t disk_bytes_read;
 static int gpt_init_fail;
 static int keyblock_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
+static vb2_error_t hwcrypto_digest_rv;
+static uint32_t hwcrypto_digest_bytes;
 static int unpack_key_fail;
 static int gpt_flag_external;
 
@@ -59,11 +62,14 @@ static enum vb2_boot_mode *boot_mode;
 static void ResetMocks(void)
 {
 	disk_read_to_fail = -1;
+	disk_bytes_read = 0;
 
 	gpt_init_fail = 0;
 	keyblock_verify_fail = 0;
 	preamble_verify_fail = 0;
 	verify_data_fail = 0;
+	hwcrypto_digest_rv = VB2_ERROR_EX_HWCRYPTO_UNSUPPORTED;
+	hwcrypto_digest_bytes = 0;
 	unpack_key_fail = 0;
 
 	gpt_flag_external = 0;
@@ -156,12 +162,43 @@ vb2_error_t vb2_gbb_read_recovery_key(struct vb2_context *c,
 	return VB2_SUCCESS;
 }
 
+/* Copy the part of [src] at [src_offset] on disk which overlaps a read */
+static void copy_overlap(uint8_t *buf, uint64_t offset, uint64_t size,
+			 const void *src, uint64_t src_offset,
+			 uint64_t src_size)
+{
+	uint64_t start = VB2_MAX(offset, src_offset);
+	uint64_t end = VB2_MIN(offset + size, src_offset + src_size);
+
+	if (start < end)
+		memcpy(buf + start - offset,
+		       (const uint8_t *)src + start - src_offset, end - start);
+}
+
 vb2_error_t VbExDiskRead(VbExDiskHandle_t h, uint64_t lba_start,
 			 uint64_t lba_count, void *buffer)
 {
+	struct mock_part *p;
+	uint64_t offset;
+
 	if ((int)lba_start == disk_read_to_fail)
 		return VB2_ERROR_MOCK;
 
+	disk_bytes_read += lba_count * disk_info.bytes_per_lba;
+
+	/* Each partition starts with the mock keyblock and preamble */
+	for (p = mock_parts; p->size; p++) {
+		if (lba_start < p->start || lba_start >= p->start + p->size)
+			continue;
+		offset = (lba_start - p->start) * disk_info.bytes_per_lba;
+		copy_overlap(buffer, offset,
+			     lba_count * disk_info.bytes_per_lba,
+			     &kbh, 0, sizeof(kbh));
+		copy_overlap(buffer, offset,
+			     lba_count * disk_info.bytes_per_lba,
+			     &kph, kbh.keyblock_size, sizeof(kph));
+	}
+
 	return VB2_SUCCESS;
 }
 
@@ -215,6 +252,7 @@ vb2_error_t vb2_unpack_key_buffer(struct vb2_public_key *key,
 	if (--unpack_key_fail == 0)
 		return VB2_ERROR_MOCK;
 
+	key->hash_alg = VB2_HASH_SHA256;
 	return VB2_SUCCESS;
 }
 
@@ -265,6 +303,34 @@ vb2_error_t vb2_verify_data(const uint8_t *data, uint32_t size,
 	return VB2_SUCCESS;
 }
 
+vb2_error_t vb2_verify_digest(const struct vb2_public_key *key,
+			      struct vb2_signature *sig, const uint8_t *digest,
+			      const struct vb2_workbuf *wb)
+{
+	if (verify_data_fail)
+		return VB2_ERROR_MOCK;
+
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_init(enum vb2_hash_algorithm hash_alg,
+				       uint32_t data_size)
+{
+	return hwcrypto_digest_rv;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_extend(const uint8_t *buf, uint32_t size)
+{
+	hwcrypto_digest_bytes += size;
+	return VB2_SUCCESS;
+}
+
+vb2_error_t vb2ex_hwcrypto_digest_finalize(uint8_t *digest,
+					   uint32_t digest_size)
+{
+	return VB2_SUCCESS;
+}
+
 vb2_error_t vb2_digest_buffer(const uint8_t *buf, uint32_t size,
 			      enum vb2_hash_algorithm hash_alg, uint8_t *digest,
 			      uint32_t digest_size)
@@ -604,6 +670,66 @@ static void LoadKernelTest(void)
 	verify_data_fail = 1;
 	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND, "Bad data");
 
+	/* Read and hash the kernel body a chunk at a time */
+	ResetMocks();
+	lkp.body_read_chunk_size = 4096;
+	TestLoadKernel(0, "Chunked read");
+
+	ResetMocks();
+	lkp.body_read_chunk_size = 4096;
+	hwcrypto_digest_rv = VB2_SUCCESS;
+	TestLoadKernel(0, "Chunked read HW crypto");
+	TEST_EQ(hwcrypto_digest_bytes, 70144, "  whole body hashed");
+
+	ResetMocks();
+	lkp.body_read_chunk_size = 4096;
+	hwcrypto_digest_rv = VB2_ERROR_MOCK;
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+		       "Chunked read HW crypto error");
+
+	ResetMocks();
+	lkp.body_read_chunk_size = 4096;
+	kph.body_signature.data_size = 8192;
+	TestLoadKernel(0, "Chunked read kernel tiny");
+
+	ResetMocks();
+	lkp.body_read_chunk_size = 4096;
+	disk_read_to_fail = 236;
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND,
+		       "Chunked read fail reading second chunk");
+
+	ResetMocks();
+	lkp.body_read_chunk_size = 4096;
+	verify_data_fail = 1;
+	TestLoadKernel(VB2_ERROR_LK_INVALID_KERNEL_FOUND, "Chunked read bad data");
+
+	/* Looking for newer kernel versions only reads the other vblocks */
+	ResetMocks();
+	kph.kernel_version = 2;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	TestLoadKernel(0, "Rollback scan");
+	TEST_EQ(lkp.partition_number, 1, "  partition");
+	TEST_EQ(disk_bytes_read, 65536 + 8704 + 4096,
+		"  read kernel and second vblock");
+
+	ResetMocks();
+	kph.kernel_version = 2;
+	kph.preamble_size += 1024;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	TestLoadKernel(0, "Rollback scan bigger vblock");
+	TEST_EQ(disk_bytes_read, 65536 + 9728 + 5120,
+		"  read kernel and second vblock");
+
+	ResetMocks();
+	kph.kernel_version = 2;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	disk_read_to_fail = 301;
+	TestLoadKernel(0, "Rollback scan vblock read error");
+	TEST_EQ(lkp.partition_number, 1, "  partition");
+
 	/* Check that EXTERNAL_GPT flag makes it down */
 	ResetMocks();
 	disk_info.flags |= VB_DISK_FLAG_EXTERNAL_GPT;
@@ -262,6 +262,7 @@ static int PrintAllParams(int force_all) {
 
 int main(int argc, char* argv[]) {
   int retval = 0;
+  int batch = 0;
   int i;
 
   char* progname = strrchr(argv[0], '/');
@@ -284,6 +285,17 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  /* Apply all the sets with a single NV storage read and write */
+  for (i = 1; i < argc && !strchr(argv[i], '='); i++)
+    ;
+  if (i < argc) {
+    if (0 != VbBeginSystemPropertyBatch()) {
+      fprintf(stderr, "Failed to lock system properties\n");
+      return 1;
+    }
+    batch = 1;
+  }
+
   /* Otherwise, loop through params and get/set them */
   for (i = 1; i < argc && retval == 0; i++) {
     char* has_set = strchr(argv[i], '=');
@@ -296,14 +308,16 @@ int main(int argc, char* argv[]) {
     if (!name || has_set == argv[i] || has_expect == argv[i]) {
       fprintf(stderr, "Poorly formed parameter\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
     if (!value)
       value=""; /* Allow setting/checking an empty string ('foo=' or 'foo?') */
     if (has_set && has_expect) {
       fprintf(stderr, "Use either = or ? in a parameter, but not both.\n");
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     /* Find the parameter */
@@ -311,7 +325,8 @@ int main(int argc, char* argv[]) {
     if (!p) {
       fprintf(stderr, "Invalid parameter name: %s\n", name);
       PrintHelp(progname);
-      return 1;
+      retval = 1;
+      break;
     }
 
     if (i > 1)
@@ -337,5 +352,11 @@ int main(int argc, char* argv[]) {
       retval = PrintParam(p);
   }
 
+  /* Sets before a failure were applied one by one, so keep them */
+  if (batch && 0 != VbCommitSystemPropertyBatch()) {
+    fprintf(stderr, "Failed to save system properties\n");
+    retval = 1;
+  }
+
   return retval;
 }